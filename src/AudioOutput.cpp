@@ -0,0 +1,143 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "AudioOutput.hpp"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// loud enough to hear, quiet enough not to startle
+static const int16_t AMPLITUDE = 6000;
+static const uint32_t WAV_HEADER_SIZE = 44;
+
+static void Put(std::vector<uint8_t> &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+AudioSynth::AudioSynth(int pSampleRate) : gSampleRate(pSampleRate > MAX_SAMPLE_RATE ? MAX_SAMPLE_RATE : pSampleRate),
+                                          gRemainder(0),
+                                          gPhase(0)
+{
+}
+
+AudioSynth::~AudioSynth()
+{
+}
+
+int AudioSynth::RenderFrame(Chip8 &chip8, int16_t *out)
+{
+    int count = (gSampleRate + gRemainder) / 60;
+    gRemainder = (gSampleRate + gRemainder) % 60;
+
+    if (!chip8.WasSoundOn())
+    {
+        for (int i = 0; i < count; i++)
+            out[i] = 0;
+        // the next tone starts at the start of its wave
+        gPhase = 0;
+        return count;
+    }
+
+    if (chip8.GetProfile() != Chip8::PROFILE_XOCHIP)
+    {
+        double step = (double)TONE_HZ / gSampleRate;
+        for (int i = 0; i < count; i++)
+        {
+            out[i] = gPhase < 0.5 ? AMPLITUDE : -AMPLITUDE;
+            gPhase += step;
+            if (gPhase >= 1)
+                gPhase -= 1;
+        }
+        return count;
+    }
+
+    const uint8_t *pattern = chip8.GetAudioPattern();
+    double step = 4000.0 * pow(2.0, (chip8.GetPitch() - 64) / 48.0) / gSampleRate;
+    for (int i = 0; i < count; i++)
+    {
+        int bit = (int)gPhase;
+        out[i] = (pattern[bit >> 3] >> (7 - (bit & 7))) & 1 ? AMPLITUDE : -AMPLITUDE;
+        gPhase += step;
+        if (gPhase >= 128)
+            gPhase -= 128;
+    }
+    return count;
+}
+
+WavWriter::WavWriter() : gSampleCount(0)
+{
+}
+
+WavWriter::~WavWriter()
+{
+    if (gFile.is_open())
+        Close();
+}
+
+bool WavWriter::Open(const char *fileName, int sampleRate)
+{
+    gFile.open(fileName, std::ofstream::binary);
+    if (!gFile.is_open())
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 1;
+    }
+    gSampleCount = 0;
+
+    // the lengths are filled in by Close
+    std::vector<uint8_t> header;
+    header.insert(header.end(), {'R', 'I', 'F', 'F'});
+    Put(header, 0, 4);
+    header.insert(header.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    Put(header, 16, 4);
+    // PCM, mono
+    Put(header, 1, 2);
+    Put(header, 1, 2);
+    Put(header, sampleRate, 4);
+    Put(header, sampleRate * 2, 4);
+    Put(header, 2, 2);
+    Put(header, 16, 2);
+    header.insert(header.end(), {'d', 'a', 't', 'a'});
+    Put(header, 0, 4);
+    gFile.write((const char *)header.data(), header.size());
+    return 0;
+}
+
+void WavWriter::Write(const int16_t *samples, size_t count)
+{
+    std::vector<uint8_t> out;
+    out.reserve(count * 2);
+    for (size_t i = 0; i < count; i++)
+        Put(out, (uint16_t)samples[i], 2);
+    gFile.write((const char *)out.data(), out.size());
+    gSampleCount += count;
+}
+
+bool WavWriter::Close()
+{
+    if (!gFile.is_open())
+        return 1;
+
+    std::vector<uint8_t> size;
+    Put(size, WAV_HEADER_SIZE - 8 + gSampleCount * 2, 4);
+    gFile.seekp(4);
+    gFile.write((const char *)size.data(), 4);
+    size.clear();
+    Put(size, gSampleCount * 2, 4);
+    gFile.seekp(WAV_HEADER_SIZE - 4);
+    gFile.write((const char *)size.data(), 4);
+
+    bool failed = !gFile;
+    gFile.close();
+    if (failed)
+    {
+        printf("Could not write wav file\n");
+        return 1;
+    }
+    return 0;
+}
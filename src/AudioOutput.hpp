@@ -0,0 +1,73 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef AUDIO_OUTPUT_HPP
+#define AUDIO_OUTPUT_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <fstream>
+#include "Chip8.hpp"
+
+/*
+Turns a Chip8's sound timer into 16-bit mono samples, one 60hz frame at a time.
+CHIP-8 and SUPER-CHIP play a square wave, XO-CHIP plays its 128-bit audio pattern
+(F002) looped at the rate its pitch (FX3A) sets, 4000 * 2 ^ ((pitch - 64) / 48) bits
+per second. Waves carry on from frame to frame, so consecutive frames join up.
+*/
+class AudioSynth
+{
+public:
+    static const int MAX_SAMPLE_RATE = 96000;
+    // the most samples RenderFrame writes
+    static const int MAX_FRAME_SAMPLES = MAX_SAMPLE_RATE / 60 + 1;
+    // of the CHIP-8 and SUPER-CHIP square wave
+    static const int TONE_HZ = 440;
+
+    // pSampleRate up to MAX_SAMPLE_RATE
+    AudioSynth(int pSampleRate = 48000);
+    virtual ~AudioSynth();
+
+public:
+    /*
+    Write the samples of the frame pChip8 just ran into pOut - Returns how many.
+    Call right after RunUntilFrame or a RunCycles that ended on EVENT_FRAME, so a
+    sound timer that was set and ran out within the frame is still heard.
+    Frames average GetSampleRate() / 60 samples, the remainder carries over.
+    */
+    int RenderFrame(Chip8 &pChip8, int16_t *pOut);
+    int GetSampleRate() const { return gSampleRate; }
+
+private:
+    int gSampleRate;
+    // sixtieths of a sample not yet written
+    int gRemainder;
+    // position in the wave, in cycles (square wave) or bits (pattern)
+    double gPhase;
+};
+
+// Writes 16-bit mono samples to a .wav file, for listening to headless runs
+class WavWriter
+{
+public:
+    WavWriter();
+    virtual ~WavWriter();
+
+public:
+    // Returns 1 if the file could not be opened and 0 otherwise
+    bool Open(const char *pFileName, int pSampleRate);
+    void Write(const int16_t *pSamples, size_t pCount);
+    // Fill in the lengths and close - Returns 1 if any write failed and 0 otherwise
+    bool Close();
+
+    uint64_t GetSampleCount() const { return gSampleCount; }
+
+private:
+    std::ofstream gFile;
+    uint64_t gSampleCount;
+};
+
+#endif // AUDIO_OUTPUT_HPP
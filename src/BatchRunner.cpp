@@ -0,0 +1,239 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "BatchRunner.hpp"
+#include "Chip8Vector.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+// Per-worker job queue. The owner pops from the back, thieves take from the front.
+struct BatchRunner::WorkQueue
+{
+    std::mutex lock;
+    std::deque<size_t> jobs;
+};
+
+BatchRunner::BatchRunner(int pThreadCount, uint64_t pCyclesPerRom, uint32_t pInstructionsPerTick) : gThreadCount(pThreadCount),
+                                                                                                   gCyclesPerRom(pCyclesPerRom),
+                                                                                                   gInstructionsPerTick(pInstructionsPerTick),
+                                                                                                   gEngine(Chip8::ENGINE_PREDECODED),
+                                                                                                   gProfile(Chip8::PROFILE_CHIP8),
+                                                                                                   gQuirks(-1),
+                                                                                                   gLanes(0),
+                                                                                                   gSeed(0),
+                                                                                                   gWallSeconds(0)
+{
+    if (gThreadCount <= 0)
+        gThreadCount = std::max(1u, std::thread::hardware_concurrency());
+}
+
+BatchRunner::~BatchRunner()
+{
+    for (WorkQueue *queue : gQueues)
+        delete queue;
+}
+
+int BatchRunner::AddRomFile(const char *pFileName)
+{
+    const RomEntry *rom = gLibrary.AddRomFile(pFileName);
+    if (!rom)
+        return 1;
+
+    BatchJob job;
+    job.path = pFileName;
+    job.rom = rom;
+
+    gJobs.push_back(std::move(job));
+    return 0;
+}
+
+int BatchRunner::AddRomDirectory(const char *pDirectory)
+{
+    std::error_code error;
+    std::vector<std::string> files;
+    for (auto it = std::filesystem::recursive_directory_iterator(pDirectory, error);
+         it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if (error)
+            break;
+        if (it->is_regular_file() && it->path().extension() == ".ch8")
+            files.push_back(it->path().string());
+    }
+    if (error)
+        printf("Could not read directory: %s\n", pDirectory);
+
+    // directory order is unspecified, keep reports stable between runs
+    std::sort(files.begin(), files.end());
+
+    int added = 0;
+    for (const std::string &file : files)
+    {
+        if (AddRomFile(file.c_str()) == 0)
+            added++;
+    }
+    return added;
+}
+
+int BatchRunner::AddArchive(const char *pFileName)
+{
+    size_t first = gLibrary.GetRomCount();
+    int added = gLibrary.AddArchive(pFileName);
+    for (size_t i = first; i < gLibrary.GetRomCount(); i++)
+    {
+        BatchJob job;
+        job.path = gLibrary.GetRom(i).name;
+        job.rom = &gLibrary.GetRom(i);
+        gJobs.push_back(std::move(job));
+    }
+    return added;
+}
+
+void BatchRunner::Run()
+{
+    for (WorkQueue *queue : gQueues)
+        delete queue;
+    gQueues.clear();
+
+    int threadCount = std::min<int>(gThreadCount, std::max<size_t>(1, gJobs.size()));
+    for (int i = 0; i < threadCount; i++)
+        gQueues.push_back(new WorkQueue());
+
+    // deal the jobs out round-robin, stealing evens out the ROMs that run slower
+    for (size_t i = 0; i < gJobs.size(); i++)
+        gQueues[i % threadCount]->jobs.push_back(i);
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threadCount; i++)
+        workers.emplace_back(&BatchRunner::WorkerLoop, this, i);
+    for (std::thread &worker : workers)
+        worker.join();
+
+    gWallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void BatchRunner::WorkerLoop(int pWorkerIndex)
+{
+    int queueCount = (int)gQueues.size();
+    while (true)
+    {
+        size_t jobIndex = 0;
+        bool found = false;
+
+        // own queue first
+        {
+            WorkQueue *own = gQueues[pWorkerIndex];
+            std::lock_guard<std::mutex> guard(own->lock);
+            if (!own->jobs.empty())
+            {
+                jobIndex = own->jobs.back();
+                own->jobs.pop_back();
+                found = true;
+            }
+        }
+
+        // then steal from the other workers, starting with our neighbour
+        for (int i = 1; i < queueCount && !found; i++)
+        {
+            WorkQueue *victim = gQueues[(pWorkerIndex + i) % queueCount];
+            std::lock_guard<std::mutex> guard(victim->lock);
+            if (!victim->jobs.empty())
+            {
+                jobIndex = victim->jobs.front();
+                victim->jobs.pop_front();
+                found = true;
+            }
+        }
+
+        // no new jobs are ever queued during Run(), so empty everywhere means done
+        if (!found)
+            return;
+
+        RunJob(gJobs[jobIndex]);
+    }
+}
+
+void BatchRunner::RunJob(BatchJob &pJob)
+{
+    uint8_t quirks = gQuirks >= 0 ? (uint8_t)gQuirks : pJob.rom->info.quirks;
+    if (gLanes > 0 && gProfile == Chip8::PROFILE_CHIP8 && quirks == Chip8::QUIRK_NONE)
+    {
+        RunVectorJob(pJob);
+        return;
+    }
+
+    Chip8 chip8;
+    chip8.SetInstructionsPerTick(gInstructionsPerTick);
+    chip8.SetEngine(gEngine);
+    chip8.SetSeed(gSeed);
+    chip8.SetProfile(gProfile);
+    chip8.SetQuirks(quirks);
+    chip8.LoadImage(pJob.rom->image.data(), pJob.rom->hash);
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t remaining = gCyclesPerRom;
+    while (remaining > 0)
+    {
+        uint32_t batch = (uint32_t)std::min<uint64_t>(remaining, UINT32_MAX);
+        remaining -= chip8.RunCycles(batch, Chip8::EVENT_NONE);
+    }
+
+    pJob.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pJob.cyclesRun = gCyclesPerRom;
+}
+
+void BatchRunner::RunVectorJob(BatchJob &pJob)
+{
+    Chip8Vector lanes(gLanes, gInstructionsPerTick);
+    for (uint32_t lane = 0; lane < lanes.GetLaneCount(); lane++)
+        lanes.SetSeed(lane, gSeed + lane);
+    lanes.LoadImage(pJob.rom->image.data());
+    for (uint32_t lane = 0; lane < gLanes; lane++)
+        lanes.SetKeyState(lane, lane % 16, 1);
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t remaining = gCyclesPerRom;
+    while (remaining > 0)
+    {
+        uint32_t batch = (uint32_t)std::min<uint64_t>(remaining, UINT32_MAX);
+        lanes.Run(batch);
+        remaining -= batch;
+    }
+
+    pJob.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    pJob.cyclesRun = gCyclesPerRom * gLanes;
+}
+
+void BatchRunner::PrintReport()
+{
+    uint64_t totalCycles = 0;
+    double totalSeconds = 0;
+
+    for (const BatchJob &job : gJobs)
+    {
+        double rate = job.seconds > 0 ? job.cyclesRun / job.seconds : 0;
+        printf("%14.0f  %s\n", rate, job.path.c_str());
+
+        totalCycles += job.cyclesRun;
+        totalSeconds += job.seconds;
+    }
+
+    printf("\n");
+    printf("ROMs run:              %d\n", (int)gJobs.size());
+    printf("Threads:               %d\n", (int)gQueues.size());
+    printf("Total cycles:          %llu\n", (unsigned long long)totalCycles);
+    printf("Wall time:             %.3f s\n", gWallSeconds);
+    printf("Per-thread cycles/s:   %.0f\n", totalSeconds > 0 ? totalCycles / totalSeconds : 0);
+    printf("Aggregate cycles/s:    %.0f\n", gWallSeconds > 0 ? totalCycles / gWallSeconds : 0);
+}
@@ -0,0 +1,111 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef BATCH_RUNNER_HPP
+#define BATCH_RUNNER_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "Chip8.hpp"
+#include "RomLibrary.hpp"
+
+// A single ROM queued in the batch and the result of running it
+struct BatchJob
+{
+    std::string path;
+    // in the runner's library, shared by every job with the same path
+    const RomEntry *rom = nullptr;
+
+    // filled in by the worker that ran the job
+    uint64_t cyclesRun = 0;
+    double seconds = 0;
+};
+
+/*
+Headless runner which executes many ROMs without a window.
+Every ROM gets its own Chip8 instance and is run for a fixed number of cycles.
+Timers run on virtual time so results don't depend on host speed.
+Jobs are spread over a pool of worker threads, each with its own queue.
+A worker that runs out of work steals from the other queues.
+*/
+class BatchRunner
+{
+public:
+    BatchRunner(int pThreadCount, uint64_t pCyclesPerRom, uint32_t pInstructionsPerTick);
+    virtual ~BatchRunner();
+
+public:
+    // Queue a single ROM file - Returns 1 if the file could not be read or is too large and 0 otherwise
+    int AddRomFile(const char *pFileName);
+    // Queue every .ch8 file below a directory - Returns the number of ROMs queued
+    int AddRomDirectory(const char *pDirectory);
+    // Queue every ROM in a packed archive - Returns the number of ROMs queued
+    int AddArchive(const char *pFileName);
+
+    // Run all queued ROMs. Blocks until every job is finished.
+    void Run();
+
+    // Print per-ROM and aggregate cycles/second to stdout
+    void PrintReport();
+
+    const std::vector<BatchJob> &GetJobs() const { return gJobs; }
+
+    // Execution engine used for every ROM (default Chip8::ENGINE_PREDECODED)
+    void SetEngine(Chip8::Engine pEngine) { gEngine = pEngine; }
+
+    // Machine every ROM runs on (default Chip8::PROFILE_CHIP8). Set it before adding ROMs,
+    // the library lays their images out for it.
+    void SetProfile(Chip8::Profile pProfile)
+    {
+        gProfile = pProfile;
+        gLibrary.SetProfile(pProfile);
+    }
+
+    // Chip8::Quirk flags for every ROM. By default each ROM gets the quirks its archive gives it.
+    void SetQuirks(uint8_t pQuirks) { gQuirks = pQuirks; }
+
+    /*
+    Run every ROM as pLanes copies in lockstep on a Chip8Vector instead (0, the default, turns this off).
+    Each lane holds down a different key so the copies diverge, and cycles count every lane.
+    The vector engine only runs the original machine without quirks, ROMs that need more ignore this.
+    */
+    void SetLanes(uint32_t pLanes) { gLanes = pLanes; }
+
+    // CXNN seed for every ROM (default 0). Vector lanes use pSeed + lane.
+    void SetSeed(uint64_t pSeed) { gSeed = pSeed; }
+
+private:
+    // Run a single job on the calling thread
+    void RunJob(BatchJob &pJob);
+    // Run a single job as gLanes copies on a Chip8Vector
+    void RunVectorJob(BatchJob &pJob);
+    // Worker thread body. Drains its own queue then steals from the others.
+    void WorkerLoop(int pWorkerIndex);
+
+private:
+    int gThreadCount;
+    uint64_t gCyclesPerRom;
+    uint32_t gInstructionsPerTick;
+    Chip8::Engine gEngine;
+    Chip8::Profile gProfile;
+    // -1 for each ROM's own
+    int gQuirks;
+    uint32_t gLanes;
+    uint64_t gSeed;
+
+    std::vector<BatchJob> gJobs;
+    // every ROM file is mapped once, workers load from its image
+    RomLibrary gLibrary;
+
+    // wall-clock duration of the last Run()
+    double gWallSeconds;
+
+    struct WorkQueue;
+    std::vector<WorkQueue *> gQueues;
+};
+
+#endif // BATCH_RUNNER_HPP
@@ -0,0 +1,46 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef BITS_HPP
+#define BITS_HPP
+
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+Bit scans for walking set bits, on GCC, Clang and MSVC.
+pBits must not be 0.
+*/
+
+// Index of the lowest set bit
+inline int CountTrailingZeros(uint32_t pBits)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, pBits);
+    return (int)index;
+#else
+    return __builtin_ctz(pBits);
+#endif
+}
+
+inline int CountTrailingZeros(uint64_t pBits)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index;
+    _BitScanForward64(&index, pBits);
+    return (int)index;
+#elif defined(_MSC_VER)
+    uint32_t low = (uint32_t)pBits;
+    return low ? CountTrailingZeros(low) : 32 + CountTrailingZeros((uint32_t)(pBits >> 32));
+#else
+    return __builtin_ctzll(pBits);
+#endif
+}
+
+#endif // BITS_HPP
@@ -0,0 +1,72 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "BlockCache.hpp"
+#include <cstring>
+
+BlockCache::BlockCache() : gFlushCount(0)
+{
+    Flush();
+}
+
+BlockCache::~BlockCache()
+{
+}
+
+void BlockCache::Flush()
+{
+    for (int i = 0; i < 4096; i++)
+        gIndex[i] = -1;
+    memset(gCodeMap, 0, sizeof(gCodeMap));
+    gBlocks.clear();
+}
+
+// ops which jump somewhere only known at run time end a block
+static bool EndsBlock(uint8_t op)
+{
+    return op == OP_RET_00EE || op == OP_JMPOFF_BNNN;
+}
+
+const CodeBlock *BlockCache::Compile(uint16_t pc, const uint8_t *memory)
+{
+    const DecodedOp *table = GetDecodeTable();
+
+    // an opcode straddling the end of memory can't be cached, decode a single op
+    if (pc >= 0xFFF)
+    {
+        gScratch.startPC = pc;
+        gScratch.length = 1;
+        gScratch.ops[0] = table[memory[pc & 0xFFF] << 8 | memory[(pc + 1) & 0xFFF]];
+        return &gScratch;
+    }
+
+    gIndex[pc] = (int32_t)gBlocks.size();
+    gBlocks.emplace_back();
+    CodeBlock &block = gBlocks.back();
+
+    block.startPC = pc;
+    block.length = 0;
+
+    uint16_t addr = pc;
+    while (block.length < BLOCK_MAX_OPS && addr < 0xFFF)
+    {
+        DecodedOp op = table[memory[addr] << 8 | memory[addr + 1]];
+        block.ops[block.length++] = op;
+
+        gCodeMap[addr] = 1;
+        gCodeMap[addr + 1] = 1;
+        addr += 2;
+
+        if (EndsBlock(op.op))
+            break;
+
+        // jumps and calls have a fixed target, keep decoding there
+        if (op.op == OP_JMP_1NNN || op.op == OP_CALL_2NNN)
+            addr = op.imm;
+    }
+
+    return &block;
+}
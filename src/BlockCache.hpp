@@ -0,0 +1,92 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef BLOCK_CACHE_HPP
+#define BLOCK_CACHE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "Chip8Decode.hpp"
+
+// Longest straight-line run kept in one block
+#define BLOCK_MAX_OPS 64
+
+/*
+A run of predecoded ops in execution order.
+Jumps and calls are followed while decoding, so the ops need not be contiguous in memory.
+Skips and key waits leave the block early when they change the PC.
+*/
+struct CodeBlock
+{
+    uint16_t startPC;
+    uint16_t length;
+    DecodedOp ops[BLOCK_MAX_OPS];
+};
+
+/*
+Cache of decoded basic blocks for one Chip8 instance, keyed by start address.
+A block runs from its start address up to and including the next return or
+computed jump, following fixed jumps and calls, up to BLOCK_MAX_OPS ops.
+Every byte of memory that is part of a cached block is marked, so writes into
+code can be detected and the cache thrown away.
+*/
+class BlockCache
+{
+public:
+    BlockCache();
+    virtual ~BlockCache();
+
+public:
+    // Get the block starting at pPC, decoding it from pMemory if it is not cached yet
+    const CodeBlock *Lookup(uint16_t pPC, const uint8_t *pMemory)
+    {
+        if (pPC < 4096 && gIndex[pPC] >= 0)
+            return &gBlocks[gIndex[pPC]];
+        return Compile(pPC, pMemory);
+    }
+
+    /*
+    Must be called after the core writes pLength bytes at pAddress.
+    Returns true if the write hit cached code and the cache was flushed.
+    */
+    bool Invalidate(uint16_t pAddress, uint16_t pLength)
+    {
+        for (uint32_t i = 0; i < pLength; i++)
+        {
+            if (gCodeMap[(pAddress + i) & 0xFFF])
+            {
+                gFlushCount++;
+                Flush();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Drop every cached block
+    void Flush();
+
+    // Number of flushes caused by writes to code, for diagnostics
+    uint32_t GetFlushCount() { return gFlushCount; }
+
+private:
+    // Decode and cache a new block starting at pPC
+    const CodeBlock *Compile(uint16_t pPC, const uint8_t *pMemory);
+
+private:
+    // index into gBlocks for each start address, -1 if not cached
+    int32_t gIndex[4096];
+    // non-zero for every byte of memory covered by a cached block
+    uint8_t gCodeMap[4096];
+
+    std::vector<CodeBlock> gBlocks;
+    // used for blocks starting at the very end of memory, which are never cached
+    CodeBlock gScratch;
+
+    uint32_t gFlushCount;
+};
+
+#endif // BLOCK_CACHE_HPP
@@ -5,13 +5,20 @@
  */
 
 #include "Chip8.hpp"
+#include "Chip8Decode.hpp"
+#include "BlockCache.hpp"
+#include "JitCache.hpp"
+#include "Random.hpp"
+#include "Profiler.hpp"
+#include <cctype>
 #include <cstring>
-#include <cstdlib>
 #include <chrono>
 #include <cstdio>
+#include <string>
 
 Chip8::Chip8()
 {
+    AllocateMemory();
     //reset processor state
     ResetState();
 }
@@ -19,100 +26,1401 @@ Chip8::~Chip8()
 {
 }
 
+void Chip8::AllocateMemory()
+{
+    // one block, memory cache line aligned since resets copy all of it
+    uint32_t size = GetMemorySize();
+    memoryStorage.reset(new uint8_t[2 * size + 63]);
+    memory = (uint8_t *)(((uintptr_t)memoryStorage.get() + 63) & ~(uintptr_t)63);
+    ownImage = memory + size;
+}
+
 void Chip8::ResetState()
 {
-    // get current time in milliseconds since unix epoch
-    lastTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    // an empty machine
+    memset(ownImage, 0, GetMemorySize());
+    romImage = ownImage;
+    romHash = 0;
+    Reset();
+}
+
+void Chip8::Reset()
+{
+    // get current time in milliseconds since unix epoch
+    lastTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    sp = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        V[i] = 0;
+        keys[i] = 0;
+        stack[i] = 0;
+    }
+
+    //reset memory
+    memcpy(memory, romImage, GetMemorySize());
+
+    memset(display, 0, sizeof(display));
+    hires = false;
+    planeMask = 1;
+    memset(flags, 0, sizeof(flags));
+    memset(audioPattern, 0, sizeof(audioPattern));
+    // XO-CHIP's default, 4000 samples per second
+    pitch = 64;
+    // the blank screen still has to be shown once
+    screenDirty = true;
+    // nothing captured yet
+    for (int i = 0; i < SNAPSHOT_PAGE_COUNT; i++)
+        basePages[i].reset();
+    baseDisplay.reset();
+    dirtyPages = ~0u;
+
+    PC = 0x200;
+    I = 0;
+    delay = 0;
+    sound = 0;
+    soundThisFrame = false;
+    soundLastFrame = false;
+
+    unprocessedTime = 0;
+    instructionsUntilTick = instructionsPerTick;
+    cycleCount = 0;
+    events = EVENT_NONE;
+    trapCount = 0;
+    lastTrapOpcode = 0;
+    faultCount = 0;
+    lastFault = FAULT_NONE;
+    lastFaultPC = 0;
+    randomState = SeedRandom(seed);
+
+    if (blockCache)
+        blockCache->Flush();
+    if (jitCache)
+        jitCache->Flush();
+}
+
+void Chip8::Cycle()
+{
+    RunCycles(1, EVENT_NONE);
+}
+
+void Chip8::UpdateWallClockTimers()
+{
+    uint64_t currentTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    unprocessedTime += ((double)(currentTime - lastTime) / 1000.0); 
+    lastTime = currentTime;
+
+    while (unprocessedTime >= secondsPer60Hz)
+    {
+        TickTimers();
+        unprocessedTime -= secondsPer60Hz;
+    }
+}
+
+void Chip8::TickTimers()
+{
+    events |= EVENT_FRAME;
+    soundLastFrame = soundThisFrame;
+
+    if (delay > 0)
+        delay--;
+    if (sound > 0)
+    {
+        sound--;
+        if (sound == 0)
+            events |= EVENT_SOUND;
+    }
+    soundThisFrame = sound > 0;
+}
+
+void Chip8::SetInstructionsPerTick(uint32_t instructionsPerTick)
+{
+    this->instructionsPerTick = instructionsPerTick;
+    instructionsUntilTick = instructionsPerTick;
+
+    // don't let time spent in virtual mode count against the wall clock
+    lastTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    unprocessedTime = 0;
+}
+
+void Chip8::SetSeed(uint64_t seed)
+{
+    this->seed = seed;
+    randomState = SeedRandom(seed);
+}
+
+uint32_t Chip8::RunCycles(uint32_t cycles, uint8_t stopMask)
+{
+    events = EVENT_NONE;
+    if (cycles == 0)
+        return 0;
+
+    // the block and JIT engines only know the original instruction set, without quirks
+    Engine engine = this->engine;
+    if ((profile != PROFILE_CHIP8 || quirks != QUIRK_NONE) && engine != ENGINE_INTERPRETER)
+        engine = ENGINE_PREDECODED;
+
+    uint32_t executed;
+#ifdef CHIP8_PROFILER
+    if (profiler)
+        executed = RunProfiled(cycles, stopMask);
+    else
+#endif
+    if (coverage)
+        executed = engine != ENGINE_INTERPRETER && quirks == QUIRK_NONE && instructionsPerTick != 0
+                       ? RunPredecoded<true, false, false, QUIRK_NONE, true>(cycles, stopMask)
+                       : RunCovered(cycles, stopMask);
+    else if (engine == ENGINE_INTERPRETER)
+        executed = RunInterpreter(cycles, stopMask);
+    else if (engine == ENGINE_BLOCK)
+        executed = instructionsPerTick == 0 ? RunPredecoded<false, true, false>(cycles, stopMask)
+                                            : RunPredecoded<true, true, false>(cycles, stopMask);
+    else if (engine == ENGINE_JIT)
+        executed = instructionsPerTick == 0 ? RunJit<false>(cycles, stopMask)
+                                            : RunJit<true>(cycles, stopMask);
+    else
+        executed = (this->*predecodedVariant[instructionsPerTick != 0])(cycles, stopMask);
+
+    cycleCount += executed;
+    return executed;
+}
+
+uint32_t Chip8::RunInterpreter(uint32_t cycles, uint8_t stopMask)
+{
+    uint32_t executed = 0;
+    while (executed < cycles)
+    {
+        DecodeAndExecute(Fetch());
+        executed++;
+
+        if (instructionsPerTick == 0)
+        {
+            UpdateWallClockTimers();
+        }
+        else if (--instructionsUntilTick == 0)
+        {
+            TickTimers();
+            instructionsUntilTick = instructionsPerTick;
+        }
+
+        if (events & stopMask)
+            break;
+    }
+    return executed;
+}
+
+uint32_t Chip8::RunCovered(uint32_t cycles, uint8_t stopMask)
+{
+    uint32_t executed = 0;
+    while (executed < cycles)
+    {
+        uint16_t opcode = Fetch();
+        // Fetch wrapped the PC if it had to
+        uint16_t pc = PC - 2;
+        DecodeAndExecute(opcode);
+        coverage[(uint16_t)(pc << 4 ^ PC)]++;
+        executed++;
+
+        if (instructionsPerTick == 0)
+        {
+            UpdateWallClockTimers();
+        }
+        else if (--instructionsUntilTick == 0)
+        {
+            TickTimers();
+            instructionsUntilTick = instructionsPerTick;
+        }
+
+        if (events & stopMask)
+            break;
+    }
+    return executed;
+}
+
+#ifdef CHIP8_PROFILER
+uint32_t Chip8::RunProfiled(uint32_t cycles, uint8_t stopMask)
+{
+    const DecodedOp *table = GetDecodeTable(profile);
+    uint32_t executed = 0;
+    while (executed < cycles)
+    {
+        uint16_t pc = PC;
+        uint16_t opcode = Fetch();
+        uint8_t op = table[opcode].op;
+        if (op == OP_DRAW_DXYN)
+        {
+            auto start = std::chrono::steady_clock::now();
+            DecodeAndExecute(opcode);
+            profiler->RecordDraw(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+        else
+        {
+            DecodeAndExecute(opcode);
+        }
+        profiler->Record(pc, opcode, op);
+        executed++;
+
+        if (instructionsPerTick == 0)
+        {
+            UpdateWallClockTimers();
+        }
+        else if (--instructionsUntilTick == 0)
+        {
+            TickTimers();
+            instructionsUntilTick = instructionsPerTick;
+        }
+
+        if (events & stopMask)
+            break;
+    }
+    return executed;
+}
+#endif
+
+// GCC and Clang support labels as values, which lets every handler jump straight to the next one
+#if defined(__GNUC__) || defined(__clang__)
+#define CHIP8_COMPUTED_GOTO
+#endif
+
+#ifdef CHIP8_COMPUTED_GOTO
+#define CASE(name) L_##name:
+#define DISPATCH() \
+    FETCH();       \
+    goto *labels[op.op]
+#else
+#define CASE(name) case name:
+#define DISPATCH() goto dispatch
+#endif
+
+// inside a block the PC only moves through decoded ops, so it is checked at block starts
+#define FETCH()                                                    \
+    if (Blocks)                                                    \
+    {                                                              \
+        if (blockOp == blockEnd)                                   \
+        {                                                          \
+            if (PC > lastPC)                                       \
+                WrapPC();                                          \
+            const CodeBlock *block = blockCache->Lookup(PC, memory); \
+            blockOp = block->ops;                                  \
+            blockEnd = block->ops + block->length;                 \
+        }                                                          \
+        op = *blockOp++;                                           \
+    }                                                              \
+    else                                                           \
+    {                                                              \
+        if (PC > lastPC)                                           \
+            WrapPC();                                              \
+        op = table[memory[PC] << 8 | memory[PC + 1]];              \
+    }                                                              \
+    if (Covered)                                                   \
+        opPC = PC;                                                 \
+    PC += 2;                                                       \
+    x = op.xy & 0xF;                                               \
+    y = op.xy >> 4
+
+// skip the next instruction. In a block the next op is the one not skipped, so leave the block.
+#define SKIP()                 \
+    do                         \
+    {                          \
+        SkipNext();            \
+        if (Blocks)            \
+            blockEnd = blockOp; \
+    } while (0)
+
+// memory was written, drop cached code it overlaps and stop running the current block
+#define WROTE_MEMORY(address, length)                          \
+    do                                                         \
+    {                                                          \
+        MarkWritten(address, length);                          \
+        if (Blocks && blockCache->Invalidate(address, length)) \
+            blockEnd = blockOp;                                \
+        if (Jit)                                               \
+            jitCache->Invalidate(address, length);             \
+    } while (0)
+
+// bookkeeping after every instruction, then on to the next one
+#define NEXT()                                            \
+    if (Covered)                                          \
+        coverage[(uint16_t)(opPC << 4 ^ PC)]++;           \
+    executed++;                                           \
+    if (!VirtualTime)                                     \
+    {                                                     \
+        UpdateWallClockTimers();                          \
+    }                                                     \
+    else if (--instructionsUntilTick == 0)                \
+    {                                                     \
+        TickTimers();                                     \
+        instructionsUntilTick = instructionsPerTick;      \
+    }                                                     \
+    if ((events & stopMask) || executed >= cycles)        \
+        goto done;                                        \
+    if (Jit && jitCache->Lookup(PC, memory))              \
+        goto done;                                        \
+    DISPATCH()
+
+template <bool VirtualTime, bool Blocks, bool Jit, uint8_t Quirks, bool Covered>
+uint32_t Chip8::RunPredecoded(uint32_t cycles, uint8_t stopMask)
+{
+    const DecodedOp *table = GetDecodeTable(profile);
+    // the last PC a whole opcode can be fetched from
+    const uint16_t lastPC = memoryMask - 1;
+    uint32_t executed = 0;
+    // remaining ops of the current block
+    const DecodedOp *blockOp = nullptr;
+    const DecodedOp *blockEnd = nullptr;
+    DecodedOp op;
+    uint8_t x;
+    uint8_t y;
+    // address of the current op, for the edge it makes
+    uint16_t opPC = 0;
+
+#ifdef CHIP8_COMPUTED_GOTO
+    // same order as Chip8Op
+    static const void *labels[] = {
+        &&L_OP_CLS_00E0,
+        &&L_OP_RET_00EE,
+        &&L_OP_JMP_1NNN,
+        &&L_OP_CALL_2NNN,
+        &&L_OP_SKIP_3XNN,
+        &&L_OP_SKIP_4XNN,
+        &&L_OP_SKIP_5XY0,
+        &&L_OP_SET_6XNN,
+        &&L_OP_ADD_7XNN,
+        &&L_OP_SETXY_8XY0,
+        &&L_OP_OR_8XY1,
+        &&L_OP_AND_8XY2,
+        &&L_OP_XOR_8XY3,
+        &&L_OP_ADD_8XY4,
+        &&L_OP_SUB_8XY5,
+        &&L_OP_SHR_8XY6,
+        &&L_OP_SUB2_8XY7,
+        &&L_OP_SHL_8XYE,
+        &&L_OP_SKIP_9XY0,
+        &&L_OP_SETI_ANNN,
+        &&L_OP_JMPOFF_BNNN,
+        &&L_OP_RAND_CXNN,
+        &&L_OP_DRAW_DXYN,
+        &&L_OP_SKIPKEY_EX9E,
+        &&L_OP_SKIPNKEY_EXA1,
+        &&L_OP_GETTIMER_FX07,
+        &&L_OP_WAITINPUT_FX0A,
+        &&L_OP_SETTIMER_FX15,
+        &&L_OP_SETSOUND_FX18,
+        &&L_OP_ADDI_FX1E,
+        &&L_OP_FONT_FX29,
+        &&L_OP_BCD_FX33,
+        &&L_OP_REGTOMEM_FX55,
+        &&L_OP_MEMTOREG_FX65,
+        &&L_OP_SCROLLDOWN_00CN,
+        &&L_OP_SCROLLRIGHT_00FB,
+        &&L_OP_SCROLLLEFT_00FC,
+        &&L_OP_EXIT_00FD,
+        &&L_OP_LORES_00FE,
+        &&L_OP_HIRES_00FF,
+        &&L_OP_BIGFONT_FX30,
+        &&L_OP_SAVEFLAGS_FX75,
+        &&L_OP_LOADFLAGS_FX85,
+        &&L_OP_SCROLLUP_00DN,
+        &&L_OP_SAVERANGE_5XY2,
+        &&L_OP_LOADRANGE_5XY3,
+        &&L_OP_LONGI_F000,
+        &&L_OP_PLANE_FN01,
+        &&L_OP_AUDIO_F002,
+        &&L_OP_PITCH_FX3A,
+        &&L_OP_TRAP};
+    static_assert(sizeof(labels) / sizeof(labels[0]) == OP_COUNT, "label table out of sync with Chip8Op");
+
+    DISPATCH();
+#else
+dispatch:
+    FETCH();
+    switch (op.op)
+    {
+#endif
+
+    CASE(OP_CLS_00E0)
+    {
+        ClearScreen();
+        NEXT();
+    }
+    CASE(OP_RET_00EE)
+    {
+        Return();
+        NEXT();
+    }
+    CASE(OP_JMP_1NNN)
+    {
+        PC = op.imm;
+        NEXT();
+    }
+    CASE(OP_CALL_2NNN)
+    {
+        // a skipped call goes on with the next instruction, but the block continues at the target
+        if (!Call(op.imm) && Blocks)
+            blockEnd = blockOp;
+        NEXT();
+    }
+    CASE(OP_SKIP_3XNN)
+    {
+        if (V[x] == op.imm)
+            SKIP();
+        NEXT();
+    }
+    CASE(OP_SKIP_4XNN)
+    {
+        if (V[x] != op.imm)
+            SKIP();
+        NEXT();
+    }
+    CASE(OP_SKIP_5XY0)
+    {
+        if (V[x] == V[y])
+            SKIP();
+        NEXT();
+    }
+    CASE(OP_SET_6XNN)
+    {
+        V[x] = (uint8_t)op.imm;
+        NEXT();
+    }
+    CASE(OP_ADD_7XNN)
+    {
+        V[x] += (uint8_t)op.imm;
+        NEXT();
+    }
+    CASE(OP_SETXY_8XY0)
+    {
+        V[x] = V[y];
+        NEXT();
+    }
+    CASE(OP_OR_8XY1)
+    {
+        V[x] |= V[y];
+        NEXT();
+    }
+    CASE(OP_AND_8XY2)
+    {
+        V[x] &= V[y];
+        NEXT();
+    }
+    CASE(OP_XOR_8XY3)
+    {
+        V[x] ^= V[y];
+        NEXT();
+    }
+    CASE(OP_ADD_8XY4)
+    {
+        V[0xF] = 0;
+        uint16_t sum = V[x] + V[y];
+        if (sum > 255)
+            V[0xF] = 1;
+        V[x] = sum & 0xFF;
+        NEXT();
+    }
+    CASE(OP_SUB_8XY5)
+    {
+        V[0xF] = 0;
+        if (V[x] > V[y])
+            V[0xF] = 1;
+        V[x] = V[x] - V[y];
+        NEXT();
+    }
+    CASE(OP_SHR_8XY6)
+    {
+        uint8_t source = (Quirks & QUIRK_SHIFT_VY) ? V[y] : V[x];
+        V[0xF] = 0;
+        if (source & 1)
+            V[0xF] = 1;
+        V[x] = source >> 1;
+        NEXT();
+    }
+    CASE(OP_SUB2_8XY7)
+    {
+        V[0xF] = 0;
+        if (V[y] > V[x])
+            V[0xF] = 1;
+        V[x] = V[y] - V[x];
+        NEXT();
+    }
+    CASE(OP_SHL_8XYE)
+    {
+        uint8_t source = (Quirks & QUIRK_SHIFT_VY) ? V[y] : V[x];
+        V[0xF] = 0;
+        if (source & 0x80)
+            V[0xF] = 1;
+        V[x] = source << 1;
+        NEXT();
+    }
+    CASE(OP_SKIP_9XY0)
+    {
+        if (V[x] != V[y])
+            SKIP();
+        NEXT();
+    }
+    CASE(OP_SETI_ANNN)
+    {
+        I = op.imm;
+        NEXT();
+    }
+    CASE(OP_JMPOFF_BNNN)
+    {
+        PC = op.imm + V[(Quirks & QUIRK_JUMP_VX) ? x : 0];
+        NEXT();
+    }
+    CASE(OP_RAND_CXNN)
+    {
+        V[x] = (NextRandom(randomState) >> 24) & op.imm;
+        NEXT();
+    }
+    CASE(OP_DRAW_DXYN)
+    {
+        DrawSprite<(Quirks & QUIRK_CLIP) != 0>(x, y, (uint8_t)op.imm);
+        NEXT();
+    }
+    CASE(OP_SKIPKEY_EX9E)
+    {
+        if (keys[V[x] & 0xF])
+            SKIP();
+        NEXT();
+    }
+    CASE(OP_SKIPNKEY_EXA1)
+    {
+        if (!keys[V[x] & 0xF])
+            SKIP();
+        NEXT();
+    }
+    CASE(OP_GETTIMER_FX07)
+    {
+        V[x] = delay;
+        NEXT();
+    }
+    CASE(OP_WAITINPUT_FX0A)
+    {
+        WaitForKey(x);
+        // still waiting, PC was moved back onto this instruction
+        if (Blocks && (events & EVENT_KEYWAIT))
+            blockEnd = blockOp;
+        NEXT();
+    }
+    CASE(OP_SETTIMER_FX15)
+    {
+        delay = V[x];
+        NEXT();
+    }
+    CASE(OP_SETSOUND_FX18)
+    {
+        sound = V[x];
+        soundThisFrame |= sound > 0;
+        events |= EVENT_SOUND;
+        NEXT();
+    }
+    CASE(OP_ADDI_FX1E)
+    {
+        I += V[x];
+        NEXT();
+    }
+    CASE(OP_FONT_FX29)
+    {
+        I = FONT_ADDRESS + V[x] * 5;
+        NEXT();
+    }
+    CASE(OP_BCD_FX33)
+    {
+        StoreBCD(x);
+        WROTE_MEMORY(I, 3);
+        NEXT();
+    }
+    CASE(OP_REGTOMEM_FX55)
+    {
+        StoreRegisters(x);
+        WROTE_MEMORY(I, x + 1);
+        if (Quirks & QUIRK_LOAD_STORE_I)
+            I += x + 1;
+        NEXT();
+    }
+    CASE(OP_MEMTOREG_FX65)
+    {
+        LoadRegisters(x);
+        if (Quirks & QUIRK_LOAD_STORE_I)
+            I += x + 1;
+        NEXT();
+    }
+    CASE(OP_SCROLLDOWN_00CN)
+    {
+        ScrollDown((uint8_t)op.imm);
+        NEXT();
+    }
+    CASE(OP_SCROLLRIGHT_00FB)
+    {
+        ScrollRight();
+        NEXT();
+    }
+    CASE(OP_SCROLLLEFT_00FC)
+    {
+        ScrollLeft();
+        NEXT();
+    }
+    CASE(OP_EXIT_00FD)
+    {
+        // halted, the PC stays on the 00FD
+        PC -= 2;
+        NEXT();
+    }
+    CASE(OP_LORES_00FE)
+    {
+        SetHires(false);
+        NEXT();
+    }
+    CASE(OP_HIRES_00FF)
+    {
+        SetHires(true);
+        NEXT();
+    }
+    CASE(OP_BIGFONT_FX30)
+    {
+        I = BIG_FONT_ADDRESS + (V[x] & 0xF) * 10;
+        NEXT();
+    }
+    CASE(OP_SAVEFLAGS_FX75)
+    {
+        memcpy(flags, V, x + 1);
+        NEXT();
+    }
+    CASE(OP_LOADFLAGS_FX85)
+    {
+        memcpy(V, flags, x + 1);
+        NEXT();
+    }
+    CASE(OP_SCROLLUP_00DN)
+    {
+        ScrollUp((uint8_t)op.imm);
+        NEXT();
+    }
+    CASE(OP_SAVERANGE_5XY2)
+    {
+        StoreRange(x, y);
+        WROTE_MEMORY(I, (x > y ? x - y : y - x) + 1);
+        NEXT();
+    }
+    CASE(OP_LOADRANGE_5XY3)
+    {
+        LoadRange(x, y);
+        NEXT();
+    }
+    CASE(OP_LONGI_F000)
+    {
+        LoadLongI();
+        NEXT();
+    }
+    CASE(OP_PLANE_FN01)
+    {
+        planeMask = x & 3;
+        NEXT();
+    }
+    CASE(OP_AUDIO_F002)
+    {
+        for (int i = 0; i < 16; i++)
+            audioPattern[i] = memory[(I + i) & memoryMask];
+        NEXT();
+    }
+    CASE(OP_PITCH_FX3A)
+    {
+        pitch = V[x];
+        NEXT();
+    }
+    CASE(OP_TRAP)
+    {
+        Trap(op.imm);
+        NEXT();
+    }
+
+#ifndef CHIP8_COMPUTED_GOTO
+    }
+#endif
+
+done:
+    return executed;
+}
+
+// every combination of quirks, so the predecoded engine never tests them per instruction
+#define QUIRK_VARIANT(quirks) {&Chip8::RunPredecoded<false, false, false, quirks>, &Chip8::RunPredecoded<true, false, false, quirks>}
+const Chip8::RunFunction Chip8::QUIRK_VARIANTS[QUIRK_COMBINATIONS][2] = {
+    QUIRK_VARIANT(0), QUIRK_VARIANT(1), QUIRK_VARIANT(2), QUIRK_VARIANT(3),
+    QUIRK_VARIANT(4), QUIRK_VARIANT(5), QUIRK_VARIANT(6), QUIRK_VARIANT(7),
+    QUIRK_VARIANT(8), QUIRK_VARIANT(9), QUIRK_VARIANT(10), QUIRK_VARIANT(11),
+    QUIRK_VARIANT(12), QUIRK_VARIANT(13), QUIRK_VARIANT(14), QUIRK_VARIANT(15)};
+#undef QUIRK_VARIANT
+
+template <bool VirtualTime>
+uint32_t Chip8::RunJit(uint32_t cycles, uint8_t stopMask)
+{
+    uint32_t executed = 0;
+    while (executed < cycles)
+    {
+        const JitRun *run = jitCache->Lookup(PC, memory);
+
+        // compiled runs raise no events, they stop at the end of the budget or the next timer tick
+        if (run)
+        {
+            uint32_t limit = cycles - executed;
+            if (VirtualTime && instructionsUntilTick < limit)
+                limit = instructionsUntilTick;
+            uint32_t result = run->code(V, &I, limit);
+            uint32_t count = result >> 16;
+            PC = result & 0xFFFF;
+            executed += count;
+
+            if (!VirtualTime)
+            {
+                UpdateWallClockTimers();
+            }
+            else
+            {
+                instructionsUntilTick -= count;
+                if (instructionsUntilTick == 0)
+                {
+                    TickTimers();
+                    instructionsUntilTick = instructionsPerTick;
+                }
+            }
+        }
+        else
+        {
+            // interpret up to the start of the next compiled run
+            executed += RunPredecoded<VirtualTime, false, true>(cycles - executed, stopMask);
+        }
+
+        if (events & stopMask)
+            break;
+    }
+    return executed;
+}
+
+#undef CASE
+#undef DISPATCH
+#undef FETCH
+#undef NEXT
+#undef WROTE_MEMORY
+#undef SKIP
+
+uint32_t Chip8::RunUntilFrame(uint8_t stopMask)
+{
+    return RunCycles(UINT32_MAX, stopMask | EVENT_FRAME);
+}
+
+void Chip8::SetProfiler(Profiler *profiler)
+{
+#ifdef CHIP8_PROFILER
+    this->profiler = profiler;
+    // the interpreter does not keep the caches up to date, code may change while profiling
+    if (blockCache)
+        blockCache->Flush();
+    if (jitCache)
+        jitCache->Flush();
+#else
+    (void)profiler;
+#endif
+}
+
+void Chip8::SetProfile(Profile profile)
+{
+    this->profile = profile;
+    memoryMask = (uint16_t)(GetMemorySize(profile) - 1);
+    pageShift = profile == PROFILE_XOCHIP ? 12 : 8;
+    AllocateMemory();
+    ResetState();
+}
+
+void Chip8::SetEngine(Engine engine)
+{
+    this->engine = engine;
+
+    if (engine == ENGINE_JIT)
+    {
+        if (JitCache::IsSupported())
+        {
+            if (!jitCache)
+                jitCache.reset(new JitCache());
+            jitCache->Flush();
+            return;
+        }
+
+        printf("JIT not supported on this platform, using the block engine\n");
+        this->engine = engine = ENGINE_BLOCK;
+    }
+
+    // memory may have changed under another engine
+    if (engine == ENGINE_BLOCK)
+    {
+        if (!blockCache)
+            blockCache.reset(new BlockCache());
+        blockCache->Flush();
+    }
+}
+
+void Chip8::Trap(uint16_t opcode)
+{
+    trapCount++;
+    lastTrapOpcode = opcode;
+    events |= EVENT_TRAP;
+}
+
+void Chip8::RaiseFault(Fault fault, uint16_t pc)
+{
+    faultCount++;
+    lastFault = fault;
+    lastFaultPC = pc;
+    events |= EVENT_FAULT;
+}
+
+void Chip8::WrapPC()
+{
+    RaiseFault(FAULT_PC, PC);
+    PC &= memoryMask;
+    if (PC == memoryMask)
+        PC = 0;
+}
+
+void Chip8::SetQuirks(uint8_t quirks)
+{
+    this->quirks = quirks & (QUIRK_COMBINATIONS - 1);
+    predecodedVariant = QUIRK_VARIANTS[this->quirks];
+}
+
+const char *Chip8::GetQuirkName(Quirk quirk)
+{
+    switch (quirk)
+    {
+    case QUIRK_SHIFT_VY:
+        return "shift";
+    case QUIRK_LOAD_STORE_I:
+        return "loadstore";
+    case QUIRK_CLIP:
+        return "clip";
+    case QUIRK_JUMP_VX:
+        return "jump";
+    default:
+        return "none";
+    }
+}
+
+bool Chip8::ParseQuirks(const char *names, uint8_t &quirks)
+{
+    quirks = QUIRK_NONE;
+    std::string name;
+    for (const char *c = names;; c++)
+    {
+        if (*c && *c != ',' && *c != ' ' && *c != '\t')
+        {
+            name += (char)tolower((unsigned char)*c);
+            continue;
+        }
+
+        if (!name.empty() && name != "none")
+        {
+            int bit = 0;
+            while (bit < 4 && name != GetQuirkName((Quirk)(1 << bit)))
+                bit++;
+            if (bit == 4)
+                return 1;
+            quirks |= 1 << bit;
+        }
+        name.clear();
+        if (!*c)
+            return 0;
+    }
+}
+
+const char *Chip8::GetFaultName(Fault fault)
+{
+    switch (fault)
+    {
+    case FAULT_STACK_OVERFLOW:
+        return "stack overflow";
+    case FAULT_STACK_UNDERFLOW:
+        return "stack underflow";
+    case FAULT_MEMORY:
+        return "memory out of range";
+    case FAULT_PC:
+        return "PC out of range";
+    default:
+        return "none";
+    }
+}
+
+void Chip8::SetCoverage(uint8_t *coverage)
+{
+    this->coverage = coverage;
+    // the interpreter does not keep the caches up to date, code may change while covered
+    if (blockCache)
+        blockCache->Flush();
+    if (jitCache)
+        jitCache->Flush();
+}
+
+uint16_t Chip8::Fetch()
+{
+    if (PC > memoryMask - 1)
+        WrapPC();
+    uint16_t ret = 0;
+    ret = memory[PC] << 8 | memory[PC + 1];
+    PC += 2;
+    return ret;
+}
+
+void Chip8::DecodeAndExecute(uint16_t pOpcode)
+{
+    uint8_t highNibble = (pOpcode & 0xF000) >> 12;
+
+    // index into function table on the high nibble and call the respective function
+    (this->*(FunctionTable[highNibble]))(pOpcode);
+}
+
+void Chip8::SetKeyState(uint8_t keyCode, uint8_t state)
+{
+    if (keyCode > 0xF)
+        return;
+
+    keys[keyCode] = state;
+}
+
+const uint8_t *Chip8::GetScreen()
+{
+    int width = GetScreenWidth();
+    int words = width / 64;
+    for (int y = 0; y < GetScreenHeight(); y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            int word = y * words + x / 64;
+            int shift = 63 - (x & 63);
+            screen[x + y * width] = ((display[0][word] >> shift) & 1) | ((display[1][word] >> shift) & 1) << 1;
+        }
+    }
+    return screen;
+}
+
+bool Chip8::LoadRom(const uint8_t *romData, uint32_t romSize)
+{
+    if (BuildImage(romData, romSize, ownImage, profile) != 0)
+    {
+        printf("Rom Is Too Large!\n");
+        ResetState();
+        return 1;
+    }
+
+    romImage = ownImage;
+    romHash = 0;
+    Reset();
+
+    return 0;
+}
+
+void Chip8::LoadImage(const uint8_t *image, uint32_t hash)
+{
+    romImage = image;
+    romHash = hash;
+    Reset();
+}
+
+bool Chip8::BuildImage(const uint8_t *romData, uint32_t romSize, uint8_t *image, Profile profile)
+{
+    uint32_t memorySize = GetMemorySize(profile);
+    if (romSize >= (memorySize - 0x200))
+        return 1;
+
+    memset(image, 0, memorySize);
+    //load ROM into memory
+    if (romSize)
+        std::memcpy(&image[0x200], romData, romSize);
+    //load FONT
+    std::memcpy(&image[FONT_ADDRESS], font, sizeof(font));
+    if (profile != PROFILE_CHIP8)
+        std::memcpy(&image[BIG_FONT_ADDRESS], bigFont, sizeof(bigFont));
+
+    return 0;
+}
+
+/*
+Save state format, all values little endian:
+    "C8ST", version (1 byte), ROM image hash (4), quirks (1), high resolution (1)
+    PC (2), I (2), sp (1), delay (1), sound (1), V (16), stack (16 x 2), keys as a bitmask (2)
+    cycle count (8), instructions until tick (4), trap count (4), last trap opcode (2), CXNN generator (8)
+    SUPER-CHIP and XO-CHIP only: plane mask (1), flag registers (16), audio pattern (16), pitch (1)
+    display: every plane of the profile (2 for XO-CHIP, else 1) as its rows at the saved
+    resolution, 8 bytes per 64 pixels
+    memory ranges that differ from the ROM image: offset (2), length (2), bytes.
+    Ends with a length of 0.
+The profile is not stored, the ROM hash differs between profiles.
+*/
+static const uint8_t STATE_MAGIC[4] = {'C', '8', 'S', 'T'};
+static const uint8_t STATE_VERSION = 4;
+static const size_t STATE_FIXED_SIZE = 4 + 1 + 4 + 1 + 1 + 2 + 2 + 1 + 1 + 1 + 16 + 32 + 2 + 8 + 4 + 4 + 2 + 8;
+static const size_t STATE_EXTENDED_SIZE = 1 + 16 + 16 + 1;
+// equal bytes shorter than this between two changed ranges are stored rather than starting a new range
+static const int STATE_MERGE_GAP = 4;
+
+static void Put(std::vector<uint8_t> &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+static uint64_t Get(const uint8_t *&data, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)data[i] << (i * 8);
+    data += bytes;
+    return value;
+}
+
+uint32_t Chip8::HashImage(const uint8_t *image, uint32_t size)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (uint32_t i = 0; i < size; i++)
+        hash = (hash ^ image[i]) * 16777619u;
+    return hash;
+}
+
+void Chip8::GetDigest(StateDigest &digest)
+{
+    memcpy(digest.V, V, sizeof(V));
+    memcpy(digest.stack, stack, sizeof(stack));
+    digest.sp = sp;
+    digest.PC = PC;
+    digest.I = I;
+    digest.delay = delay;
+    digest.sound = sound;
+    digest.trapCount = trapCount;
+    digest.randomState = randomState;
+    digest.memoryHash = HashImage(memory, GetMemorySize());
 
-    sp = 0;
-    for (int i = 0; i < 16; i++)
+    // the words in use, so the original's hash covers its 32 rows as it always has
+    size_t words = GetScreenHeight() * GetScreenWidth() / 64;
+    uint32_t hash = 2166136261u;
+    for (int plane = 0; plane < (profile == PROFILE_XOCHIP ? 2 : 1); plane++)
     {
-        V[i] = 0;
-        keys[i] = 0;
+        const uint8_t *bytes = (const uint8_t *)display[plane];
+        for (size_t i = 0; i < words * 8; i++)
+            hash = (hash ^ bytes[i]) * 16777619u;
     }
+    digest.displayHash = hash;
+}
 
-    //reset memory
-    memset(memory, 0,0x1000);
+void Chip8::SaveState(std::vector<uint8_t> &out)
+{
+    out.clear();
+    for (uint8_t byte : STATE_MAGIC)
+        out.push_back(byte);
+    Put(out, STATE_VERSION, 1);
+    Put(out, GetRomHash(), 4);
+    Put(out, quirks, 1);
+    Put(out, hires, 1);
 
-    for (int i = 0; i < 64 * 32; i++)
-        display[i] = 0;
+    Put(out, PC, 2);
+    Put(out, I, 2);
+    Put(out, sp, 1);
+    Put(out, delay, 1);
+    Put(out, sound, 1);
+    out.insert(out.end(), V, V + 16);
+    for (int i = 0; i < 16; i++)
+        Put(out, stack[i], 2);
+    uint16_t keyMask = 0;
+    for (int i = 0; i < 16; i++)
+        keyMask |= (keys[i] ? 1 : 0) << i;
+    Put(out, keyMask, 2);
 
-    PC = 0x200;
-    I = 0;
-    delay = 0;
-    sound = 0;
-}
+    Put(out, cycleCount, 8);
+    Put(out, instructionsUntilTick, 4);
+    Put(out, trapCount, 4);
+    Put(out, lastTrapOpcode, 2);
+    Put(out, randomState, 8);
 
-void Chip8::Cycle()
-{
-    uint16_t opcode = Fetch();
-    DecodeAndExecute(opcode);
+    if (profile != PROFILE_CHIP8)
+    {
+        Put(out, planeMask, 1);
+        out.insert(out.end(), flags, flags + 16);
+        out.insert(out.end(), audioPattern, audioPattern + 16);
+        Put(out, pitch, 1);
+    }
 
-    //timers
-    uint64_t currentTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-    unprocessedTime += ((double)(currentTime - lastTime) / 1000.0); 
-    lastTime = currentTime;
+    int words = GetScreenHeight() * GetScreenWidth() / 64;
+    for (int plane = 0; plane < (profile == PROFILE_XOCHIP ? 2 : 1); plane++)
+    {
+        for (int i = 0; i < words; i++)
+            Put(out, display[plane][i], 8);
+    }
 
-    while (unprocessedTime >= secondsPer60Hz)
+    int memorySize = (int)GetMemorySize();
+    int address = 0;
+    while (address < memorySize)
     {
-        if (delay > 0)
-            delay--;
-        if (sound > 0)
-            sound--;
+        // skip matching memory 8 bytes at a time
+        if (address + 8 <= memorySize && memcmp(&memory[address], &romImage[address], 8) == 0)
+        {
+            address += 8;
+            continue;
+        }
+        if (memory[address] == romImage[address])
+        {
+            address++;
+            continue;
+        }
 
-        unprocessedTime -= secondsPer60Hz;
+        // lengths have to fit in 2 bytes
+        int start = address;
+        int end = address + 1;
+        while (end < memorySize && end - start < 0xFFFF)
+        {
+            if (memory[end] != romImage[end])
+            {
+                end++;
+                continue;
+            }
+            int gap = end;
+            while (gap < memorySize && gap - end < STATE_MERGE_GAP && memory[gap] == romImage[gap])
+                gap++;
+            if (gap == memorySize || gap - end == STATE_MERGE_GAP || gap - start > 0xFFFF)
+                break;
+            end = gap;
+        }
+
+        Put(out, start, 2);
+        Put(out, end - start, 2);
+        out.insert(out.end(), &memory[start], &memory[end]);
+        address = end;
     }
+    Put(out, 0, 2);
+    Put(out, 0, 2);
 }
 
-uint16_t Chip8::Fetch()
+bool Chip8::LoadState(const uint8_t *data, size_t size)
 {
-    uint16_t ret = 0;
-    ret = memory[PC] << 8 | memory[PC + 1];
-    PC += 2;
-    return ret;
-}
+    const uint8_t *end = data + size;
+    if (size < STATE_FIXED_SIZE + 4 || memcmp(data, STATE_MAGIC, 4) != 0)
+        return false;
+    data += 4;
+    if (Get(data, 1) != STATE_VERSION || Get(data, 4) != GetRomHash())
+        return false;
+    // the same instructions behave differently under other quirks
+    if (Get(data, 1) != quirks)
+        return false;
+    uint8_t newHires = (uint8_t)Get(data, 1);
+    if (newHires > 1 || (newHires && profile == PROFILE_CHIP8))
+        return false;
 
-void Chip8::DecodeAndExecute(uint16_t pOpcode)
-{
-    uint8_t highNibble = (pOpcode & 0xF000) >> 12;
+    // check the display and memory ranges before changing anything
+    size_t extendedSize = profile != PROFILE_CHIP8 ? STATE_EXTENDED_SIZE : 0;
+    size_t displayWords = (newHires ? 128 : 32) * (profile == PROFILE_XOCHIP ? 2 : 1);
+    if (size < STATE_FIXED_SIZE + extendedSize + displayWords * 8 + 4)
+        return false;
+    const uint8_t *ranges = data + (STATE_FIXED_SIZE - 11) + extendedSize + displayWords * 8;
+    const uint8_t *cursor = ranges;
+    while (true)
+    {
+        if (end - cursor < 4)
+            return false;
+        uint64_t offset = Get(cursor, 2);
+        uint64_t length = Get(cursor, 2);
+        if (length == 0)
+            break;
+        if (offset + length > GetMemorySize() || (uint64_t)(end - cursor) < length)
+            return false;
+        cursor += length;
+    }
 
-    // index into function table on the high nibble and call the respective function
-    (this->*(FunctionTable[highNibble]))(pOpcode);
-}
+    uint16_t newPC = (uint16_t)Get(data, 2);
+    uint16_t newI = (uint16_t)Get(data, 2);
+    uint8_t newSp = (uint8_t)Get(data, 1);
+    if (newSp > 16)
+        return false;
 
-void Chip8::SetKeyState(uint8_t keyCode, uint8_t state)
-{
-    if (keyCode > 0xF)
-        return;
+    hires = newHires;
+    PC = newPC;
+    I = newI;
+    sp = newSp;
+    delay = (uint8_t)Get(data, 1);
+    sound = (uint8_t)Get(data, 1);
+    soundThisFrame = sound > 0;
+    memcpy(V, data, 16);
+    data += 16;
+    for (int i = 0; i < 16; i++)
+        stack[i] = (uint16_t)Get(data, 2);
+    uint16_t keyMask = (uint16_t)Get(data, 2);
+    for (int i = 0; i < 16; i++)
+        keys[i] = (keyMask >> i) & 1;
 
-    keys[keyCode] = state;
+    cycleCount = Get(data, 8);
+    instructionsUntilTick = (uint32_t)Get(data, 4);
+    trapCount = (uint32_t)Get(data, 4);
+    lastTrapOpcode = (uint16_t)Get(data, 2);
+    randomState = Get(data, 8);
+
+    if (profile != PROFILE_CHIP8)
+    {
+        planeMask = (uint8_t)Get(data, 1) & 3;
+        memcpy(flags, data, 16);
+        data += 16;
+        memcpy(audioPattern, data, 16);
+        data += 16;
+        pitch = (uint8_t)Get(data, 1);
+    }
+
+    memset(display, 0, sizeof(display));
+    int words = GetScreenHeight() * GetScreenWidth() / 64;
+    for (int plane = 0; plane < (profile == PROFILE_XOCHIP ? 2 : 1); plane++)
+    {
+        for (int i = 0; i < words; i++)
+            display[plane][i] = Get(data, 8);
+    }
+
+    memcpy(memory, romImage, GetMemorySize());
+    while (true)
+    {
+        uint16_t offset = (uint16_t)Get(data, 2);
+        uint16_t length = (uint16_t)Get(data, 2);
+        if (length == 0)
+            break;
+        memcpy(&memory[offset], data, length);
+        data += length;
+    }
+
+    // wall-clock timers restart from now, and code may have changed under the caches
+    lastTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    unprocessedTime = 0;
+    if (instructionsPerTick != 0 && (instructionsUntilTick == 0 || instructionsUntilTick > instructionsPerTick))
+        instructionsUntilTick = instructionsPerTick;
+    events = EVENT_NONE;
+    screenDirty = true;
+    dirtyPages = ~0u;
+    if (blockCache)
+        blockCache->Flush();
+    if (jitCache)
+        jitCache->Flush();
+
+    return true;
 }
 
-const uint8_t *Chip8::GetScreen()
+void Chip8::Capture(Snapshot &snapshot)
 {
-    return display;
+    size_t pageSize = (size_t)1 << pageShift;
+    for (int page = 0; page < SNAPSHOT_PAGE_COUNT; page++)
+    {
+        if ((dirtyPages & (1u << page)) || !basePages[page])
+        {
+            std::shared_ptr<uint8_t[]> copy(new uint8_t[pageSize]);
+            memcpy(copy.get(), &memory[page * pageSize], pageSize);
+            basePages[page] = std::move(copy);
+        }
+        snapshot.pages[page] = basePages[page];
+    }
+    if ((dirtyPages & (1u << SNAPSHOT_PAGE_COUNT)) || !baseDisplay)
+    {
+        // words past the current resolution are always clear, so only the used ones are kept
+        int planes = profile == PROFILE_XOCHIP ? PLANE_COUNT : 1;
+        baseDisplayWords = (uint16_t)(GetScreenWidth() / 64 * GetScreenHeight());
+        std::shared_ptr<uint64_t[]> copy(new uint64_t[planes * baseDisplayWords]);
+        for (int plane = 0; plane < planes; plane++)
+            memcpy(&copy[plane * baseDisplayWords], display[plane], baseDisplayWords * sizeof(uint64_t));
+        baseDisplay = std::move(copy);
+    }
+    snapshot.display = baseDisplay;
+    snapshot.displayWords = baseDisplayWords;
+    dirtyPages = 0;
+    snapshot.romHash = GetRomHash();
+    snapshot.pageShift = pageShift;
+
+    memcpy(snapshot.stack, stack, sizeof(stack));
+    snapshot.sp = sp;
+    snapshot.PC = PC;
+    snapshot.I = I;
+    memcpy(snapshot.V, V, sizeof(V));
+    snapshot.delay = delay;
+    snapshot.sound = sound;
+    snapshot.keys = 0;
+    for (int i = 0; i < 16; i++)
+        snapshot.keys |= (keys[i] ? 1 : 0) << i;
+    snapshot.cycleCount = cycleCount;
+    snapshot.instructionsUntilTick = instructionsUntilTick;
+    snapshot.trapCount = trapCount;
+    snapshot.lastTrapOpcode = lastTrapOpcode;
+    snapshot.randomState = randomState;
+    snapshot.hires = hires;
+    snapshot.planeMask = planeMask;
+    memcpy(snapshot.flags, flags, sizeof(flags));
+    memcpy(snapshot.audioPattern, audioPattern, sizeof(audioPattern));
+    snapshot.pitch = pitch;
 }
 
-bool Chip8::LoadRom(uint8_t *romData, uint32_t romSize)
+bool Chip8::Restore(const Snapshot &snapshot)
 {
-    //reset state
-    ResetState();
+    // Capture fills every page, so the first one is enough to tell an empty snapshot
+    if (!snapshot.pages[0] || !snapshot.display || snapshot.pageShift != pageShift || snapshot.romHash != GetRomHash())
+        return false;
 
-    //load ROM into memory
-    if (romSize >= (0x1000 - 0x200))
+    size_t pageSize = (size_t)1 << pageShift;
+    for (int page = 0; page < SNAPSHOT_PAGE_COUNT; page++)
     {
-        printf("Rom Is Too Large!\n");
-        return 1;
+        // live memory still matches basePages except where it was written
+        if ((dirtyPages & (1u << page)) || basePages[page] != snapshot.pages[page])
+        {
+            memcpy(&memory[page * pageSize], snapshot.pages[page].get(), pageSize);
+            if (blockCache)
+                blockCache->Invalidate((uint16_t)(page * pageSize), (uint16_t)pageSize);
+            if (jitCache)
+                jitCache->Invalidate((uint16_t)(page * pageSize), (uint16_t)pageSize);
+            basePages[page] = snapshot.pages[page];
+        }
     }
-    std::memcpy(&memory[0x200], romData, romSize);
-    //load FONT
-    std::memcpy(&memory[0x50], &font, 80);
+    if ((dirtyPages & (1u << SNAPSHOT_PAGE_COUNT)) || baseDisplay != snapshot.display)
+    {
+        int planes = profile == PROFILE_XOCHIP ? PLANE_COUNT : 1;
+        memset(display, 0, sizeof(display));
+        for (int plane = 0; plane < planes; plane++)
+            memcpy(display[plane], &snapshot.display[plane * snapshot.displayWords], snapshot.displayWords * sizeof(uint64_t));
+        baseDisplay = snapshot.display;
+        baseDisplayWords = snapshot.displayWords;
+        screenDirty = true;
+    }
+    dirtyPages = 0;
 
-    return 0;
+    memcpy(stack, snapshot.stack, sizeof(stack));
+    sp = snapshot.sp;
+    PC = snapshot.PC;
+    I = snapshot.I;
+    memcpy(V, snapshot.V, sizeof(V));
+    delay = snapshot.delay;
+    sound = snapshot.sound;
+    soundThisFrame = sound > 0;
+    for (int i = 0; i < 16; i++)
+        keys[i] = (snapshot.keys >> i) & 1;
+    cycleCount = snapshot.cycleCount;
+    instructionsUntilTick = snapshot.instructionsUntilTick;
+    trapCount = snapshot.trapCount;
+    lastTrapOpcode = snapshot.lastTrapOpcode;
+    randomState = snapshot.randomState;
+    hires = snapshot.hires;
+    planeMask = snapshot.planeMask;
+    memcpy(flags, snapshot.flags, sizeof(flags));
+    memcpy(audioPattern, snapshot.audioPattern, sizeof(audioPattern));
+    pitch = snapshot.pitch;
+
+    if (instructionsPerTick != 0 && (instructionsUntilTick == 0 || instructionsUntilTick > instructionsPerTick))
+        instructionsUntilTick = instructionsPerTick;
+    events = EVENT_NONE;
+    return true;
 }
 
 void Chip8::zeroGroup(uint16_t opcode)
 {
+    if (profile != PROFILE_CHIP8)
+    {
+        zeroGroupExtended(opcode);
+        return;
+    }
+
     uint8_t nibble = opcode & 0x000F;
     if (nibble == 0)
     {
@@ -124,20 +1432,193 @@ void Chip8::zeroGroup(uint16_t opcode)
     }
     else
     {
-        printf("Unknown ZeroGroup Opcode: %04x\n", opcode);
+        Trap(opcode);
     }
 }
 
+void Chip8::zeroGroupExtended(uint16_t opcode)
+{
+    if ((opcode & 0xFFF0) == 0x00C0)
+    {
+        scrollDown00CN(opcode);
+        return;
+    }
+    if ((opcode & 0xFFF0) == 0x00D0 && profile == PROFILE_XOCHIP)
+    {
+        scrollUp00DN(opcode);
+        return;
+    }
+
+    switch (opcode)
+    {
+    case 0x00E0:
+        cls00E0(opcode);
+        break;
+    case 0x00EE:
+        ret00EE(opcode);
+        break;
+    case 0x00FB:
+        scrollRight00FB(opcode);
+        break;
+    case 0x00FC:
+        scrollLeft00FC(opcode);
+        break;
+    case 0x00FD:
+        exit00FD(opcode);
+        break;
+    case 0x00FE:
+        lores00FE(opcode);
+        break;
+    case 0x00FF:
+        hires00FF(opcode);
+        break;
+    default:
+        Trap(opcode);
+    }
+}
 void Chip8::cls00E0(uint16_t opcode)
 {
-    for (int i = 0; i < 64 * 32; i++)
-        display[i] = 0;
+    ClearScreen();
+}
+void Chip8::ClearScreen()
+{
+    MarkDrawn();
+
+    size_t bytes = GetScreenHeight() * GetScreenWidth() / 8;
+    for (int plane = 0; plane < PLANE_COUNT; plane++)
+    {
+        if (planeMask & (1 << plane))
+            memset(display[plane], 0, bytes);
+    }
+}
+void Chip8::scrollDown00CN(uint16_t opcode)
+{
+    ScrollDown(opcode & 0x000F);
+}
+void Chip8::scrollUp00DN(uint16_t opcode)
+{
+    ScrollUp(opcode & 0x000F);
+}
+void Chip8::scrollRight00FB(uint16_t opcode)
+{
+    ScrollRight();
+}
+void Chip8::scrollLeft00FC(uint16_t opcode)
+{
+    ScrollLeft();
+}
+void Chip8::exit00FD(uint16_t opcode)
+{
+    // halted, the PC stays on the 00FD
+    PC -= 2;
+}
+void Chip8::lores00FE(uint16_t opcode)
+{
+    SetHires(false);
+}
+void Chip8::hires00FF(uint16_t opcode)
+{
+    SetHires(true);
+}
+void Chip8::SetHires(bool hires)
+{
+    MarkDrawn();
+    this->hires = hires;
+    memset(display, 0, sizeof(display));
+}
+// Scrolls move whole rows, or shift the words of each row, so 128x64 costs about as much as 64x32
+void Chip8::ScrollDown(uint8_t rows)
+{
+    MarkDrawn();
+    int height = GetScreenHeight();
+    int words = GetScreenWidth() / 64;
+    if (rows > height)
+        rows = height;
+
+    for (int plane = 0; plane < PLANE_COUNT; plane++)
+    {
+        if (!(planeMask & (1 << plane)))
+            continue;
+        uint64_t *rowWords = display[plane];
+        memmove(&rowWords[rows * words], rowWords, (height - rows) * words * sizeof(uint64_t));
+        memset(rowWords, 0, rows * words * sizeof(uint64_t));
+    }
+}
+void Chip8::ScrollUp(uint8_t rows)
+{
+    MarkDrawn();
+    int height = GetScreenHeight();
+    int words = GetScreenWidth() / 64;
+    if (rows > height)
+        rows = height;
+
+    for (int plane = 0; plane < PLANE_COUNT; plane++)
+    {
+        if (!(planeMask & (1 << plane)))
+            continue;
+        uint64_t *rowWords = display[plane];
+        memmove(rowWords, &rowWords[rows * words], (height - rows) * words * sizeof(uint64_t));
+        memset(&rowWords[(height - rows) * words], 0, rows * words * sizeof(uint64_t));
+    }
+}
+void Chip8::ScrollRight()
+{
+    MarkDrawn();
+    int height = GetScreenHeight();
+
+    for (int plane = 0; plane < PLANE_COUNT; plane++)
+    {
+        if (!(planeMask & (1 << plane)))
+            continue;
+        uint64_t *rowWords = display[plane];
+        for (int y = 0; y < height; y++)
+        {
+            // 4 pixels, leftmost pixel is the top bit
+            if (hires)
+            {
+                rowWords[y * 2 + 1] = rowWords[y * 2 + 1] >> 4 | rowWords[y * 2] << 60;
+                rowWords[y * 2] >>= 4;
+            }
+            else
+            {
+                rowWords[y] >>= 4;
+            }
+        }
+    }
+}
+void Chip8::ScrollLeft()
+{
+    MarkDrawn();
+    int height = GetScreenHeight();
+
+    for (int plane = 0; plane < PLANE_COUNT; plane++)
+    {
+        if (!(planeMask & (1 << plane)))
+            continue;
+        uint64_t *rowWords = display[plane];
+        for (int y = 0; y < height; y++)
+        {
+            if (hires)
+            {
+                rowWords[y * 2] = rowWords[y * 2] << 4 | rowWords[y * 2 + 1] >> 60;
+                rowWords[y * 2 + 1] <<= 4;
+            }
+            else
+            {
+                rowWords[y] <<= 4;
+            }
+        }
+    }
 }
 void Chip8::ret00EE(uint16_t opcode)
+{
+    Return();
+}
+void Chip8::Return()
 {
     if (sp == 0)
     {
-        printf("ERROR: Tried to RET when at end of call stack!\n");
+        RaiseFault(FAULT_STACK_UNDERFLOW, PC - 2);
         return;
     }
 
@@ -152,10 +1633,21 @@ void Chip8::jmp1NNN(uint16_t opcode)
 }
 void Chip8::call2NNN(uint16_t opcode)
 {
+    uint16_t addr = opcode & 0x0FFF;
+    Call(addr);
+}
+bool Chip8::Call(uint16_t addr)
+{
+    if (sp == 16)
+    {
+        RaiseFault(FAULT_STACK_OVERFLOW, PC - 2);
+        return false;
+    }
+
     stack[sp] = PC;
     sp++;
-    uint16_t addr = opcode & 0x0FFF;
     PC = addr;
+    return true;
 }
 void Chip8::skip3XNN(uint16_t opcode)
 {
@@ -163,7 +1655,7 @@ void Chip8::skip3XNN(uint16_t opcode)
     uint8_t val = opcode & 0x00FF;
 
     if (V[x] == val)
-        PC += 2;
+        SkipNext();
 }
 void Chip8::skip4XNN(uint16_t opcode)
 {
@@ -171,7 +1663,7 @@ void Chip8::skip4XNN(uint16_t opcode)
     uint8_t val = opcode & 0x00FF;
 
     if (V[x] != val)
-        PC += 2;
+        SkipNext();
 }
 void Chip8::skip5XY0(uint16_t opcode)
 {
@@ -179,7 +1671,52 @@ void Chip8::skip5XY0(uint16_t opcode)
     uint8_t y = (opcode & 0x00F0) >> 4;
 
     if (V[x] == V[y])
-        PC += 2;
+        SkipNext();
+}
+void Chip8::fiveGroup(uint16_t opcode)
+{
+    uint8_t nibble = opcode & 0x000F;
+    if (profile == PROFILE_XOCHIP && nibble == 2)
+        saveRange5XY2(opcode);
+    else if (profile == PROFILE_XOCHIP && nibble == 3)
+        loadRange5XY3(opcode);
+    else
+        skip5XY0(opcode);
+}
+void Chip8::saveRange5XY2(uint16_t opcode)
+{
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+
+    StoreRange(x, y);
+    MarkWritten(I, (x > y ? x - y : y - x) + 1);
+}
+void Chip8::StoreRange(uint8_t x, uint8_t y)
+{
+    int count = (x > y ? x - y : y - x) + 1;
+    int step = x > y ? -1 : 1;
+    if ((uint32_t)(I + count) > GetMemorySize())
+        RaiseFault(FAULT_MEMORY, PC - 2);
+
+    for (int i = 0; i < count; i++)
+        memory[(I + i) & memoryMask] = V[x + i * step];
+}
+void Chip8::loadRange5XY3(uint16_t opcode)
+{
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+
+    LoadRange(x, y);
+}
+void Chip8::LoadRange(uint8_t x, uint8_t y)
+{
+    int count = (x > y ? x - y : y - x) + 1;
+    int step = x > y ? -1 : 1;
+    if ((uint32_t)(I + count) > GetMemorySize())
+        RaiseFault(FAULT_MEMORY, PC - 2);
+
+    for (int i = 0; i < count; i++)
+        V[x + i * step] = memory[(I + i) & memoryMask];
 }
 void Chip8::set6XNN(uint16_t opcode)
 {
@@ -228,7 +1765,7 @@ void Chip8::eightGroup(uint16_t opcode)
         shl8XYE(opcode);
         break;
     default:
-        printf("Unkown 8 group opcode %04x\n", opcode);
+        Trap(opcode);
     }
 }
 void Chip8::setxy8XY0(uint16_t opcode)
@@ -296,22 +1833,26 @@ void Chip8::sub28XY7(uint16_t opcode)
 void Chip8::shr8XY6(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t source = (quirks & QUIRK_SHIFT_VY) ? V[y] : V[x];
 
     V[0xF] = 0;
-    if (V[x] & 1)
+    if (source & 1)
         V[0xF] = 1;
 
-    V[x] = V[x] >> 1;
+    V[x] = source >> 1;
 }
 void Chip8::shl8XYE(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t source = (quirks & QUIRK_SHIFT_VY) ? V[y] : V[x];
 
     V[0xF] = 0;
-    if (V[x] & 0x80)
+    if (source & 0x80)
         V[0xF] = 1;
 
-    V[x] = V[x] << 1;
+    V[x] = source << 1;
 }
 void Chip8::skip9XY0(uint16_t opcode)
 {
@@ -320,7 +1861,7 @@ void Chip8::skip9XY0(uint16_t opcode)
 
     if (V[x] != V[y])
     {
-        PC += 2;
+        SkipNext();
     }
 }
 void Chip8::setIANNN(uint16_t opcode)
@@ -331,14 +1872,15 @@ void Chip8::setIANNN(uint16_t opcode)
 void Chip8::jmpoffBNNN(uint16_t opcode)
 {
     uint16_t val = opcode & 0x0FFF;
-    PC = val + V[0];
+    uint8_t x = (quirks & QUIRK_JUMP_VX) ? (opcode & 0x0F00) >> 8 : 0;
+    PC = val + V[x];
 }
 void Chip8::randCXNN(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
     uint8_t mask = opcode & 0x00FF;
 
-    V[x] = rand() & mask;
+    V[x] = (NextRandom(randomState) >> 24) & mask;
 }
 void Chip8::drawDXYN(uint16_t opcode)
 {
@@ -346,34 +1888,86 @@ void Chip8::drawDXYN(uint16_t opcode)
     uint8_t y = (opcode & 0x00F0) >> 4;
     uint8_t N = opcode & 0x000F;
 
-    uint8_t xPos = (V[x]) % 64;
-    uint8_t yPos = (V[y]) % 32;
+    if (quirks & QUIRK_CLIP)
+        DrawSprite<true>(x, y, N);
+    else
+        DrawSprite<false>(x, y, N);
+}
+template <bool Clip>
+void Chip8::DrawSprite(uint8_t x, uint8_t y, uint8_t N)
+{
+    // DXY0 is a 16x16 sprite outside the original, two bytes per row
+    bool wide = N == 0 && profile != PROFILE_CHIP8;
+    int rows = wide ? 16 : N;
+    int spriteBytes = wide ? 32 : N;
+    int width = GetScreenWidth();
+    int height = GetScreenHeight();
+    uint8_t xPos = V[x] & (width - 1);
+    uint8_t yPos = V[y] & (height - 1);
 
     V[0xF] = 0; //clear flag bit
+    MarkDrawn();
+
+    // XO-CHIP draws a sprite per selected plane, one after the other in memory
+    int planes = (planeMask & 1) + (planeMask >> 1 & 1);
+    if (spriteBytes && (uint32_t)(I + spriteBytes * planes) > GetMemorySize())
+        RaiseFault(FAULT_MEMORY, PC - 2);
 
-    for (int i = 0; i < N; i++)
+    uint16_t address = I;
+    for (int plane = 0; plane < PLANE_COUNT; plane++)
     {
-        uint8_t curLineByte = memory[I + i];
-        for (int bit = 0; bit < 8; bit++)
+        if (!(planeMask & (1 << plane)))
+            continue;
+        uint64_t *rowWords = display[plane];
+
+        for (int i = 0; i < rows; i++)
         {
-            int xPix = (xPos + bit) % 64;
-            int yPix = (yPos + i) % 32;
+            // sprite row in the top bits, rotated into place. Rotating wraps pixels past the right edge, shifting clips them.
+            uint64_t line;
+            if (wide)
+                line = (uint64_t)(memory[(address + i * 2) & memoryMask] << 8 | memory[(address + i * 2 + 1) & memoryMask]) << 48;
+            else
+                line = (uint64_t)memory[(address + i) & memoryMask] << 56;
+            // clipped sprites stop at the bottom edge instead of wrapping to the top
+            if (Clip && yPos + i >= height)
+                break;
+            int row = (yPos + i) & (height - 1);
 
-            //pixel is ON
-            if (curLineByte & (0x80) >> bit)
+            if (!hires)
             {
-                //if already on turn off and set flag bit
-                if (display[xPix + yPix * 64])
-                {
-                    display[xPix + yPix * 64] = 0;
+                line = Clip ? line >> xPos : (line >> xPos) | (line << ((64 - xPos) & 63));
+
+                uint64_t &word = rowWords[row];
+                //any pixel already on gets turned off and sets the flag bit
+                if (word & line)
                     V[0xF] = 1;
-                }
-                else
-                {
-                    display[xPix + yPix * 64] = 1;
-                }
+                word ^= line;
+                continue;
+            }
+
+            // the same on a 128 pixel row held in two words
+            uint64_t left = line;
+            uint64_t right = 0;
+            int shift = xPos & 63;
+            if (xPos & 64)
+            {
+                right = left;
+                left = 0;
+            }
+            if (shift)
+            {
+                uint64_t newLeft = Clip ? left >> shift : left >> shift | right << (64 - shift);
+                right = right >> shift | left << (64 - shift);
+                left = newLeft;
             }
+
+            uint64_t *words = &rowWords[row * 2];
+            if ((words[0] & left) | (words[1] & right))
+                V[0xF] = 1;
+            words[0] ^= left;
+            words[1] ^= right;
         }
+        address += spriteBytes;
     }
 }
 void Chip8::egroup(uint16_t opcode)
@@ -389,20 +1983,20 @@ void Chip8::egroup(uint16_t opcode)
     }
     else
     {
-        printf("Unknown E group opcode %04x\n", opcode);
+        Trap(opcode);
     }
 }
 void Chip8::skipkeyEX9E(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
-    if (keys[V[x]])
-        PC += 2;
+    if (keys[V[x] & 0xF])
+        SkipNext();
 }
 void Chip8::skipnkeyEXA1(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
-    if (!keys[V[x]])
-        PC += 2;
+    if (!keys[V[x] & 0xF])
+        SkipNext();
 }
 void Chip8::fgroup(uint16_t opcode)
 {
@@ -437,7 +2031,23 @@ void Chip8::fgroup(uint16_t opcode)
         memtoregFX65(opcode);
         break;
     default:
-        printf("Unkown F group opcode %04x\n", opcode);
+        // SUPER-CHIP and XO-CHIP
+        if (profile == PROFILE_XOCHIP && opcode == 0xF000)
+            longIF000(opcode);
+        else if (profile == PROFILE_XOCHIP && opcode == 0xF002)
+            audioF002(opcode);
+        else if (profile == PROFILE_XOCHIP && lowByte == 0x01)
+            planeFN01(opcode);
+        else if (profile != PROFILE_CHIP8 && lowByte == 0x30)
+            bigFontFX30(opcode);
+        else if (profile != PROFILE_CHIP8 && lowByte == 0x75)
+            saveFlagsFX75(opcode);
+        else if (profile != PROFILE_CHIP8 && lowByte == 0x85)
+            loadFlagsFX85(opcode);
+        else if (profile == PROFILE_XOCHIP && lowByte == 0x3A)
+            pitchFX3A(opcode);
+        else
+            Trap(opcode);
     }
 }
 void Chip8::gettimerFX07(uint16_t opcode)
@@ -454,6 +2064,8 @@ void Chip8::setsoundFX18(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
     sound = V[x];
+    soundThisFrame |= sound > 0;
+    events |= EVENT_SOUND;
 }
 void Chip8::addIFX1E(uint16_t opcode)
 {
@@ -464,6 +2076,10 @@ void Chip8::waitinputFX0A(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
 
+    WaitForKey(x);
+}
+void Chip8::WaitForKey(uint8_t x)
+{
     PC -= 2;
 
     for (int i = 0; i < 16; i++)
@@ -472,40 +2088,108 @@ void Chip8::waitinputFX0A(uint16_t opcode)
         {
             PC += 2;
             V[x] = i;
-            break;
+            return;
         }
     }
+
+    events |= EVENT_KEYWAIT;
 }
 void Chip8::getFontCharFX29(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
 
-    I = 0x50 + V[x] * 5;
+    I = FONT_ADDRESS + V[x] * 5;
 }
 void Chip8::bcdtomemFX33(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
+
+    StoreBCD(x);
+    MarkWritten(I, 3);
+}
+void Chip8::StoreBCD(uint8_t x)
+{
     uint8_t val = V[x];
+    if ((uint32_t)(I + 3) > GetMemorySize())
+        RaiseFault(FAULT_MEMORY, PC - 2);
 
-    memory[I] = val / 100;
-    memory[I + 1] = (val % 100) / 10;
-    memory[I + 2] = val % 10;
+    memory[I & memoryMask] = val / 100;
+    memory[(I + 1) & memoryMask] = (val % 100) / 10;
+    memory[(I + 2) & memoryMask] = val % 10;
 }
 void Chip8::regtomemFX55(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
 
+    StoreRegisters(x);
+    MarkWritten(I, x + 1);
+    if (quirks & QUIRK_LOAD_STORE_I)
+        I += x + 1;
+}
+void Chip8::StoreRegisters(uint8_t x)
+{
+    if ((uint32_t)(I + x + 1) > GetMemorySize())
+        RaiseFault(FAULT_MEMORY, PC - 2);
+
     for (int i = 0; i <= x; i++)
     {
-        memory[I + i] = V[i];
+        memory[(I + i) & memoryMask] = V[i];
     }
 }
 void Chip8::memtoregFX65(uint16_t opcode)
 {
     uint8_t x = (opcode & 0x0F00) >> 8;
 
+    LoadRegisters(x);
+    if (quirks & QUIRK_LOAD_STORE_I)
+        I += x + 1;
+}
+void Chip8::LoadRegisters(uint8_t x)
+{
+    if ((uint32_t)(I + x + 1) > GetMemorySize())
+        RaiseFault(FAULT_MEMORY, PC - 2);
+
     for (int i = 0; i <= x; i++)
     {
-        V[i] = memory[I + i];
+        V[i] = memory[(I + i) & memoryMask];
     }
+}
+void Chip8::longIF000(uint16_t opcode)
+{
+    LoadLongI();
+}
+void Chip8::LoadLongI()
+{
+    I = memory[PC & memoryMask] << 8 | memory[(PC + 1) & memoryMask];
+    PC += 2;
+}
+void Chip8::planeFN01(uint16_t opcode)
+{
+    planeMask = (opcode & 0x0F00) >> 8 & 3;
+}
+void Chip8::audioF002(uint16_t opcode)
+{
+    for (int i = 0; i < 16; i++)
+        audioPattern[i] = memory[(I + i) & memoryMask];
+}
+void Chip8::bigFontFX30(uint16_t opcode)
+{
+    uint8_t x = (opcode & 0x0F00) >> 8;
+
+    I = BIG_FONT_ADDRESS + (V[x] & 0xF) * 10;
+}
+void Chip8::pitchFX3A(uint16_t opcode)
+{
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    pitch = V[x];
+}
+void Chip8::saveFlagsFX75(uint16_t opcode)
+{
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    memcpy(flags, V, x + 1);
+}
+void Chip8::loadFlagsFX85(uint16_t opcode)
+{
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    memcpy(V, flags, x + 1);
 }
\ No newline at end of file
@@ -8,44 +8,436 @@
 #ifndef CHIP8_HPP
 #define CHIP8_HPP
 #include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+#include "Snapshot.hpp"
 
+class BlockCache;
+class JitCache;
+class Profiler;
 
 //forward declaration
 class Chip8Test;
 
+// The parts of a machine's state every engine has to agree on, see Chip8::GetDigest
+struct StateDigest
+{
+    uint8_t V[16];
+    uint16_t stack[16];
+    uint16_t sp;
+    uint16_t PC;
+    uint16_t I;
+    uint8_t delay;
+    uint8_t sound;
+    uint32_t trapCount;
+    uint64_t randomState;
+    // FNV-1a of memory and of the packed display
+    uint32_t memoryHash;
+    uint32_t displayHash;
+};
+
 class Chip8
 {
+public:
+    // Events raised while running. Batched runs stop early on these so the host can react.
+    enum Event : uint8_t
+    {
+        EVENT_NONE = 0,
+        // screen was drawn to or cleared
+        EVENT_DRAW = 1 << 0,
+        // sound timer was set or ran out
+        EVENT_SOUND = 1 << 1,
+        // FX0A is blocked waiting for a key press
+        EVENT_KEYWAIT = 1 << 2,
+        // timers ticked, i.e. a 60hz frame boundary was crossed
+        EVENT_FRAME = 1 << 3,
+        // an opcode the core does not implement was executed
+        EVENT_TRAP = 1 << 4,
+        // the ROM did something invalid, see Fault
+        EVENT_FAULT = 1 << 5,
+
+        EVENT_HOST = EVENT_DRAW | EVENT_SOUND | EVENT_KEYWAIT
+    };
+
+    // Execution engines. All run the same instruction semantics.
+    enum Engine : uint8_t
+    {
+        // dispatch on the raw opcode through FunctionTable, one group at a time
+        ENGINE_INTERPRETER,
+        // look up every opcode in a table decoded once, then threaded dispatch
+        ENGINE_PREDECODED,
+        // predecoded ops grouped into cached straight-line blocks
+        ENGINE_BLOCK,
+        // runs of ALU instructions compiled to x86-64, everything else predecoded.
+        // Falls back to ENGINE_BLOCK where the JIT is not supported.
+        ENGINE_JIT
+    };
+
+    /*
+    Invalid things a ROM can do. Each has a fixed outcome, the same on every engine,
+    so a faulty ROM keeps running and never touches memory outside the machine.
+    */
+    enum Fault : uint8_t
+    {
+        FAULT_NONE,
+        // 2NNN with all 16 stack entries in use. The call is skipped.
+        FAULT_STACK_OVERFLOW,
+        // 00EE with an empty stack. The return is skipped.
+        FAULT_STACK_UNDERFLOW,
+        // DXYN, FX33, FX55 or FX65 reached past 0xFFF. Addresses wrap around to 0.
+        FAULT_MEMORY,
+        // the PC left memory, or sits on 0xFFF where the opcode's second byte is missing.
+        // It wraps around, and 0xFFF goes to 0.
+        FAULT_PC
+    };
+
+    /*
+    Machines the core can be. Each one runs everything the one before it does.
+    The block and JIT engines only know the original instruction set, so the
+    others run on the predecoded engine when one of those is selected.
+    */
+    enum Profile : uint8_t
+    {
+        // the original: 4K memory and a 64x32 display
+        PROFILE_CHIP8,
+        /*
+        SUPER-CHIP 1.1: a 128x64 high resolution mode (00FF, 00FE to leave it), scrolling
+        down (00CN), right (00FB) and left (00FC) at the current resolution, 16x16 sprites
+        (DXY0), a large font (FX30), flag registers (FX75, FX85) and 00FD, which halts
+        */
+        PROFILE_SCHIP,
+        /*
+        XO-CHIP: SUPER-CHIP plus 64K memory, two display planes (FN01 selects which ones
+        CLS, DXYN and scrolls act on), scrolling up (00DN), saving and loading register
+        ranges (5XY2, 5XY3), a 16-bit I (F000 NNNN, which skips step over whole) and the
+        audio pattern (F002) and pitch (FX3A)
+        */
+        PROFILE_XOCHIP
+    };
+
+    /*
+    Behaviours ROMs were written against differently, as bit flags. 0 is what this
+    core has always done. The predecoded engine is compiled once per combination and
+    the variant is picked by SetQuirks, so quirks cost nothing per instruction there.
+    */
+    enum Quirk : uint8_t
+    {
+        QUIRK_NONE = 0,
+        // 8XY6 and 8XYE shift VY into VX, as on the COSMAC VIP, rather than shifting VX
+        QUIRK_SHIFT_VY = 1,
+        // FX55 and FX65 leave I just past the last register, as on the COSMAC VIP
+        QUIRK_LOAD_STORE_I = 2,
+        // DXYN cuts sprites off at the screen edges instead of wrapping them around
+        QUIRK_CLIP = 4,
+        // BNNN jumps to NNN + VX, X being the top digit of NNN, as on SUPER-CHIP
+        QUIRK_JUMP_VX = 8
+    };
+    static const int QUIRK_COMBINATIONS = 16;
+
+    // Size of the edge coverage map, see SetCoverage
+    static const uint32_t COVERAGE_MAP_SIZE = 1 << 16;
+    // Largest display and memory of any profile
+    static const int MAX_SCREEN_WIDTH = 128;
+    static const int MAX_SCREEN_HEIGHT = 64;
+    static const int PLANE_COUNT = 2;
+    static const uint32_t MAX_MEMORY_SIZE = 0x10000;
+
 public:
     Chip8();
     virtual ~Chip8();
 
     // Decode and execute a single CPU cycle
     void Cycle();
+    /*
+    Run up to pCycles instructions in one loop.
+    Stops early after any instruction that raises an event in pStopMask.
+    Returns the number of instructions executed.
+    */
+    uint32_t RunCycles(uint32_t pCycles, uint8_t pStopMask = EVENT_HOST);
+    /*
+    Run until the timers next tick, or earlier on an event in pStopMask.
+    In wall-clock mode the clock is read after every instruction, so prefer virtual time.
+    Returns the number of instructions executed.
+    */
+    uint32_t RunUntilFrame(uint8_t pStopMask = EVENT_HOST);
+    // Events raised since the last RunCycles or RunUntilFrame started
+    uint8_t GetEvents() { return events; }
+    // Select the execution engine (default ENGINE_PREDECODED)
+    void SetEngine(Engine pEngine);
+    Engine GetEngine() { return engine; }
+    /*
+    Select the machine (default PROFILE_CHIP8). This empties the machine, so load
+    the ROM afterwards. Images and ROM hashes differ between profiles.
+    */
+    void SetProfile(Profile pProfile);
+    Profile GetProfile() { return profile; }
+    /*
+    Select the quirks, Quirk flags OR'd together (default QUIRK_NONE). Save states record
+    them, so set them before LoadState. The block and JIT engines only run without quirks,
+    with any set they use the predecoded engine.
+    */
+    void SetQuirks(uint8_t pQuirks);
+    uint8_t GetQuirks() { return quirks; }
+    /*
+    Read quirks written as names, "shift", "loadstore", "clip" or "jump", separated by
+    commas or spaces. "none" or nothing is QUIRK_NONE.
+    Returns 1 if a name is unknown and 0 otherwise.
+    */
+    static bool ParseQuirks(const char *pNames, uint8_t &pQuirks);
+    // the name ParseQuirks reads for a single quirk
+    static const char *GetQuirkName(Quirk pQuirk);
+    // 4K, or 64K for XO-CHIP
+    uint32_t GetMemorySize() { return memoryMask + 1; }
+    static uint32_t GetMemorySize(Profile pProfile) { return pProfile == PROFILE_XOCHIP ? 0x10000 : 0x1000; }
+    /*
+    Count every instruction into pProfiler (nullptr, the default, to stop).
+    While attached the interpreter runs whatever the engine, so numbers are per instruction
+    rather than per engine. Does nothing in builds without CHIP8_PROFILER.
+    */
+    void SetProfiler(Profiler *pProfiler);
+    // Number of unknown opcodes executed since the ROM was loaded, and the last one seen
+    uint32_t GetTrapCount() { return trapCount; }
+    uint16_t GetLastTrapOpcode() { return lastTrapOpcode; }
+    /*
+    Number of faults since the ROM was loaded, the last one and the PC of the
+    instruction that caused it, or for FAULT_PC the PC that was out of range.
+    Faults are diagnostics and not part of saved state.
+    */
+    uint32_t GetFaultCount() { return faultCount; }
+    Fault GetLastFault() { return lastFault; }
+    uint16_t GetLastFaultPC() { return lastFaultPC; }
+    static const char *GetFaultName(Fault pFault);
+    /*
+    Count control flow edges into pMap, COVERAGE_MAP_SIZE counters indexed by a hash of
+    each instruction's address and the PC it left behind (nullptr, the default, to stop).
+    Counters wrap. While set, the engines other than the interpreter run the predecoded
+    engine with counting compiled in. With quirks or wall-clock timers, the interpreter runs.
+    */
+    void SetCoverage(uint8_t *pMap);
     // Load a ROM file - Returns 1 if an error occurred and 0 otherwise
-    bool LoadRom(uint8_t *pRomData, uint32_t pRomSize);
+    bool LoadRom(const uint8_t *pRomData, uint32_t pRomSize);
+    /*
+    Start from a memory image made by BuildImage for the current profile, such as the
+    entries of a RomLibrary set to it. The image is used in place (not copied) and
+    must stay valid while this ROM is loaded. pHash is its HashImage, or 0 to compute
+    it when needed.
+    */
+    void LoadImage(const uint8_t *pImage, uint32_t pHash = 0);
+    // Go back to the state right after loading: one copy from the ROM's image, no file I/O
+    void Reset();
+    /*
+    Lay out the fonts and a ROM in a memory image of GetMemorySize(pProfile) bytes, as
+    LoadRom does. Returns 1 if the ROM is too large and 0 otherwise.
+    */
+    static bool BuildImage(const uint8_t *pRomData, uint32_t pRomSize, uint8_t *pImage,
+                           Profile pProfile = PROFILE_CHIP8);
+    // FNV-1a hash of a memory image, what GetRomHash returns for it
+    static uint32_t HashImage(const uint8_t *pImage, uint32_t pSize = 0x1000);
     // Set keyboard state (keycode is [0,15], state is 0 or 1)
     void SetKeyState(uint8_t pKeyCode, uint8_t pState);
-    // get screen buffer (64x32 bytes, 1 = on, 0 = off)
+    /*
+    get screen buffer (GetScreenWidth x GetScreenHeight bytes, 0 = off). Each pixel has
+    a bit per plane it is on in, so 1 = on outside XO-CHIP. Unpacked from the display on every call.
+    */
     const uint8_t *GetScreen();
+    // current resolution, 128x64 in high resolution mode and 64x32 otherwise
+    int GetScreenWidth() { return hires ? 128 : 64; }
+    int GetScreenHeight() { return hires ? 64 : 32; }
+    // resolution the frontend has to be ready for, 128x64 for every profile but PROFILE_CHIP8
+    static int GetMaxScreenWidth(Profile pProfile) { return pProfile == PROFILE_CHIP8 ? 64 : 128; }
+    static int GetMaxScreenHeight(Profile pProfile) { return pProfile == PROFILE_CHIP8 ? 32 : 64; }
+    // get the memory, GetMemorySize bytes
+    const uint8_t *GetMemory() { return memory; }
+    /*
+    get a plane of the display as GetScreenHeight rows of GetScreenWidth / 64 words,
+    leftmost pixel in the most significant bit. Only XO-CHIP draws to plane 1.
+    */
+    const uint64_t *GetPackedScreen(int pPlane = 0) { return display[pPlane]; }
+    // Registers and memory and display hashes, for comparing machines cheaply
+    void GetDigest(StateDigest &pDigest);
+    // true if CLS or DXYN ran since the last MarkScreenClean (or since the last reset)
+    bool IsScreenDirty() { return screenDirty; }
+    // call after the current screen has been presented
+    void MarkScreenClean() { screenDirty = false; }
+    // a tone plays while the sound timer is above zero
+    uint8_t GetSoundTimer() { return sound; }
+    /*
+    true if the sound timer was above zero at any point in the frame the last timer tick
+    ended, even if it was set and ran out within it. What a host plays for that frame.
+    */
+    bool WasSoundOn() { return soundLastFrame; }
+    // XO-CHIP's 16-byte audio pattern and its pitch, see PROFILE_XOCHIP
+    const uint8_t *GetAudioPattern() { return audioPattern; }
+    uint8_t GetPitch() { return pitch; }
+
+    /*
+    Select how the delay and sound timers are clocked.
+    0 (the default) ticks them from the wall clock, for interactive use.
+    Any other value ticks them once every pInstructionsPerTick instructions,
+    so runs are deterministic and can go at full host speed.
+    */
+    void SetInstructionsPerTick(uint32_t pInstructionsPerTick);
+    uint32_t GetInstructionsPerTick() { return instructionsPerTick; }
+    // Advance the delay and sound timers by one 60hz tick
+    void TickTimers();
+    // Number of instructions executed since the ROM was loaded
+    uint64_t GetCycleCount() { return cycleCount; }
+    /*
+    Seed the generator behind CXNN (default 0). It restarts from the seed now and
+    on every LoadRom, so the same seed and inputs replay the same run.
+    */
+    void SetSeed(uint64_t pSeed);
+    uint64_t GetSeed() { return seed; }
+    // hash of the memory image LoadRom produced, identifies the ROM in save states and recordings
+    uint32_t GetRomHash()
+    {
+        // computed on first use, so reloading ROMs in a loop doesn't pay for it
+        if (romHash == 0)
+            romHash = HashImage(romImage, GetMemorySize());
+        return romHash;
+    }
+
+    /*
+    Write a snapshot of the machine into pOut, replacing its contents.
+    Memory is stored as the ranges that differ from the image LoadRom produced,
+    so a typical state is a few hundred bytes. Reuse pOut to avoid allocating.
+    Engine and timer mode are settings, not state, and are not saved.
+    */
+    void SaveState(std::vector<uint8_t> &pOut);
+    /*
+    Restore a snapshot written by SaveState.
+    The same ROM must be loaded, since memory is rebuilt from its image.
+    Returns false and leaves the machine untouched if the data is invalid,
+    from another ROM, saved under other quirks, or from an unknown format version.
+    */
+    bool LoadState(const uint8_t *pData, size_t pSize);
+
+    /*
+    Fork the current state into pSnapshot.
+    Only memory pages (and the display) written since the last Capture or Restore are
+    copied, everything else is shared with the snapshot those came from.
+    */
+    void Capture(Snapshot &pSnapshot);
+    /*
+    Return to a state made by Capture, which may come from any instance with the same ROM.
+    Only pages that differ from what this instance holds are copied back.
+    Returns false and leaves the machine untouched if the snapshot is empty (never
+    captured into) or comes from another ROM or profile.
+    */
+    bool Restore(const Snapshot &pSnapshot);
 
     //declare chip8Test as friend so it can access private members
     friend class Chip8Test;
 
 private:
-    // Reset processor registers, memory, etc
+    // Reset processor registers, memory, etc to an empty machine with no ROM
     void ResetState();
     // Fetch next instruction from Program Counter location
     uint16_t Fetch();
     // Decode an opcode and execute it
     void DecodeAndExecute(uint16_t pOpcode);
+    // Tick the timers for however much wall-clock time has passed
+    void UpdateWallClockTimers();
+    // Run instructions through FunctionTable
+    uint32_t RunInterpreter(uint32_t pCycles, uint8_t pStopMask);
+    // RunInterpreter that counts edges into coverage
+    uint32_t RunCovered(uint32_t pCycles, uint8_t pStopMask);
+#ifdef CHIP8_PROFILER
+    // RunInterpreter that reports every instruction to profiler
+    uint32_t RunProfiled(uint32_t pCycles, uint8_t pStopMask);
+#endif
+    /*
+    Run instructions through the predecoded opcode table, or through cached blocks of it.
+    With Jit set, also stops when the PC reaches the start of a compiled run. With Covered
+    set, counts edges into coverage as RunCovered does.
+    */
+    template <bool VirtualTime, bool Blocks, bool Jit, uint8_t Quirks = QUIRK_NONE, bool Covered = false>
+    uint32_t RunPredecoded(uint32_t pCycles, uint8_t pStopMask);
+    // RunPredecoded for each combination of quirks, on wall-clock [0] and virtual [1] time
+    typedef uint32_t (Chip8::*RunFunction)(uint32_t pCycles, uint8_t pStopMask);
+    static const RunFunction QUIRK_VARIANTS[QUIRK_COMBINATIONS][2];
+    // Run compiled code where there is some, and the predecoded engine elsewhere
+    template <bool VirtualTime>
+    uint32_t RunJit(uint32_t pCycles, uint8_t pStopMask);
+    // Size memory and ownImage for the profile, contents undefined
+    void AllocateMemory();
+    // Record a write to memory for Capture
+    void MarkWritten(uint16_t pAddress, uint16_t pLength)
+    {
+        dirtyPages |= (1u << ((pAddress >> pageShift) % SNAPSHOT_PAGE_COUNT)) |
+                      (1u << (((pAddress + pLength - 1) >> pageShift) % SNAPSHOT_PAGE_COUNT));
+    }
+    // Record a change to the display
+    void MarkDrawn()
+    {
+        events |= EVENT_DRAW;
+        screenDirty = true;
+        dirtyPages |= 1u << SNAPSHOT_PAGE_COUNT;
+    }
+    // Record an unknown opcode
+    void Trap(uint16_t pOpcode);
+    // Record a fault caused by the instruction at pPC
+    void RaiseFault(Fault pFault, uint16_t pPC);
+    // Bring an out of range PC back into memory, see FAULT_PC
+    void WrapPC();
+
+    // Shared by the engines
+    // Returns false if the stack was full and the call was skipped
+    bool Call(uint16_t pAddress);
+    void Return();
+    void ClearScreen();
+    template <bool Clip>
+    void DrawSprite(uint8_t pX, uint8_t pY, uint8_t pN);
+    // move the PC past the next instruction, all 4 bytes of an XO-CHIP F000 NNNN
+    void SkipNext()
+    {
+        PC += profile == PROFILE_XOCHIP && memory[PC & memoryMask] == 0xF0 && memory[(PC + 1) & memoryMask] == 0x00 ? 4 : 2;
+    }
+    void ScrollDown(uint8_t pRows);
+    void ScrollUp(uint8_t pRows);
+    void ScrollRight();
+    void ScrollLeft();
+    // switch between 64x32 and 128x64, which clears the display
+    void SetHires(bool pHires);
+    // 5XY2 and 5XY3, VX to VY in either direction
+    void StoreRange(uint8_t pX, uint8_t pY);
+    void LoadRange(uint8_t pX, uint8_t pY);
+    // F000 NNNN, the PC is just past the F000
+    void LoadLongI();
+    void WaitForKey(uint8_t pX);
+    void StoreBCD(uint8_t pX);
+    void StoreRegisters(uint8_t pX);
+    void LoadRegisters(uint8_t pX);
 
 private:
     // 16 element call stack
     uint16_t stack[16];
     // Stack pointer
     uint16_t sp;
-    // 4K memory
-    uint8_t memory[4096];
+    // which machine this is, see SetProfile
+    Profile profile = PROFILE_CHIP8;
+    // memory size - 1, addresses wrap with it
+    uint16_t memoryMask = 0xFFF;
+    // memory / SNAPSHOT_PAGE_COUNT is one snapshot page, 1 << pageShift bytes
+    uint8_t pageShift = 8;
+    // GetMemorySize bytes, allocated for the profile so a 4K machine stays small
+    uint8_t *memory;
+    // memory as it was right after the last LoadRom, save states only store what differs.
+    // ownImage, or an image shared through LoadImage.
+    const uint8_t *romImage;
+    // the image LoadRom builds, GetMemorySize bytes
+    uint8_t *ownImage;
+    // holds memory and ownImage, see AllocateMemory
+    std::unique_ptr<uint8_t[]> memoryStorage;
+    // hash of romImage, so states from another ROM are rejected. 0 until GetRomHash computes it.
+    uint32_t romHash;
+    // pages last captured or restored, shared with that snapshot
+    std::shared_ptr<const uint8_t[]> basePages[SNAPSHOT_PAGE_COUNT];
+    std::shared_ptr<const uint64_t[]> baseDisplay;
+    uint16_t baseDisplayWords = 0;
+    // bit per page written since then, bit SNAPSHOT_PAGE_COUNT is the display
+    uint32_t dirtyPages;
     // 16 registers
     uint8_t V[16];
     // program counter
@@ -58,18 +450,66 @@ private:
     uint8_t keys[16];
     // sound timer, counts down at 60hz until zero. plays tone when non-zero
     uint8_t sound;
+    // sound timer was above zero at some point in the current frame, and in the last one, see WasSoundOn
+    bool soundThisFrame = false;
+    bool soundLastFrame = false;
     // timer used to decrement sound and delay timers
     uint64_t lastTime;
     // constant for seconds per sound/delay tick
     const double secondsPer60Hz = 1.0 / 60.0;
     // used to accumulate time for sound/delay timers
     double unprocessedTime = 0;
+    // instructions per timer tick in virtual time mode, 0 for wall-clock timers
+    uint32_t instructionsPerTick = 0;
+    // instructions left until the next virtual timer tick
+    uint32_t instructionsUntilTick;
+    // instructions executed since reset
+    uint64_t cycleCount;
+    // Event bits raised by the current run
+    uint8_t events;
+    // which engine RunCycles uses
+    Engine engine = ENGINE_PREDECODED;
+    // see SetQuirks, and the row of QUIRK_VARIANTS the predecoded engine runs
+    uint8_t quirks = QUIRK_NONE;
+    const RunFunction *predecodedVariant = QUIRK_VARIANTS[QUIRK_NONE];
+    // decoded blocks for ENGINE_BLOCK, created when that engine is selected
+    std::unique_ptr<BlockCache> blockCache;
+    // generated code for ENGINE_JIT, created when that engine is selected
+    std::unique_ptr<JitCache> jitCache;
+    // counts instructions while set, see SetProfiler
+    Profiler *profiler = nullptr;
+    // edge counters while set, see SetCoverage
+    uint8_t *coverage = nullptr;
+    // unknown opcodes executed
+    uint32_t trapCount;
+    uint16_t lastTrapOpcode;
+    // see GetFaultCount
+    uint32_t faultCount;
+    Fault lastFault;
+    uint16_t lastFaultPC;
+    // CXNN generator state, see Random.hpp
+    uint64_t seed = 0;
+    uint64_t randomState;
 
-    //display buffer
-    uint8_t display[64 * 32];
+    //display planes, one bit per pixel in rows of 1 word (64x32) or 2 words (128x64). Bit 63 of a row's first word is x = 0.
+    //Words past the current resolution are always 0.
+    uint64_t display[PLANE_COUNT][MAX_SCREEN_WIDTH / 64 * MAX_SCREEN_HEIGHT];
+    //128x64 rather than 64x32, see SetHires
+    bool hires;
+    //planes CLS, DXYN and scrolls act on, bit per plane
+    uint8_t planeMask;
+    //set by anything that changes the display, cleared by the frontend once it has shown the frame
+    bool screenDirty;
+    //unpacked copy of the display for GetScreen
+    uint8_t screen[MAX_SCREEN_WIDTH * MAX_SCREEN_HEIGHT];
+    //FX75 and FX85 flag registers
+    uint8_t flags[16];
+    //XO-CHIP audio pattern (F002) and pitch (FX3A), 1 bit per sample
+    uint8_t audioPattern[16];
+    uint8_t pitch;
 
     // 16 character font
-    uint8_t font[80] = {
+    static constexpr uint8_t font[80] = {
         0xF0, 0x90, 0x90, 0x90, 0xF0, //0
         0x20, 0x60, 0x20, 0x20, 0x70, //1
         0xF0, 0x10, 0xF0, 0x80, 0xF0, //2
@@ -87,6 +527,27 @@ private:
         0xF0, 0x80, 0xF0, 0x80, 0xF0, //E
         0xF0, 0x80, 0xF0, 0x80, 0x80  //F
     };
+    // where font lives in memory, and the 8x10 font of FX30 right after it
+    static const uint16_t FONT_ADDRESS = 0x50;
+    static const uint16_t BIG_FONT_ADDRESS = 0xA0;
+    static constexpr uint8_t bigFont[160] = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, //0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, //1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, //2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, //4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, //6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, //7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, //8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, //9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, //A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, //B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, //C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, //D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, //E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  //F
+    };
 
 
     //function pointer table
@@ -96,7 +557,7 @@ private:
         &Chip8::call2NNN,
         &Chip8::skip3XNN,
         &Chip8::skip4XNN,
-        &Chip8::skip5XY0,
+        &Chip8::fiveGroup,
         &Chip8::set6XNN,
         &Chip8::add7XNN,
         &Chip8::eightGroup,
@@ -110,6 +571,15 @@ private:
 
     // opcodes that start at 0
     void zeroGroup(uint16_t opcode);
+    // SUPER-CHIP and XO-CHIP ones, which need the whole opcode
+    void zeroGroupExtended(uint16_t opcode);
+    void scrollDown00CN(uint16_t opcode);
+    void scrollUp00DN(uint16_t opcode);
+    void scrollRight00FB(uint16_t opcode);
+    void scrollLeft00FC(uint16_t opcode);
+    void exit00FD(uint16_t opcode);
+    void lores00FE(uint16_t opcode);
+    void hires00FF(uint16_t opcode);
     // clear screen
     void cls00E0(uint16_t opcode);
     // return from function call
@@ -125,6 +595,9 @@ private:
     void skip3XNN(uint16_t opcode);
     void skip4XNN(uint16_t opcode);
     void skip5XY0(uint16_t opcode);
+    void fiveGroup(uint16_t opcode);
+    void saveRange5XY2(uint16_t opcode);
+    void loadRange5XY3(uint16_t opcode);
     void set6XNN(uint16_t opcode);
     void add7XNN(uint16_t opcode);
 
@@ -160,6 +633,13 @@ private:
     void bcdtomemFX33(uint16_t opcode);
     void regtomemFX55(uint16_t opcode);
     void memtoregFX65(uint16_t opcode);
+    void longIF000(uint16_t opcode);
+    void planeFN01(uint16_t opcode);
+    void audioF002(uint16_t opcode);
+    void bigFontFX30(uint16_t opcode);
+    void pitchFX3A(uint16_t opcode);
+    void saveFlagsFX75(uint16_t opcode);
+    void loadFlagsFX85(uint16_t opcode);
 };
 
 #endif // CHIP8_HPP
\ No newline at end of file
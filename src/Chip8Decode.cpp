@@ -0,0 +1,199 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "Chip8Decode.hpp"
+
+static DecodedOp Make(uint8_t op, uint16_t opcode, uint16_t imm)
+{
+    DecodedOp decoded;
+    decoded.op = op;
+    decoded.xy = ((opcode & 0x0F00) >> 8) | (opcode & 0x00F0);
+    decoded.imm = imm;
+    return decoded;
+}
+
+// Follows the same groups and sub-opcode checks as Chip8::DecodeAndExecute
+DecodedOp DecodeOpcode(uint16_t opcode, Chip8::Profile profile)
+{
+    uint16_t nnn = opcode & 0x0FFF;
+    uint8_t nn = opcode & 0x00FF;
+    uint8_t n = opcode & 0x000F;
+    bool schip = profile != Chip8::PROFILE_CHIP8;
+    bool xochip = profile == Chip8::PROFILE_XOCHIP;
+
+    switch ((opcode & 0xF000) >> 12)
+    {
+    case 0x0:
+        // the original decodes on the last nibble only, the extensions need the whole opcode
+        if (schip)
+        {
+            if ((opcode & 0xFFF0) == 0x00C0)
+                return Make(OP_SCROLLDOWN_00CN, opcode, n);
+            if ((opcode & 0xFFF0) == 0x00D0 && xochip)
+                return Make(OP_SCROLLUP_00DN, opcode, n);
+            switch (opcode)
+            {
+            case 0x00E0:
+                return Make(OP_CLS_00E0, opcode, 0);
+            case 0x00EE:
+                return Make(OP_RET_00EE, opcode, 0);
+            case 0x00FB:
+                return Make(OP_SCROLLRIGHT_00FB, opcode, 0);
+            case 0x00FC:
+                return Make(OP_SCROLLLEFT_00FC, opcode, 0);
+            case 0x00FD:
+                return Make(OP_EXIT_00FD, opcode, 0);
+            case 0x00FE:
+                return Make(OP_LORES_00FE, opcode, 0);
+            case 0x00FF:
+                return Make(OP_HIRES_00FF, opcode, 0);
+            }
+            break;
+        }
+        if (n == 0)
+            return Make(OP_CLS_00E0, opcode, 0);
+        if (n == 0xE)
+            return Make(OP_RET_00EE, opcode, 0);
+        break;
+    case 0x1:
+        return Make(OP_JMP_1NNN, opcode, nnn);
+    case 0x2:
+        return Make(OP_CALL_2NNN, opcode, nnn);
+    case 0x3:
+        return Make(OP_SKIP_3XNN, opcode, nn);
+    case 0x4:
+        return Make(OP_SKIP_4XNN, opcode, nn);
+    case 0x5:
+        if (xochip && n == 2)
+            return Make(OP_SAVERANGE_5XY2, opcode, 0);
+        if (xochip && n == 3)
+            return Make(OP_LOADRANGE_5XY3, opcode, 0);
+        return Make(OP_SKIP_5XY0, opcode, 0);
+    case 0x6:
+        return Make(OP_SET_6XNN, opcode, nn);
+    case 0x7:
+        return Make(OP_ADD_7XNN, opcode, nn);
+    case 0x8:
+        switch (n)
+        {
+        case 0x0:
+            return Make(OP_SETXY_8XY0, opcode, 0);
+        case 0x1:
+            return Make(OP_OR_8XY1, opcode, 0);
+        case 0x2:
+            return Make(OP_AND_8XY2, opcode, 0);
+        case 0x3:
+            return Make(OP_XOR_8XY3, opcode, 0);
+        case 0x4:
+            return Make(OP_ADD_8XY4, opcode, 0);
+        case 0x5:
+            return Make(OP_SUB_8XY5, opcode, 0);
+        case 0x6:
+            return Make(OP_SHR_8XY6, opcode, 0);
+        case 0x7:
+            return Make(OP_SUB2_8XY7, opcode, 0);
+        case 0xE:
+            return Make(OP_SHL_8XYE, opcode, 0);
+        }
+        break;
+    case 0x9:
+        return Make(OP_SKIP_9XY0, opcode, 0);
+    case 0xA:
+        return Make(OP_SETI_ANNN, opcode, nnn);
+    case 0xB:
+        return Make(OP_JMPOFF_BNNN, opcode, nnn);
+    case 0xC:
+        return Make(OP_RAND_CXNN, opcode, nn);
+    case 0xD:
+        return Make(OP_DRAW_DXYN, opcode, n);
+    case 0xE:
+        if (nn == 0x9E)
+            return Make(OP_SKIPKEY_EX9E, opcode, 0);
+        if (nn == 0xA1)
+            return Make(OP_SKIPNKEY_EXA1, opcode, 0);
+        break;
+    case 0xF:
+        if (xochip && opcode == 0xF000)
+            return Make(OP_LONGI_F000, opcode, 0);
+        if (xochip && opcode == 0xF002)
+            return Make(OP_AUDIO_F002, opcode, 0);
+        if (xochip && nn == 0x01)
+            return Make(OP_PLANE_FN01, opcode, 0);
+        if (schip && nn == 0x30)
+            return Make(OP_BIGFONT_FX30, opcode, 0);
+        if (schip && nn == 0x75)
+            return Make(OP_SAVEFLAGS_FX75, opcode, 0);
+        if (schip && nn == 0x85)
+            return Make(OP_LOADFLAGS_FX85, opcode, 0);
+        if (xochip && nn == 0x3A)
+            return Make(OP_PITCH_FX3A, opcode, 0);
+        switch (nn)
+        {
+        case 0x07:
+            return Make(OP_GETTIMER_FX07, opcode, 0);
+        case 0x0A:
+            return Make(OP_WAITINPUT_FX0A, opcode, 0);
+        case 0x15:
+            return Make(OP_SETTIMER_FX15, opcode, 0);
+        case 0x18:
+            return Make(OP_SETSOUND_FX18, opcode, 0);
+        case 0x1E:
+            return Make(OP_ADDI_FX1E, opcode, 0);
+        case 0x29:
+            return Make(OP_FONT_FX29, opcode, 0);
+        case 0x33:
+            return Make(OP_BCD_FX33, opcode, 0);
+        case 0x55:
+            return Make(OP_REGTOMEM_FX55, opcode, 0);
+        case 0x65:
+            return Make(OP_MEMTOREG_FX65, opcode, 0);
+        }
+        break;
+    }
+
+    return Make(OP_TRAP, opcode, opcode);
+}
+
+static const DecodedOp *BuildTable(Chip8::Profile profile)
+{
+    DecodedOp *decoded = new DecodedOp[0x10000];
+    for (uint32_t opcode = 0; opcode < 0x10000; opcode++)
+        decoded[opcode] = DecodeOpcode((uint16_t)opcode, profile);
+    return decoded;
+}
+
+const DecodedOp *GetDecodeTable(Chip8::Profile profile)
+{
+    // 256KB each, built on first use. Static local init is thread-safe.
+    if (profile == Chip8::PROFILE_SCHIP)
+    {
+        static const DecodedOp *schip = BuildTable(Chip8::PROFILE_SCHIP);
+        return schip;
+    }
+    if (profile == Chip8::PROFILE_XOCHIP)
+    {
+        static const DecodedOp *xochip = BuildTable(Chip8::PROFILE_XOCHIP);
+        return xochip;
+    }
+    static const DecodedOp *table = BuildTable(Chip8::PROFILE_CHIP8);
+    return table;
+}
+
+const char *GetOpName(uint8_t op)
+{
+    // same order as Chip8Op
+    static const char *names[] = {
+        "00E0", "00EE", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+        "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+        "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1",
+        "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX33", "FX55", "FX65",
+        "00CN", "00FB", "00FC", "00FD", "00FE", "00FF", "FX30", "FX75", "FX85",
+        "00DN", "5XY2", "5XY3", "F000", "FN01", "F002", "FX3A",
+        "TRAP"};
+    static_assert(sizeof(names) / sizeof(names[0]) == OP_COUNT, "name table out of sync with Chip8Op");
+
+    return op < OP_COUNT ? names[op] : "?";
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef CHIP8_DECODE_HPP
+#define CHIP8_DECODE_HPP
+#include <stdint.h>
+#include "Chip8.hpp"
+
+// Handler ids for predecoded opcodes. Named after the Chip8 handler they mirror.
+enum Chip8Op : uint8_t
+{
+    OP_CLS_00E0,
+    OP_RET_00EE,
+    OP_JMP_1NNN,
+    OP_CALL_2NNN,
+    OP_SKIP_3XNN,
+    OP_SKIP_4XNN,
+    OP_SKIP_5XY0,
+    OP_SET_6XNN,
+    OP_ADD_7XNN,
+    OP_SETXY_8XY0,
+    OP_OR_8XY1,
+    OP_AND_8XY2,
+    OP_XOR_8XY3,
+    OP_ADD_8XY4,
+    OP_SUB_8XY5,
+    OP_SHR_8XY6,
+    OP_SUB2_8XY7,
+    OP_SHL_8XYE,
+    OP_SKIP_9XY0,
+    OP_SETI_ANNN,
+    OP_JMPOFF_BNNN,
+    OP_RAND_CXNN,
+    OP_DRAW_DXYN,
+    OP_SKIPKEY_EX9E,
+    OP_SKIPNKEY_EXA1,
+    OP_GETTIMER_FX07,
+    OP_WAITINPUT_FX0A,
+    OP_SETTIMER_FX15,
+    OP_SETSOUND_FX18,
+    OP_ADDI_FX1E,
+    OP_FONT_FX29,
+    OP_BCD_FX33,
+    OP_REGTOMEM_FX55,
+    OP_MEMTOREG_FX65,
+    // SUPER-CHIP
+    OP_SCROLLDOWN_00CN,
+    OP_SCROLLRIGHT_00FB,
+    OP_SCROLLLEFT_00FC,
+    OP_EXIT_00FD,
+    OP_LORES_00FE,
+    OP_HIRES_00FF,
+    OP_BIGFONT_FX30,
+    OP_SAVEFLAGS_FX75,
+    OP_LOADFLAGS_FX85,
+    // XO-CHIP
+    OP_SCROLLUP_00DN,
+    OP_SAVERANGE_5XY2,
+    OP_LOADRANGE_5XY3,
+    OP_LONGI_F000,
+    OP_PLANE_FN01,
+    OP_AUDIO_F002,
+    OP_PITCH_FX3A,
+    // any opcode the core does not implement
+    OP_TRAP,
+
+    OP_COUNT
+};
+
+/*
+An opcode with its operands already extracted.
+x and y are packed into xy (x in the low nibble).
+imm holds NNN, NN or N depending on the opcode, or the raw opcode for OP_TRAP.
+*/
+struct DecodedOp
+{
+    uint8_t op;
+    uint8_t xy;
+    uint16_t imm;
+};
+
+// Decode a single opcode. Opcodes outside the profile's instruction set are OP_TRAP.
+DecodedOp DecodeOpcode(uint16_t pOpcode, Chip8::Profile pProfile = Chip8::PROFILE_CHIP8);
+
+// Table of all 64K opcodes for a profile, decoded once on first use and shared by every instance
+const DecodedOp *GetDecodeTable(Chip8::Profile pProfile = Chip8::PROFILE_CHIP8);
+
+// Opcode pattern of a Chip8Op, such as "8XY4", for reports
+const char *GetOpName(uint8_t pOp);
+
+#endif // CHIP8_DECODE_HPP
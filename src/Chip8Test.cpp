@@ -1,8 +1,23 @@
 #include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <functional>
+#include <vector>
 #include "minUnit.hpp"
 #include "Chip8Test.hpp"
 #include "Chip8.hpp"
+#include "Chip8Decode.hpp"
+#include "Chip8Vector.hpp"
+#include "AudioOutput.hpp"
+#include "FrameConvert.hpp"
+#include "FrameSink.hpp"
+#include "InputRecording.hpp"
+#include "Profiler.hpp"
+#include "Lockstep.hpp"
+#include "Fuzzer.hpp"
+#include "RomLibrary.hpp"
+#include "RomArchive.hpp"
 
 int tests_run = 0;
 
@@ -24,6 +39,29 @@ char *Chip8Test::RunTests()
     mu_run_test(SetKeyState);
     mu_run_test(JMP);
     mu_run_test(Call);
+    mu_run_test(VirtualTimers);
+    mu_run_test(RunCycles);
+    mu_run_test(Decode);
+    mu_run_test(SelfModifyingCode);
+    mu_run_test(Jit);
+    mu_run_test(DrawSprite);
+    mu_run_test(ExpandRows);
+    mu_run_test(SaveState);
+    mu_run_test(Snapshots);
+    mu_run_test(VectorLanes);
+    mu_run_test(Random);
+    mu_run_test(InputReplay);
+    mu_run_test(Profile);
+    mu_run_test(Lockstep);
+    mu_run_test(Faults);
+    mu_run_test(Fuzz);
+    mu_run_test(RomLibraryIndex);
+    mu_run_test(RomArchiveRoundTrip);
+    mu_run_test(SuperChipProfile);
+    mu_run_test(XoChipProfile);
+    mu_run_test(Quirks);
+    mu_run_test(FrameStreamRoundTrip);
+    mu_run_test(Audio);
 
     return 0;
 }
@@ -51,7 +89,7 @@ char *Chip8Test::LoadROM()
 
     gChip8->LoadRom(ROM, (uint32_t)sizeof(ROM));
 
-    for (int i = 0; i < sizeof(ROM); i++)
+    for (size_t i = 0; i < sizeof(ROM); i++)
     {
         mu_assert("LoadRom - Memory does not match ROM after loading.", ROM[i] == gChip8->memory[0x200 + i]);
     }
@@ -116,6 +154,1031 @@ char *Chip8Test::Call()
     return 0;
 }
 
+char *Chip8Test::VirtualTimers()
+{
+    // jump to self forever
+    uint8_t ROM[] = {0x12, 0x00};
+
+    gChip8->SetInstructionsPerTick(4);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+    gChip8->delay = 3;
+    gChip8->sound = 1;
+
+    for (int i = 0; i < 3; i++)
+        gChip8->Cycle();
+    mu_assert("VirtualTimers - Timer ticked early", gChip8->delay == 3);
+
+    gChip8->Cycle();
+    mu_assert("VirtualTimers - Delay did not tick", gChip8->delay == 2);
+    mu_assert("VirtualTimers - Sound did not tick", gChip8->sound == 0);
+    mu_assert("VirtualTimers - Wrong cycle count", gChip8->GetCycleCount() == 4);
+
+    gChip8->TickTimers();
+    gChip8->TickTimers();
+    gChip8->TickTimers();
+    mu_assert("VirtualTimers - Delay went below zero", gChip8->delay == 0 && gChip8->sound == 0);
+
+    gChip8->SetInstructionsPerTick(0);
+
+    return 0;
+}
+
+char *Chip8Test::RunCycles()
+{
+    // V0 = 0, I = font, draw, then jump to self
+    uint8_t ROM[] = {0x60, 0x00, 0xA0, 0x50, 0xD0, 0x05, 0x12, 0x06};
+
+    gChip8->SetInstructionsPerTick(10);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+
+    uint32_t executed = gChip8->RunCycles(100);
+    mu_assert("RunCycles - Did not stop on draw", executed == 3);
+    mu_assert("RunCycles - Draw event not raised", gChip8->GetEvents() == Chip8::EVENT_DRAW);
+    mu_assert("RunCycles - Wrong PC after draw", gChip8->PC == 0x206);
+
+    executed = gChip8->RunUntilFrame();
+    mu_assert("RunUntilFrame - Did not stop on the tick", executed == 7);
+    mu_assert("RunUntilFrame - Frame event not raised", gChip8->GetEvents() == Chip8::EVENT_FRAME);
+
+    executed = gChip8->RunCycles(25, Chip8::EVENT_NONE);
+    mu_assert("RunCycles - Stopped early", executed == 25);
+    mu_assert("RunCycles - Wrong cycle count", gChip8->GetCycleCount() == 35);
+
+    gChip8->SetInstructionsPerTick(0);
+
+    return 0;
+}
+
+char *Chip8Test::Decode()
+{
+    DecodedOp op = GetDecodeTable()[0x8AB4];
+    mu_assert("Decode - 8XY4 has wrong handler", op.op == OP_ADD_8XY4);
+    mu_assert("Decode - 8XY4 has wrong registers", (op.xy & 0xF) == 0xA && (op.xy >> 4) == 0xB);
+
+    op = GetDecodeTable()[0xD125];
+    mu_assert("Decode - DXYN has wrong N", op.op == OP_DRAW_DXYN && op.imm == 5);
+
+    op = GetDecodeTable()[0xF0FF];
+    mu_assert("Decode - Unknown opcode is not a trap", op.op == OP_TRAP && op.imm == 0xF0FF);
+
+    // unknown opcode then jump to self
+    uint8_t ROM[] = {0x80, 0x08, 0x12, 0x02};
+    gChip8->LoadRom(ROM, sizeof(ROM));
+
+    uint32_t executed = gChip8->RunCycles(10, Chip8::EVENT_TRAP);
+    mu_assert("Decode - Did not stop on trap", executed == 1);
+    mu_assert("Decode - Trap not recorded", gChip8->GetTrapCount() == 1 && gChip8->GetLastTrapOpcode() == 0x8008);
+
+    return 0;
+}
+
+char *Chip8Test::SelfModifyingCode()
+{
+    // I = 0x207, V0 = 5, store V0 over the operand of the next instruction (V1 += 1 becomes V1 += 5)
+    uint8_t ROM[] = {0xA2, 0x07, 0x60, 0x05, 0xF0, 0x55, 0x71, 0x01, 0x12, 0x08};
+
+    Chip8::Engine engines[] = {Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_PREDECODED, Chip8::ENGINE_BLOCK};
+    for (Chip8::Engine engine : engines)
+    {
+        gChip8->SetEngine(engine);
+        gChip8->LoadRom(ROM, sizeof(ROM));
+
+        gChip8->RunCycles(5, Chip8::EVENT_NONE);
+        mu_assert("SelfModifyingCode - Modified instruction not executed", gChip8->V[1] == 5);
+
+        // restore the original code and run it again
+        gChip8->PC = 0x200;
+        gChip8->memory[0x207] = 0x01;
+        gChip8->RunCycles(4, Chip8::EVENT_NONE);
+        mu_assert("SelfModifyingCode - Stale code executed", gChip8->V[1] == 10);
+    }
+
+    gChip8->SetEngine(Chip8::ENGINE_PREDECODED);
+
+    return 0;
+}
+
+char *Chip8Test::Jit()
+{
+    // ALU ops including VF as an operand, skips, I arithmetic, then loop
+    uint8_t ROM[] = {0x60, 0xFF, 0x61, 0x01, 0x80, 0x14, 0x6A, 0x0F, 0x6B, 0x83,
+                     0x8A, 0xB5, 0x8A, 0xB7, 0x8A, 0xE6, 0x8A, 0x0E, 0x8F, 0xF4,
+                     0x8F, 0x15, 0x8B, 0xF7, 0x7A, 0x10, 0xA1, 0x23, 0xFA, 0x1E,
+                     0x3A, 0x00, 0x6C, 0x01, 0x4A, 0x00, 0x6D, 0x02, 0x5A, 0xB0,
+                     0x9A, 0xB0, 0x8C, 0xA1, 0x8D, 0xA2, 0x8E, 0xA3, 0xFB, 0x29,
+                     0x71, 0x01, 0x12, 0x04};
+
+    Chip8 reference;
+    reference.SetEngine(Chip8::ENGINE_INTERPRETER);
+    reference.SetInstructionsPerTick(10);
+    reference.LoadRom(ROM, sizeof(ROM));
+
+    gChip8->SetEngine(Chip8::ENGINE_JIT);
+    gChip8->SetInstructionsPerTick(10);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+
+    for (int i = 0; i < 50; i++)
+    {
+        reference.RunCycles(37, Chip8::EVENT_NONE);
+        gChip8->RunCycles(37, Chip8::EVENT_NONE);
+
+        mu_assert("Jit - Registers differ from interpreter", memcmp(reference.V, gChip8->V, 16) == 0);
+        mu_assert("Jit - I differs from interpreter", reference.I == gChip8->I);
+        mu_assert("Jit - PC differs from interpreter", reference.PC == gChip8->PC);
+        mu_assert("Jit - Timers differ from interpreter", reference.delay == gChip8->delay);
+        // runs are entered with less budget or time to the tick left than their length
+        mu_assert("Jit - Ran past the budget", reference.GetCycleCount() == gChip8->GetCycleCount());
+    }
+
+    gChip8->SetEngine(Chip8::ENGINE_PREDECODED);
+    gChip8->SetInstructionsPerTick(0);
+
+    return 0;
+}
+
+char *Chip8Test::DrawSprite()
+{
+    // draw font 0 at (62, 30) so it wraps both edges, then draw it again to erase it
+    uint8_t ROM[] = {0x60, 0x3E, 0x61, 0x1E, 0x62, 0x00, 0xF2, 0x29, 0xD0, 0x15, 0xD0, 0x15};
+    gChip8->LoadRom(ROM, sizeof(ROM));
+
+    gChip8->RunCycles(5, Chip8::EVENT_NONE);
+    const uint64_t *rows = gChip8->GetPackedScreen();
+    mu_assert("DrawSprite - Wrong top row", rows[30] == 0xC000000000000003ull);
+    mu_assert("DrawSprite - Sprite did not wrap right", rows[31] == 0x4000000000000002ull);
+    mu_assert("DrawSprite - Sprite did not wrap down", rows[0] == 0x4000000000000002ull && rows[2] == 0xC000000000000003ull);
+    mu_assert("DrawSprite - Wrapped pixel not set", gChip8->GetScreen()[1 + 30 * 64] == 1);
+    mu_assert("DrawSprite - Collision without overlap", gChip8->V[0xF] == 0);
+
+    gChip8->RunCycles(1, Chip8::EVENT_NONE);
+    mu_assert("DrawSprite - Collision not flagged", gChip8->V[0xF] == 1);
+    for (int y = 0; y < 32; y++)
+        mu_assert("DrawSprite - Second draw did not erase", rows[y] == 0);
+
+    gChip8->MarkScreenClean();
+    gChip8->PC = 0x200;
+    gChip8->RunCycles(1, Chip8::EVENT_NONE);
+    mu_assert("DrawSprite - Non-drawing instruction set the dirty flag", !gChip8->IsScreenDirty());
+
+    return 0;
+}
+
+char *Chip8Test::ExpandRows()
+{
+    uint64_t rows[32];
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for (int y = 0; y < 32; y++)
+    {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        rows[y] = seed;
+    }
+    rows[0] = 0x8000000000000001ull;
+
+    uint32_t expected[64 * 32];
+    uint32_t pixels[64 * 32];
+    ExpandRowsScalar(rows, 32, 0xFFFFFFFF, 0xFF000000, expected);
+    ::ExpandRows(rows, 32, 0xFFFFFFFF, 0xFF000000, pixels);
+
+    mu_assert("ExpandRows - Leftmost pixel not set", expected[0] == 0xFFFFFFFF && expected[63] == 0xFFFFFFFF && expected[1] == 0xFF000000);
+    mu_assert("ExpandRows - Kernel differs from scalar version", memcmp(expected, pixels, sizeof(pixels)) == 0);
+
+    return 0;
+}
+
+char *Chip8Test::SaveState()
+{
+    // BCD of a counter into memory, draw its font glyph, loop
+    uint8_t ROM[] = {0xA3, 0x00, 0x60, 0x07, 0xF0, 0x33, 0x70, 0x01, 0xF0, 0x29, 0xD0, 0x15, 0x12, 0x04};
+    gChip8->SetInstructionsPerTick(7);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+    gChip8->RunCycles(20, Chip8::EVENT_NONE);
+    gChip8->SetKeyState(3, 1);
+
+    std::vector<uint8_t> state;
+    gChip8->SaveState(state);
+    mu_assert("SaveState - State is not compact", state.size() < 400);
+
+    gChip8->RunCycles(50, Chip8::EVENT_NONE);
+    uint8_t expectedMemory[4096];
+    uint64_t expectedDisplay[32];
+    uint8_t expectedV[16];
+    memcpy(expectedMemory, gChip8->memory, sizeof(expectedMemory));
+    memcpy(expectedDisplay, gChip8->display, sizeof(expectedDisplay));
+    memcpy(expectedV, gChip8->V, sizeof(expectedV));
+    uint16_t expectedI = gChip8->I;
+    uint16_t expectedPC = gChip8->PC;
+    uint64_t expectedCycles = gChip8->cycleCount;
+    uint8_t expectedDelay = gChip8->delay;
+
+    mu_assert("SaveState - State did not load", gChip8->LoadState(state.data(), state.size()));
+    mu_assert("SaveState - Key state not restored", gChip8->keys[3] == 1);
+    gChip8->RunCycles(50, Chip8::EVENT_NONE);
+
+    mu_assert("SaveState - Memory differs after restore", memcmp(expectedMemory, gChip8->memory, 4096) == 0);
+    mu_assert("SaveState - Display differs after restore", memcmp(expectedDisplay, gChip8->display, sizeof(expectedDisplay)) == 0);
+    mu_assert("SaveState - Registers differ after restore", memcmp(expectedV, gChip8->V, 16) == 0 && expectedI == gChip8->I && expectedPC == gChip8->PC);
+    mu_assert("SaveState - Timing differs after restore", expectedCycles == gChip8->cycleCount && expectedDelay == gChip8->delay);
+
+    // damaged and foreign states are rejected
+    mu_assert("SaveState - Truncated state loaded", !gChip8->LoadState(state.data(), state.size() - 1));
+    std::vector<uint8_t> badVersion = state;
+    badVersion[4] = 99;
+    mu_assert("SaveState - Unknown version loaded", !gChip8->LoadState(badVersion.data(), badVersion.size()));
+    gChip8->SetQuirks(Chip8::QUIRK_SHIFT_VY);
+    mu_assert("SaveState - State loaded under other quirks", !gChip8->LoadState(state.data(), state.size()));
+    gChip8->SetQuirks(Chip8::QUIRK_NONE);
+    ROM[1] = 0x01;
+    gChip8->LoadRom(ROM, sizeof(ROM));
+    mu_assert("SaveState - State from another ROM loaded", !gChip8->LoadState(state.data(), state.size()));
+
+    gChip8->SetInstructionsPerTick(0);
+    gChip8->SetKeyState(3, 0);
+
+    return 0;
+}
+
+char *Chip8Test::Snapshots()
+{
+    // count in V0 and store it at 0x300 with FX55, loop
+    uint8_t ROM[] = {0xA3, 0x00, 0x70, 0x01, 0xF0, 0x55, 0x12, 0x02};
+    gChip8->SetEngine(Chip8::ENGINE_BLOCK);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+
+    Snapshot empty;
+    mu_assert("Snapshots - Empty snapshot restored", !gChip8->Restore(empty) && gChip8->PC == 0x200);
+
+    Snapshot root;
+    gChip8->Capture(root);
+    gChip8->RunCycles(30, Chip8::EVENT_NONE);
+    Snapshot child;
+    gChip8->Capture(child);
+
+    mu_assert("Snapshots - Written page not copied", child.pages[3] != root.pages[3] && child.pages[3][0] == 10);
+    mu_assert("Snapshots - Untouched page not shared", child.pages[2] == root.pages[2] && child.display == root.display);
+    mu_assert("Snapshots - Parent page changed", root.pages[3][0] == 0);
+
+    // a sibling forked from the root diverges without affecting the child
+    mu_assert("Snapshots - Root not restored", gChip8->Restore(root));
+    mu_assert("Snapshots - Memory not restored", gChip8->memory[0x300] == 0 && gChip8->V[0] == 0 && gChip8->PC == 0x200);
+    gChip8->RunCycles(6, Chip8::EVENT_NONE);
+    mu_assert("Snapshots - Sibling ran wrong", gChip8->memory[0x300] == 2);
+
+    gChip8->Restore(child);
+    mu_assert("Snapshots - Child not restored", gChip8->memory[0x300] == 10 && gChip8->V[0] == 10);
+    gChip8->RunCycles(3, Chip8::EVENT_NONE);
+    mu_assert("Snapshots - Restored state did not continue", gChip8->memory[0x300] == 11);
+
+    // another ROM's machine can't take it
+    Chip8 other;
+    uint8_t otherROM[] = {0x12, 0x00};
+    other.LoadRom(otherROM, sizeof(otherROM));
+    mu_assert("Snapshots - Other ROM's snapshot restored", !other.Restore(child) && other.PC == 0x200);
+
+    gChip8->SetEngine(Chip8::ENGINE_PREDECODED);
+
+    return 0;
+}
+
+char *Chip8Test::VectorLanes()
+{
+    // count V1 through the keys, V2 counts released keys, BCD of the running sum V3 to 0x300
+    uint8_t ROM[] = {0x6D, 0x0F, 0x71, 0x01, 0x81, 0xD2, 0xE1, 0x9E, 0x72, 0x01, 0x83, 0x24,
+                     0xA3, 0x00, 0xF3, 0x33, 0x12, 0x02};
+    Chip8Vector lanes(40, 7);
+    mu_assert("VectorLanes - Lane count not rounded up", lanes.GetLaneCount() == 64);
+    lanes.LoadRom(ROM, sizeof(ROM));
+    for (uint32_t lane = 0; lane < lanes.GetLaneCount(); lane++)
+        lanes.SetKeyState(lane, lane % 16, 1);
+    lanes.Run(500);
+
+    // every lane matches a Chip8 run with the same key held
+    for (uint32_t lane = 0; lane < lanes.GetLaneCount(); lane += 13)
+    {
+        gChip8->SetInstructionsPerTick(7);
+        gChip8->LoadRom(ROM, sizeof(ROM));
+        gChip8->SetKeyState(lane % 16, 1);
+        gChip8->RunCycles(500, Chip8::EVENT_NONE);
+        gChip8->SetKeyState(lane % 16, 0);
+
+        bool same = gChip8->PC == lanes.GetPC(lane) && gChip8->I == lanes.GetI(lane) && gChip8->delay == lanes.GetDelay(lane);
+        for (int r = 0; r < 16; r++)
+            same = same && gChip8->V[r] == lanes.GetRegister(lane, r);
+        mu_assert("VectorLanes - Registers differ from Chip8", same);
+        mu_assert("VectorLanes - Memory differs from Chip8", memcmp(gChip8->memory, lanes.GetMemory(lane), 4096) == 0);
+    }
+    mu_assert("VectorLanes - Lanes did not diverge", lanes.GetRegister(0, 2) != lanes.GetRegister(1, 2));
+
+    gChip8->SetInstructionsPerTick(0);
+
+    return 0;
+}
+
+char *Chip8Test::Random()
+{
+    // two random bytes per loop, the second one masked
+    uint8_t ROM[] = {0xC0, 0xFF, 0xC1, 0x0F, 0x12, 0x00};
+    uint8_t first[16];
+    uint8_t again[16];
+
+    gChip8->SetSeed(42);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+    for (int i = 0; i < 16; i++)
+    {
+        gChip8->RunCycles(3, Chip8::EVENT_NONE);
+        first[i] = gChip8->V[0];
+        mu_assert("Random - Mask not applied", gChip8->V[1] < 0x10);
+    }
+
+    // the seed survives a reload and replays the same numbers
+    gChip8->LoadRom(ROM, sizeof(ROM));
+    for (int i = 0; i < 16; i++)
+    {
+        gChip8->RunCycles(3, Chip8::EVENT_NONE);
+        again[i] = gChip8->V[0];
+    }
+    mu_assert("Random - Same seed gave different numbers", memcmp(first, again, sizeof(first)) == 0);
+
+    // the generator is part of the save state
+    std::vector<uint8_t> state;
+    gChip8->SaveState(state);
+    gChip8->RunCycles(3, Chip8::EVENT_NONE);
+    uint8_t expected = gChip8->V[0];
+    gChip8->RunCycles(30, Chip8::EVENT_NONE);
+    gChip8->LoadState(state.data(), state.size());
+    gChip8->RunCycles(3, Chip8::EVENT_NONE);
+    mu_assert("Random - Generator not restored from save state", gChip8->V[0] == expected);
+
+    gChip8->SetSeed(43);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+    for (int i = 0; i < 16; i++)
+    {
+        gChip8->RunCycles(3, Chip8::EVENT_NONE);
+        again[i] = gChip8->V[0];
+    }
+    mu_assert("Random - Different seeds gave the same numbers", memcmp(first, again, sizeof(first)) != 0);
+
+    gChip8->SetSeed(0);
+
+    return 0;
+}
+
+char *Chip8Test::InputReplay()
+{
+    // V2 counts loops with key 5 up, V3 all loops, CXNN mixes in the seed
+    uint8_t ROM[] = {0x61, 0x05, 0xE1, 0x9E, 0x72, 0x01, 0x73, 0x01, 0xC4, 0xFF, 0x84, 0x24, 0x12, 0x02};
+    gChip8->SetInstructionsPerTick(7);
+    gChip8->SetSeed(7);
+    gChip8->SetQuirks(Chip8::QUIRK_CLIP);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+
+    InputRecording recording;
+    recording.Begin(*gChip8);
+    gChip8->RunCycles(100, Chip8::EVENT_NONE);
+    recording.SetKeyState(*gChip8, 5, 1);
+    recording.SetKeyState(*gChip8, 5, 1);
+    gChip8->RunCycles(300, Chip8::EVENT_NONE);
+    recording.SetKeyState(*gChip8, 5, 0);
+    recording.SetKeyState(*gChip8, 9, 1);
+    gChip8->RunCycles(1000, Chip8::EVENT_NONE);
+    recording.End(*gChip8);
+    mu_assert("InputReplay - Repeated key state logged", recording.GetEvents().size() == 3);
+
+    std::vector<uint8_t> expected;
+    gChip8->SaveState(expected);
+
+    std::vector<uint8_t> data;
+    recording.Encode(data);
+    mu_assert("InputReplay - Recording is not compact", data.size() < 40);
+    InputRecording loaded;
+    mu_assert("InputReplay - Truncated recording decoded", !loaded.Decode(data.data(), data.size() - 1));
+    mu_assert("InputReplay - Recording did not decode", loaded.Decode(data.data(), data.size()));
+
+    // replay on a fresh machine with other settings, which the recording overrides
+    gChip8->SetInstructionsPerTick(0);
+    gChip8->SetSeed(0);
+    gChip8->SetQuirks(Chip8::QUIRK_NONE);
+    gChip8->LoadRom(ROM, sizeof(ROM));
+    mu_assert("InputReplay - Replay refused", loaded.Replay(*gChip8));
+    mu_assert("InputReplay - Recorded quirks not applied", gChip8->GetQuirks() == Chip8::QUIRK_CLIP);
+    std::vector<uint8_t> replayed;
+    gChip8->SaveState(replayed);
+    mu_assert("InputReplay - Replay ended in a different state", replayed == expected);
+    mu_assert("InputReplay - Keys were not applied", gChip8->V[2] != gChip8->V[3] && gChip8->keys[9] == 1);
+
+    ROM[1] = 0x06;
+    gChip8->LoadRom(ROM, sizeof(ROM));
+    mu_assert("InputReplay - Replayed on another ROM", !loaded.Replay(*gChip8));
+
+    gChip8->SetInstructionsPerTick(0);
+    gChip8->SetSeed(0);
+    gChip8->SetQuirks(Chip8::QUIRK_NONE);
+    gChip8->SetKeyState(9, 0);
+
+    return 0;
+}
+
+char *Chip8Test::Profile()
+{
+#ifdef CHIP8_PROFILER
+    // 200 and 202 call 206, which draws and calls 20C, then 204 loops
+    uint8_t ROM[] = {0x22, 0x06, 0x22, 0x06, 0x12, 0x04, 0xD0, 0x01, 0x22, 0x0C, 0x00, 0xEE, 0x00, 0xEE};
+    gChip8->ResetState();
+    gChip8->LoadRom(ROM, sizeof(ROM));
+
+    Profiler profiler;
+    gChip8->SetProfiler(&profiler);
+    gChip8->RunCycles(12, Chip8::EVENT_NONE);
+    gChip8->SetProfiler(nullptr);
+    gChip8->RunCycles(10, Chip8::EVENT_NONE);
+
+    mu_assert("Profile - Wrong instruction count", profiler.GetInstructions() == 12);
+    mu_assert("Profile - Wrong opcode counts", profiler.GetOpCount(OP_CALL_2NNN) == 4 && profiler.GetOpCount(OP_RET_00EE) == 4 &&
+                                                   profiler.GetOpCount(OP_DRAW_DXYN) == 2 && profiler.GetOpCount(OP_JMP_1NNN) == 2);
+    mu_assert("Profile - Wrong PC counts", profiler.GetPCCount(0x206) == 2 && profiler.GetPCCount(0x20C) == 2 && profiler.GetPCCount(0x204) == 2);
+
+    // rom -> sub_206 -> sub_20C, each call path counted once however often it runs
+    const std::vector<ProfileNode> &tree = profiler.GetCallTree();
+    mu_assert("Profile - Wrong call tree size", tree.size() == 3);
+    mu_assert("Profile - Wrong call tree", tree[1].address == 0x206 && tree[1].parent == 0 && tree[2].address == 0x20C && tree[2].parent == 1);
+    mu_assert("Profile - Wrong counts at the top level", tree[0].opCounts[OP_CALL_2NNN] == 2 && tree[0].opCounts[OP_JMP_1NNN] == 2);
+    mu_assert("Profile - Wrong counts in a subroutine", tree[1].opCounts[OP_DRAW_DXYN] == 2 && tree[1].opCounts[OP_RET_00EE] == 2 &&
+                                                            tree[2].opCounts[OP_RET_00EE] == 2);
+
+    // XO-CHIP code runs on past 0xFFF, which must not be counted at 0x000
+    std::vector<uint8_t> longRom(0x1000 - 0x200 + 2);
+    for (size_t i = 0; i < longRom.size(); i += 2)
+        longRom[i] = 0x60;
+    Chip8 xo;
+    xo.SetProfile(Chip8::PROFILE_XOCHIP);
+    xo.LoadRom(longRom.data(), (uint32_t)longRom.size());
+    Profiler xoProfiler;
+    xo.SetProfiler(&xoProfiler);
+    xo.RunCycles((0x1000 - 0x200) / 2 + 1, Chip8::EVENT_NONE);
+    mu_assert("Profile - Wrong PC count past 0xFFF", xoProfiler.GetPCCount(0x1000) == 1 && xoProfiler.GetPCCount(0x000) == 0);
+#endif
+
+    return 0;
+}
+
+char *Chip8Test::Lockstep()
+{
+    // sets the delay timer, then loops on CXNN
+    uint8_t ROM[] = {0x60, 0xFF, 0xF0, 0x15, 0xC1, 0xFF, 0x12, 0x04};
+    std::vector<InputEvent> events = {{50, 3, 1}, {51, 3, 0}, {300, 7, 1}};
+
+    LockstepRunner runner(Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_JIT);
+    runner.SetInterval(64);
+    runner.SetSeed(1);
+    mu_assert("Lockstep - Engines disagree", runner.Run(ROM, sizeof(ROM), events, 500));
+    mu_assert("Lockstep - Did not run to the end", runner.GetReference().GetCycleCount() == 500 &&
+                                                       runner.GetCandidate().keys[7] == 1);
+
+    // with one more instruction per tick, the 12th instruction is the first one after which the timers differ
+    runner.GetCandidate().SetInstructionsPerTick(13);
+    mu_assert("Lockstep - Divergence not found", !runner.Run(ROM, sizeof(ROM), events, 500));
+    const LockstepDivergence &divergence = runner.GetDivergence();
+    mu_assert("Lockstep - Wrong divergence point", divergence.cycle == 11 && divergence.PC == 0x206 && divergence.opcode == 0x1204);
+    mu_assert("Lockstep - Wrong divergent field", strcmp(divergence.field, "timers") == 0 &&
+                                                      divergence.reference.delay == 0xFE && divergence.candidate.delay == 0xFF);
+
+    // a recording brings its quirks to both machines
+    Chip8 recorded;
+    recorded.SetQuirks(Chip8::QUIRK_SHIFT_VY);
+    recorded.LoadRom(ROM, sizeof(ROM));
+    InputRecording recording;
+    recording.Begin(recorded);
+    recorded.RunCycles(100, Chip8::EVENT_NONE);
+    recording.End(recorded);
+    runner.GetCandidate().SetInstructionsPerTick(12);
+    mu_assert("Lockstep - Recording did not agree", runner.Run(ROM, sizeof(ROM), recording));
+    mu_assert("Lockstep - Recorded quirks not applied", runner.GetReference().GetQuirks() == Chip8::QUIRK_SHIFT_VY &&
+                                                            runner.GetCandidate().GetQuirks() == Chip8::QUIRK_SHIFT_VY);
+
+    return 0;
+}
+
+char *Chip8Test::Faults()
+{
+    // recurses until the stack is full, returns once too often, stores V0-V2 from 0xFFE,
+    // skips on key V1 = 0x13, then jumps with BNNN past the end of memory
+    uint8_t ROM[] = {0x22, 0x00, 0x00, 0xEE, 0x62, 0xAB, 0xAF, 0xFE, 0xF2, 0x55,
+                     0x61, 0x13, 0xE1, 0x9E, 0x12, 0x0E, 0x60, 0xFF, 0xBF, 0x10};
+    std::vector<uint8_t> coverage(Chip8::COVERAGE_MAP_SIZE);
+    std::vector<uint8_t> predecodedCoverage(Chip8::COVERAGE_MAP_SIZE);
+
+    const Chip8::Engine engines[] = {Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_PREDECODED, Chip8::ENGINE_BLOCK,
+                                     Chip8::ENGINE_JIT, Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_PREDECODED};
+    for (int i = 0; i < 6; i++)
+    {
+        Chip8 chip8;
+        chip8.SetEngine(engines[i]);
+        chip8.SetInstructionsPerTick(12);
+        // the last passes run with edge coverage
+        if (i >= 4)
+            chip8.SetCoverage(i == 4 ? coverage.data() : predecodedCoverage.data());
+        chip8.LoadRom(ROM, sizeof(ROM));
+        chip8.SetKeyState(3, 1);
+
+        mu_assert("Faults - Stack overflow not raised", chip8.RunCycles(1000, Chip8::EVENT_FAULT) == 17 &&
+                                                            chip8.GetLastFault() == Chip8::FAULT_STACK_OVERFLOW &&
+                                                            chip8.GetLastFaultPC() == 0x200);
+        mu_assert("Faults - Overflowing call not skipped", chip8.sp == 16 && chip8.PC == 0x202);
+
+        mu_assert("Faults - Stack underflow not raised", chip8.RunCycles(1000, Chip8::EVENT_FAULT) == 17 &&
+                                                             chip8.GetLastFault() == Chip8::FAULT_STACK_UNDERFLOW &&
+                                                             chip8.GetLastFaultPC() == 0x202);
+        mu_assert("Faults - Underflowing return not skipped", chip8.sp == 0 && chip8.PC == 0x204);
+
+        mu_assert("Faults - Memory fault not raised", chip8.RunCycles(1000, Chip8::EVENT_FAULT) == 3 &&
+                                                          chip8.GetLastFault() == Chip8::FAULT_MEMORY &&
+                                                          chip8.GetLastFaultPC() == 0x208);
+        mu_assert("Faults - Store did not wrap", chip8.memory[0] == 0xAB && chip8.I == 0xFFE);
+
+        mu_assert("Faults - PC fault not raised", chip8.RunCycles(1000, Chip8::EVENT_FAULT) == 5 &&
+                                                      chip8.GetLastFault() == Chip8::FAULT_PC &&
+                                                      chip8.GetLastFaultPC() == 0x100F);
+        mu_assert("Faults - PC did not wrap", chip8.PC == 0x011 && chip8.GetFaultCount() == 4);
+    }
+
+    uint32_t edges = 0;
+    for (uint8_t count : coverage)
+        edges += count != 0;
+    mu_assert("Faults - No edges covered", edges >= 10);
+    mu_assert("Faults - Engines cover different edges", coverage == predecodedCoverage);
+
+    return 0;
+}
+
+char *Chip8Test::Fuzz()
+{
+    // returns without a call after two loads, then loops
+    uint8_t ROM[] = {0x60, 0x05, 0x61, 0x07, 0x00, 0xEE, 0x12, 0x06, 0xA2, 0x00};
+
+    Fuzzer fuzzer(1);
+    FuzzInput input;
+    input.rom.assign(ROM, ROM + sizeof(ROM));
+    input.keys.push_back({10, 4, 1});
+    fuzzer.Execute(input);
+    mu_assert("Fuzz - Fault not reported", fuzzer.GetRunFaults().size() == 1 &&
+                                               fuzzer.GetRunFaults()[0].fault == Chip8::FAULT_STACK_UNDERFLOW &&
+                                               fuzzer.GetRunFaults()[0].PC == 0x204 &&
+                                               fuzzer.GetRunFaults()[0].cycle == 3);
+
+    // only the return matters, everything before it becomes CLS
+    fuzzer.Minimize(input, [&fuzzer](const FuzzInput &candidate) {
+        fuzzer.Execute(candidate);
+        return !fuzzer.GetRunFaults().empty() && fuzzer.GetRunFaults()[0].PC == 0x204;
+    });
+    const uint8_t minimized[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0xEE};
+    mu_assert("Fuzz - Input not minimized", input.keys.empty() && input.rom.size() == sizeof(minimized) &&
+                                                memcmp(input.rom.data(), minimized, sizeof(minimized)) == 0);
+
+    fuzzer.AddSeed(ROM, sizeof(ROM));
+    fuzzer.Run(200);
+    mu_assert("Fuzz - Did not run", fuzzer.GetRuns() == 200 && fuzzer.GetEdgeCount() > 0);
+    mu_assert("Fuzz - Seed fault not found", !fuzzer.GetFindings().empty());
+
+    return 0;
+}
+
+char *Chip8Test::RomLibraryIndex()
+{
+    // counts V0 up in memory at 0x300, then loops
+    uint8_t ROM[] = {0x70, 0x01, 0xA3, 0x00, 0xF0, 0x55, 0x12, 0x00};
+    std::string path = (std::filesystem::temp_directory_path() / "chip8-library-test.ch8").string();
+    std::ofstream outFile(path, std::ofstream::binary);
+    outFile.write((const char *)ROM, sizeof(ROM));
+    outFile.close();
+
+    RomLibrary library;
+    const RomEntry *entry = library.AddRomFile(path.c_str());
+    std::filesystem::remove(path);
+    mu_assert("RomLibrary - File not added", entry && entry->size == sizeof(ROM) && memcmp(entry->data, ROM, sizeof(ROM)) == 0);
+    mu_assert("RomLibrary - Same path added twice", library.AddRomFile(path.c_str()) == entry && library.GetRomCount() == 1);
+    mu_assert("RomLibrary - Not found by name", library.FindByName(path) == entry &&
+                                                    library.FindByName("chip8-library-test.ch8") == entry &&
+                                                    library.FindByName("other.ch8") == nullptr);
+
+    Chip8 reference;
+    reference.LoadRom(ROM, sizeof(ROM));
+    mu_assert("RomLibrary - Image differs from LoadRom", memcmp(entry->image.data(), reference.GetMemory(), 4096) == 0 &&
+                                                             entry->hash == reference.GetRomHash());
+    mu_assert("RomLibrary - Not found by hash", library.FindByHash(reference.GetRomHash()) == entry &&
+                                                    library.FindByHash(0) == nullptr);
+
+    uint8_t large[0xE00] = {};
+    mu_assert("RomLibrary - Too large ROM added", library.AddRom("large", large, sizeof(large)) == nullptr &&
+                                                      library.GetRomCount() == 1);
+
+    // two machines on one image, each resets with a copy of it
+    Chip8 first;
+    Chip8 second;
+    first.LoadImage(entry->image.data(), entry->hash);
+    second.LoadImage(entry->image.data());
+    first.RunCycles(40, Chip8::EVENT_NONE);
+    mu_assert("RomLibrary - Image written through", first.memory[0x300] == 10 && entry->image[0x300] == 0 &&
+                                                        second.memory[0x300] == 0);
+
+    std::vector<uint8_t> state;
+    first.SaveState(state);
+    mu_assert("RomLibrary - State not accepted by another machine", second.LoadState(state.data(), state.size()) &&
+                                                                        second.memory[0x300] == 10 && second.V[0] == 10);
+
+    first.Reset();
+    mu_assert("RomLibrary - Reset did not restore the image", first.GetCycleCount() == 0 && first.PC == 0x200 &&
+                                                                  first.V[0] == 0 && memcmp(first.memory, entry->image.data(), 4096) == 0);
+
+    // an XO-CHIP library takes ROMs too large for the original machine's 4K, this one all 6060
+    std::vector<uint8_t> xoRom(5000, 0x60);
+    outFile.open(path, std::ofstream::binary);
+    outFile.write((const char *)xoRom.data(), xoRom.size());
+    outFile.close();
+    RomLibrary xoLibrary;
+    xoLibrary.SetProfile(Chip8::PROFILE_XOCHIP);
+    const RomEntry *xoEntry = xoLibrary.AddRomFile(path.c_str());
+    std::filesystem::remove(path);
+    mu_assert("RomLibrary - XO-CHIP ROM not added", xoEntry && xoEntry->size == xoRom.size() &&
+                                                        xoEntry->image.size() == Chip8::GetMemorySize(Chip8::PROFILE_XOCHIP));
+
+    Chip8 xoReference;
+    xoReference.SetProfile(Chip8::PROFILE_XOCHIP);
+    xoReference.LoadRom(xoRom.data(), (uint32_t)xoRom.size());
+    Chip8 xo;
+    xo.SetProfile(Chip8::PROFILE_XOCHIP);
+    xo.LoadImage(xoEntry->image.data(), xoEntry->hash);
+    mu_assert("RomLibrary - XO-CHIP image differs from LoadRom", memcmp(xoEntry->image.data(), xoReference.GetMemory(), 0x10000) == 0 &&
+                                                                     xoEntry->hash == xoReference.GetRomHash() &&
+                                                                     xoLibrary.FindByHash(xo.GetRomHash()) == xoEntry);
+    xo.RunCycles(2000, Chip8::EVENT_NONE);
+    mu_assert("RomLibrary - XO-CHIP ROM did not run past 4K", xo.PC == 0x11A0 && xo.V[0] == 0x60);
+
+    return 0;
+}
+
+char *Chip8Test::RomArchiveRoundTrip()
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::filesystem::path romPath = directory / "Mover (alt) [Me, 2001].ch8";
+    std::ofstream(romPath, std::ofstream::binary) << "\x12\x00";
+    std::ofstream(directory / "Mover (alt) [Me, 2001].txt", std::ofstream::binary)
+        << "Use 4 and 6 to move. Press 5 to fire!\nThe score is in hex.\nSpeed: 1000\n";
+
+    RomInfo info;
+    ParseRomInfo(romPath.string(), info);
+    std::filesystem::remove(romPath);
+    std::filesystem::remove(directory / "Mover (alt) [Me, 2001].txt");
+    mu_assert("RomArchive - Name not parsed", info.title == "Mover (alt)" && info.author == "Me" && info.year == 2001);
+    mu_assert("RomArchive - Notes not parsed", info.keys == ((1 << 4) | (1 << 5) | (1 << 6)) && info.speed == 1000 &&
+                                                   info.description.find("fire") != std::string::npos);
+
+    uint8_t ROM[] = {0x70, 0x01, 0x12, 0x00};
+    RomArchiveWriter writer;
+    mu_assert("RomArchive - ROM not added", writer.AddRom("games/mover.ch8", std::vector<uint8_t>(ROM, ROM + sizeof(ROM)), info) == 0 &&
+                                                writer.AddRom("plain.ch8", {0x00, 0xE0}, RomInfo()) == 0 &&
+                                                writer.AddRom("large.ch8", std::vector<uint8_t>(Chip8::MAX_MEMORY_SIZE - 0x200), RomInfo()) == 1);
+    std::string path = (directory / "chip8-archive-test.c8ra").string();
+    mu_assert("RomArchive - Not written", writer.Write(path.c_str()) == 0);
+
+    RomLibrary library;
+    mu_assert("RomArchive - Not read", library.AddArchive(path.c_str()) == 2 && library.GetRomCount() == 2);
+    const RomEntry *entry = library.FindByName("mover.ch8");
+    Chip8 reference;
+    reference.LoadRom(ROM, sizeof(ROM));
+    mu_assert("RomArchive - ROM differs", entry && entry->name == "games/mover.ch8" && entry->size == sizeof(ROM) &&
+                                              memcmp(entry->data, ROM, sizeof(ROM)) == 0 && entry->hash == reference.GetRomHash());
+    mu_assert("RomArchive - Info differs", entry->info.title == info.title && entry->info.author == info.author &&
+                                               entry->info.year == info.year && entry->info.keys == info.keys &&
+                                               entry->info.speed == info.speed && entry->info.description == info.description);
+
+    // a flipped ROM byte no longer matches its hash
+    std::fstream damage(path, std::fstream::binary | std::fstream::in | std::fstream::out);
+    damage.seekp(ROM_ARCHIVE_HEADER_SIZE + 2 * ROM_ARCHIVE_RECORD_SIZE);
+    damage.put(0x71);
+    damage.close();
+    RomLibrary damaged;
+    mu_assert("RomArchive - Damaged ROM accepted", damaged.AddArchive(path.c_str()) == 1 && damaged.FindByName("mover.ch8") == nullptr);
+    std::filesystem::remove(path);
+
+    return 0;
+}
+
+char *Chip8Test::SuperChipProfile()
+{
+    // 16x16 block drawn across both screen edges, then again at (56, 0) where it is
+    // scrolled right, left twice and down 3. Then the big font, FX75/FX85 and 00FD.
+    uint8_t ROM[0x26 + 32] = {0x00, 0xFF, 0x60, 0x78, 0x61, 0x38, 0xA2, 0x26, 0xD0, 0x10,
+                              0x00, 0xE0, 0x60, 0x38, 0x61, 0x00, 0xD0, 0x10, 0x00, 0xFB,
+                              0x00, 0xFC, 0x00, 0xFC, 0x00, 0xC3, 0xF0, 0x30, 0x6A, 0x12,
+                              0xFA, 0x75, 0x6A, 0x00, 0xFA, 0x85, 0x00, 0xFD};
+    memset(ROM + 0x26, 0xFF, 32);
+
+    const Chip8::Engine engines[] = {Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_PREDECODED, Chip8::ENGINE_BLOCK, Chip8::ENGINE_JIT};
+    StateDigest digests[4];
+    for (int i = 0; i < 4; i++)
+    {
+        Chip8 chip8;
+        chip8.SetEngine(engines[i]);
+        chip8.SetInstructionsPerTick(12);
+        chip8.SetProfile(Chip8::PROFILE_SCHIP);
+        chip8.LoadRom(ROM, sizeof(ROM));
+        auto pixel = [&](int x, int y) { return (chip8.display[0][y * 2 + x / 64] >> (63 - x % 64)) & 1; };
+
+        chip8.RunCycles(5, Chip8::EVENT_NONE);
+        mu_assert("SuperChip - Not high resolution", chip8.GetScreenWidth() == 128 && chip8.GetScreenHeight() == 64);
+        mu_assert("SuperChip - 16x16 sprite did not wrap", pixel(120, 56) && pixel(127, 63) && pixel(0, 56) && pixel(7, 0) &&
+                                                             !pixel(8, 56) && !pixel(119, 56) && !pixel(120, 8) && !pixel(120, 55));
+        mu_assert("SuperChip - Collision on an empty screen", chip8.V[0xF] == 0);
+
+        chip8.RunCycles(4, Chip8::EVENT_NONE);
+        mu_assert("SuperChip - 16x16 sprite wrong across words", pixel(56, 0) && pixel(63, 0) && pixel(64, 0) && pixel(71, 15) &&
+                                                                   !pixel(72, 0) && !pixel(56, 16) && !pixel(120, 56));
+        chip8.RunCycles(1, Chip8::EVENT_NONE);
+        mu_assert("SuperChip - Scroll right wrong", !pixel(59, 0) && pixel(60, 0) && pixel(75, 0) && !pixel(76, 0));
+        chip8.RunCycles(2, Chip8::EVENT_NONE);
+        mu_assert("SuperChip - Scroll left wrong", !pixel(51, 0) && pixel(52, 0) && pixel(67, 0) && !pixel(68, 0));
+        chip8.RunCycles(1, Chip8::EVENT_NONE);
+        mu_assert("SuperChip - Scroll down wrong", !pixel(52, 2) && pixel(52, 3) && pixel(52, 18) && !pixel(52, 19));
+
+        chip8.RunCycles(1, Chip8::EVENT_NONE);
+        mu_assert("SuperChip - Big font address wrong", chip8.I == 0xA0 + 8 * 10 && chip8.memory[chip8.I] == Chip8::bigFont[80]);
+        chip8.RunCycles(4, Chip8::EVENT_NONE);
+        mu_assert("SuperChip - Flags not restored", chip8.V[0xA] == 0x12 && chip8.flags[0xA] == 0x12);
+        chip8.RunCycles(10, Chip8::EVENT_NONE);
+        mu_assert("SuperChip - 00FD did not halt", chip8.PC == 0x224 && chip8.GetTrapCount() == 0);
+
+        chip8.GetDigest(digests[i]);
+        mu_assert("SuperChip - Engines disagree", i == 0 || (digests[i].displayHash == digests[0].displayHash &&
+                                                             digests[i].memoryHash == digests[0].memoryHash &&
+                                                             digests[i].PC == digests[0].PC));
+
+        // the high resolution screen and flags survive a save state
+        std::vector<uint8_t> state;
+        chip8.SaveState(state);
+        Chip8 restored;
+        restored.SetProfile(Chip8::PROFILE_SCHIP);
+        restored.LoadRom(ROM, sizeof(ROM));
+        mu_assert("SuperChip - State not loaded", restored.LoadState(state.data(), state.size()));
+        StateDigest digest;
+        restored.GetDigest(digest);
+        mu_assert("SuperChip - Restored state differs", restored.hires && digest.displayHash == digests[i].displayHash &&
+                                                            restored.flags[0xA] == 0x12);
+
+        // nor does the original machine take a SUPER-CHIP state
+        Chip8 original;
+        original.LoadRom(ROM, sizeof(ROM));
+        mu_assert("SuperChip - State loaded on another profile", !original.LoadState(state.data(), state.size()));
+    }
+
+    return 0;
+}
+
+char *Chip8Test::XoChipProfile()
+{
+    // 5XY2/5XY3 above 4K through F000 NNNN, a skip over F000, both planes drawn, then 00D1
+    uint8_t ROM[] = {0xF0, 0x00, 0x10, 0x00, 0x60, 0x11, 0x61, 0x22, 0x62, 0x33, 0x50, 0x22,
+                     0x60, 0x00, 0x61, 0x00, 0x62, 0x00, 0x50, 0x23, 0x52, 0x02, 0x30, 0x11,
+                     0xF0, 0x00, 0x00, 0x00, 0xF2, 0x01, 0xF0, 0x00, 0x02, 0x30, 0x60, 0x00,
+                     0x61, 0x00, 0xD0, 0x11, 0xF3, 0x01, 0xD0, 0x11, 0x00, 0xD1, 0x00, 0xFD,
+                     0xF0, 0x0F};
+
+    const Chip8::Engine engines[] = {Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_PREDECODED, Chip8::ENGINE_BLOCK, Chip8::ENGINE_JIT};
+    StateDigest digests[4];
+    for (int i = 0; i < 4; i++)
+    {
+        Chip8 chip8;
+        chip8.SetEngine(engines[i]);
+        chip8.SetInstructionsPerTick(12);
+        chip8.SetProfile(Chip8::PROFILE_XOCHIP);
+        chip8.LoadRom(ROM, sizeof(ROM));
+        mu_assert("XoChip - Memory is not 64K", chip8.GetMemorySize() == 0x10000);
+
+        chip8.RunCycles(11, Chip8::EVENT_NONE);
+        mu_assert("XoChip - Range not loaded", chip8.V[0] == 0x11 && chip8.V[1] == 0x22 && chip8.V[2] == 0x33);
+        mu_assert("XoChip - Range not stored in reverse above 4K", chip8.memory[0x1000] == 0x33 && chip8.memory[0x1001] == 0x22 &&
+                                                                     chip8.memory[0x1002] == 0x11);
+        mu_assert("XoChip - Skip did not step over F000 NNNN", chip8.PC == 0x21C && chip8.I == 0x1000);
+
+        chip8.RunCycles(5, Chip8::EVENT_NONE);
+        mu_assert("XoChip - Long I not loaded", chip8.I == 0x230);
+        mu_assert("XoChip - Sprite not on plane 2 alone", chip8.display[0][0] == 0 && chip8.display[1][0] == 0xF0ull << 56);
+        chip8.RunCycles(2, Chip8::EVENT_NONE);
+        mu_assert("XoChip - Planes not drawn from consecutive sprites", chip8.display[0][0] == 0xF0ull << 56 &&
+                                                                          chip8.display[1][0] == 0xFFull << 56 && chip8.V[0xF] == 0);
+        chip8.RunCycles(1, Chip8::EVENT_NONE);
+        mu_assert("XoChip - Scroll up wrong", chip8.display[0][0] == 0 && chip8.display[1][0] == 0);
+        chip8.RunCycles(5, Chip8::EVENT_NONE);
+        mu_assert("XoChip - 00FD did not halt", chip8.PC == 0x22E && chip8.GetTrapCount() == 0);
+
+        chip8.GetDigest(digests[i]);
+        mu_assert("XoChip - Engines disagree", i == 0 || (digests[i].memoryHash == digests[0].memoryHash &&
+                                                          digests[i].displayHash == digests[0].displayHash &&
+                                                          digests[i].I == digests[0].I));
+
+        // memory above 4K is part of a save state
+        std::vector<uint8_t> state;
+        chip8.SaveState(state);
+        Chip8 restored;
+        restored.SetProfile(Chip8::PROFILE_XOCHIP);
+        restored.LoadRom(ROM, sizeof(ROM));
+        mu_assert("XoChip - State not loaded", restored.LoadState(state.data(), state.size()));
+        mu_assert("XoChip - Restored memory differs", restored.memory[0x1000] == 0x33 && restored.planeMask == 3 &&
+                                                          restored.I == 0x230);
+    }
+
+    return 0;
+}
+
+char *Chip8Test::Quirks()
+{
+    // 8XY6 with V0 = 5 and V1 = 3, FX55 from 0x300, B220 with V0 = 4 and V2 = 6,
+    // then a 8x5 block drawn at (60, 30) across the corner of the screen
+    uint8_t ROM[] = {0x60, 0x05, 0x61, 0x03, 0x80, 0x16, 0xA3, 0x00, 0xF1, 0x55, 0x60, 0x04,
+                     0x62, 0x06, 0xB2, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                     0x12, 0x28, 0x12, 0x28, 0x60, 0x3C, 0x61, 0x1E, 0xA2, 0x34, 0xD0, 0x15,
+                     0x12, 0x30, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+    uint8_t quirks;
+    mu_assert("Quirks - Names not read", Chip8::ParseQuirks("shift, clip", quirks) == 0 &&
+                                             quirks == (Chip8::QUIRK_SHIFT_VY | Chip8::QUIRK_CLIP));
+    mu_assert("Quirks - None not read", Chip8::ParseQuirks("none", quirks) == 0 && quirks == Chip8::QUIRK_NONE);
+    mu_assert("Quirks - Unknown name accepted", Chip8::ParseQuirks("jump,wrap", quirks) != 0);
+
+    // the interpreter reads the flags, the predecoded engine runs the variant compiled for them
+    const Chip8::Engine engines[] = {Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_PREDECODED, Chip8::ENGINE_JIT};
+    for (int variant = 0; variant < Chip8::QUIRK_COMBINATIONS; variant++)
+    {
+        for (Chip8::Engine engine : engines)
+        {
+            Chip8 chip8;
+            chip8.SetEngine(engine);
+            chip8.SetInstructionsPerTick(12);
+            chip8.SetQuirks(variant);
+            chip8.LoadRom(ROM, sizeof(ROM));
+
+            chip8.RunCycles(5, Chip8::EVENT_NONE);
+            bool shiftVY = variant & Chip8::QUIRK_SHIFT_VY;
+            mu_assert("Quirks - Shift source wrong", chip8.V[0] == (shiftVY ? 1 : 2) && chip8.V[0xF] == 1);
+            mu_assert("Quirks - Store wrong", chip8.memory[0x300] == chip8.V[0] && chip8.memory[0x301] == 3);
+            mu_assert("Quirks - I after store wrong", chip8.I == ((variant & Chip8::QUIRK_LOAD_STORE_I) ? 0x302 : 0x300));
+
+            chip8.RunCycles(3, Chip8::EVENT_NONE);
+            mu_assert("Quirks - Jump offset wrong", chip8.PC == ((variant & Chip8::QUIRK_JUMP_VX) ? 0x226 : 0x224));
+
+            chip8.RunCycles(20, Chip8::EVENT_NONE);
+            bool clip = variant & Chip8::QUIRK_CLIP;
+            uint64_t wrapped = clip ? 0 : 0xF00000000000000Full;
+            mu_assert("Quirks - Sprite missing", (chip8.display[0][30] & 0xF) == 0xF && (chip8.display[0][31] & 0xF) == 0xF);
+            mu_assert("Quirks - Right edge wrong", (chip8.display[0][30] >> 60) == (clip ? 0 : 0xF));
+            mu_assert("Quirks - Bottom edge wrong", chip8.display[0][0] == wrapped && chip8.display[0][2] == wrapped &&
+                                                        chip8.display[0][3] == 0);
+        }
+    }
+
+    return 0;
+}
+
+char *Chip8Test::FrameStreamRoundTrip()
+{
+    SpscRing<uint8_t> ring(5);
+    uint8_t bytes[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    mu_assert("FrameStream - Ring not rounded up", ring.GetCapacity() == 8);
+    mu_assert("FrameStream - Ring rejected a fit", ring.Write(bytes, 6));
+    mu_assert("FrameStream - Ring overfilled", !ring.Write(bytes, 3) && ring.GetUsed() == 6);
+    mu_assert("FrameStream - Ring read wrong", ring.Read(bytes, 4) == 4 && bytes[0] == 1 && bytes[3] == 4);
+    mu_assert("FrameStream - Ring did not wrap", ring.Write(bytes, 6) && ring.Read(bytes, 8) == 8 && bytes[1] == 6 && bytes[2] == 1);
+
+    // draw a 0 at V0, move it right, draw again, forever: every frame changes the display
+    uint8_t ROM[] = {0xA2, 0x08, 0xD0, 0x15, 0x70, 0x01, 0x12, 0x02, 0xF0, 0x90, 0x90, 0x90, 0xF0};
+    // SUPER-CHIP: switch to 128x64, draw the 0 once and stop
+    uint8_t hiresROM[] = {0x00, 0xFF, 0xA2, 0x08, 0xD0, 0x15, 0x12, 0x06, 0xF0, 0x90, 0x90, 0x90, 0xF0};
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "Chip8Test.c8fs";
+
+    FrameSink sink;
+    mu_assert("FrameStream - Could not open", sink.Open(path.string().c_str()) == 0);
+    Chip8 chip8;
+    chip8.SetInstructionsPerTick(4);
+    chip8.LoadRom(ROM, sizeof(ROM));
+    for (int frame = 0; frame < 100; frame++)
+    {
+        chip8.RunUntilFrame(Chip8::EVENT_NONE);
+        sink.Submit(chip8);
+    }
+    mu_assert("FrameStream - Changed frames not all stored", sink.GetRecordCount() == 100 && !chip8.IsScreenDirty());
+    uint64_t lores[Chip8::MAX_SCREEN_WIDTH / 64 * Chip8::MAX_SCREEN_HEIGHT];
+    memcpy(lores, chip8.GetPackedScreen(), 32 * sizeof(uint64_t));
+    // nothing drawn, nothing stored
+    sink.Submit(chip8);
+
+    Chip8 hires;
+    hires.SetProfile(Chip8::PROFILE_SCHIP);
+    hires.SetInstructionsPerTick(4);
+    hires.LoadRom(hiresROM, sizeof(hiresROM));
+    for (int frame = 0; frame < 3; frame++)
+    {
+        hires.RunUntilFrame(Chip8::EVENT_NONE);
+        sink.Submit(hires);
+    }
+    mu_assert("FrameStream - Still frames stored", sink.GetFrameCount() == 104 && sink.GetRecordCount() == 101);
+    mu_assert("FrameStream - Could not close", sink.Close() == 0);
+
+    FrameReader reader;
+    mu_assert("FrameStream - Could not read back", reader.Open(path.string().c_str()) == 0);
+    CapturedFrame frame;
+    int records = 0;
+    while (reader.Next(frame))
+    {
+        records++;
+        mu_assert("FrameStream - Frame number wrong", frame.frame == (uint32_t)(records <= 100 ? records - 1 : 101));
+        if (records == 100)
+            mu_assert("FrameStream - Lores frame differs", frame.width == 64 && memcmp(frame.words[0], lores, sizeof(uint64_t) * 32) == 0);
+    }
+    mu_assert("FrameStream - Record count wrong", records == 101);
+    mu_assert("FrameStream - Hires frame differs", frame.width == 128 && frame.height == 64 && frame.planes == 1 &&
+                                                       memcmp(frame.words[0], hires.GetPackedScreen(), sizeof(uint64_t) * 128) == 0);
+
+    // a damaged stream ends early rather than reading past the data
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+    mu_assert("FrameStream - Could not read damaged stream", reader.Open(path.string().c_str()) == 0);
+    records = 0;
+    while (reader.Next(frame))
+        records++;
+    mu_assert("FrameStream - Damaged record decoded", records == 100);
+    std::filesystem::remove(path);
+
+    return 0;
+}
+
+char *Chip8Test::Audio()
+{
+    // sound timer set to 1, which runs out at the end of the first frame
+    uint8_t ROM[] = {0x60, 0x01, 0xF0, 0x18, 0x12, 0x04};
+    // XO-CHIP: pattern of 8 on bits then 120 off, pitch 64, sound timer 2
+    uint8_t xoROM[] = {0xA2, 0x10, 0xF0, 0x02, 0x60, 0x40, 0xF0, 0x3A, 0x60, 0x02, 0xF0, 0x18, 0x12, 0x0C, 0x00, 0x00,
+                       0xFF, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    int16_t samples[AudioSynth::MAX_FRAME_SAMPLES];
+
+    Chip8 chip8;
+    chip8.SetInstructionsPerTick(10);
+    chip8.LoadRom(ROM, sizeof(ROM));
+    AudioSynth synth(48000);
+    chip8.RunUntilFrame(Chip8::EVENT_NONE);
+    mu_assert("Audio - Frame length wrong", synth.RenderFrame(chip8, samples) == 800);
+    mu_assert("Audio - Timer that ran out in the frame not heard", chip8.GetSoundTimer() == 0 && samples[0] > 0);
+    // 440hz, a half cycle is 54.5 samples
+    mu_assert("Audio - Square wave wrong", samples[54] > 0 && samples[55] < 0 && samples[110] > 0 && samples[0] == -samples[55]);
+    chip8.RunUntilFrame(Chip8::EVENT_NONE);
+    synth.RenderFrame(chip8, samples);
+    mu_assert("Audio - Silence not silent", samples[0] == 0 && samples[799] == 0);
+
+    // setting the timer to 0 is not a sound
+    uint8_t zeroROM[] = {0x60, 0x00, 0xF0, 0x18, 0x12, 0x04};
+    const Chip8::Engine engines[] = {Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_PREDECODED, Chip8::ENGINE_BLOCK, Chip8::ENGINE_JIT};
+    for (Chip8::Engine engine : engines)
+    {
+        Chip8 quiet;
+        quiet.SetEngine(engine);
+        quiet.SetInstructionsPerTick(10);
+        quiet.LoadRom(zeroROM, sizeof(zeroROM));
+        quiet.RunUntilFrame(Chip8::EVENT_NONE);
+        synth.RenderFrame(quiet, samples);
+        mu_assert("Audio - Timer set to 0 heard", samples[0] == 0 && samples[799] == 0);
+    }
+
+    // rates that don't divide by 60 average out
+    AudioSynth odd(44100);
+    int total = 0;
+    for (int frame = 0; frame < 60; frame++)
+        total += odd.RenderFrame(chip8, samples);
+    mu_assert("Audio - Samples lost between frames", total == 44100);
+
+    Chip8 xo;
+    xo.SetProfile(Chip8::PROFILE_XOCHIP);
+    xo.SetInstructionsPerTick(10);
+    xo.LoadRom(xoROM, sizeof(xoROM));
+    xo.RunUntilFrame(Chip8::EVENT_NONE);
+    synth = AudioSynth(48000);
+    synth.RenderFrame(xo, samples);
+    // 4000 bits a second is 12 samples a bit
+    mu_assert("Audio - Pattern wrong", samples[0] > 0 && samples[95] > 0 && samples[97] < 0 && samples[799] < 0);
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "Chip8Test.wav";
+    WavWriter wav;
+    mu_assert("Audio - Could not open wav", wav.Open(path.string().c_str(), 48000) == 0);
+    wav.Write(samples, 800);
+    mu_assert("Audio - Could not close wav", wav.Close() == 0);
+    std::ifstream file(path, std::ifstream::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    mu_assert("Audio - Wav size wrong", data.size() == 44 + 1600 && memcmp(data.data(), "RIFF", 4) == 0 &&
+                                            data[4] == (uint8_t)(36 + 1600) && data[5] == (uint8_t)((36 + 1600) >> 8) &&
+                                            data[40] == (uint8_t)1600 && data[41] == (uint8_t)(1600 >> 8));
+    mu_assert("Audio - Wav samples wrong", (int16_t)(data[44] | data[45] << 8) == samples[0]);
+    file.close();
+    std::filesystem::remove(path);
+
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
 
@@ -22,6 +22,29 @@ private:
     char *SetKeyState();
     char *JMP();
     char *Call();
+    char *VirtualTimers();
+    char *RunCycles();
+    char *Decode();
+    char *SelfModifyingCode();
+    char *Jit();
+    char *DrawSprite();
+    char *ExpandRows();
+    char *SaveState();
+    char *Snapshots();
+    char *VectorLanes();
+    char *Random();
+    char *InputReplay();
+    char *Profile();
+    char *Lockstep();
+    char *Faults();
+    char *Fuzz();
+    char *RomLibraryIndex();
+    char *RomArchiveRoundTrip();
+    char *SuperChipProfile();
+    char *XoChipProfile();
+    char *Quirks();
+    char *FrameStreamRoundTrip();
+    char *Audio();
 
 private:
     Chip8 *gChip8;
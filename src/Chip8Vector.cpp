@@ -0,0 +1,727 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "Chip8Vector.hpp"
+#include "Chip8.hpp"
+#include "Bits.hpp"
+#include "Random.hpp"
+#include <cstdio>
+#include <cstring>
+
+// AVX2 code is compiled in with a target attribute and only used when the CPU has it
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CHIP8_VECTOR_AVX2
+#include <immintrin.h>
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+static bool HasAVX2()
+{
+#ifdef CHIP8_VECTOR_AVX2
+    // static init may run before the CPU model is, GCC only promises it after __builtin_cpu_init
+    static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return supported;
+#else
+    return false;
+#endif
+}
+
+bool Chip8Vector::IsVectorized()
+{
+    return HasAVX2();
+}
+
+Chip8Vector::Chip8Vector(uint32_t lanes, uint32_t instructionsPerTick)
+{
+    gBlocks = (lanes + VECTOR_LANE_BLOCK - 1) / VECTOR_LANE_BLOCK;
+    if (gBlocks == 0)
+        gBlocks = 1;
+    gLanes = gBlocks * VECTOR_LANE_BLOCK;
+    gInstructionsPerTick = instructionsPerTick;
+    gDecodeTable = GetDecodeTable();
+
+    gV.resize(16 * gLanes);
+    gPC.resize(gLanes);
+    gI.resize(gLanes);
+    gDelay.resize(gLanes);
+    gSound.resize(gLanes);
+    gSp.resize(gLanes);
+    gStack.resize(16 * gLanes);
+    gKeys.resize(gLanes);
+    gSeed.resize(gLanes);
+    gRandom.resize(gLanes);
+    gMemory.resize(4096 * gLanes);
+    gDisplay.resize(32 * gLanes);
+    gPending.resize(gBlocks);
+
+    LoadRom(nullptr, 0);
+}
+
+Chip8Vector::~Chip8Vector()
+{
+}
+
+bool Chip8Vector::LoadRom(const uint8_t *romData, uint32_t romSize)
+{
+    // let Chip8 lay out the font and ROM
+    uint8_t image[4096];
+    if (Chip8::BuildImage(romData, romSize, image) != 0)
+        return 1;
+
+    LoadImage(image);
+    return 0;
+}
+
+void Chip8Vector::LoadImage(const uint8_t *image)
+{
+    for (uint32_t lane = 0; lane < gLanes; lane++)
+        memcpy(&gMemory[lane * 4096], image, 4096);
+
+    std::fill(gV.begin(), gV.end(), 0);
+    std::fill(gPC.begin(), gPC.end(), 0x200);
+    std::fill(gI.begin(), gI.end(), 0);
+    std::fill(gDelay.begin(), gDelay.end(), 0);
+    std::fill(gSound.begin(), gSound.end(), 0);
+    std::fill(gSp.begin(), gSp.end(), 0);
+    std::fill(gStack.begin(), gStack.end(), 0);
+    std::fill(gKeys.begin(), gKeys.end(), 0);
+    std::fill(gDisplay.begin(), gDisplay.end(), 0);
+    for (uint32_t lane = 0; lane < gLanes; lane++)
+        gRandom[lane] = SeedRandom(gSeed[lane]);
+    gInstructionsUntilTick = gInstructionsPerTick;
+    gWrittenPages = 0;
+    gVectorGroups = 0;
+    gScalarGroups = 0;
+}
+
+void Chip8Vector::SetKeyState(uint32_t lane, uint8_t keyCode, uint8_t state)
+{
+    if (state)
+        gKeys[lane] |= 1 << (keyCode & 0xF);
+    else
+        gKeys[lane] &= ~(1 << (keyCode & 0xF));
+}
+
+void Chip8Vector::SetSeed(uint32_t lane, uint64_t seed)
+{
+    gSeed[lane] = seed;
+    gRandom[lane] = SeedRandom(seed);
+}
+
+void Chip8Vector::Run(uint32_t steps)
+{
+    for (uint32_t step = 0; step < steps; step++)
+    {
+        Step();
+
+        // every lane executed one instruction, so they all tick together
+        if (gInstructionsPerTick != 0 && --gInstructionsUntilTick == 0)
+        {
+            TickTimers();
+            gInstructionsUntilTick = gInstructionsPerTick;
+        }
+    }
+}
+
+#ifdef CHIP8_VECTOR_AVX2
+AVX2_FUNCTION static void CountDownAVX2(uint8_t *timers, uint32_t count)
+{
+    const __m256i one = _mm256_set1_epi8(1);
+    for (uint32_t i = 0; i < count; i += VECTOR_LANE_BLOCK)
+    {
+        __m256i *block = (__m256i *)&timers[i];
+        _mm256_storeu_si256(block, _mm256_subs_epu8(_mm256_loadu_si256(block), one));
+    }
+}
+#endif
+
+void Chip8Vector::TickTimers()
+{
+#ifdef CHIP8_VECTOR_AVX2
+    if (HasAVX2())
+    {
+        CountDownAVX2(gDelay.data(), gLanes);
+        CountDownAVX2(gSound.data(), gLanes);
+        return;
+    }
+#endif
+    for (uint32_t lane = 0; lane < gLanes; lane++)
+    {
+        if (gDelay[lane] > 0)
+            gDelay[lane]--;
+        if (gSound[lane] > 0)
+            gSound[lane]--;
+    }
+}
+
+void Chip8Vector::Step()
+{
+    for (uint32_t block = 0; block < gBlocks; block++)
+        gPending[block] = 0xFFFFFFFF;
+
+    uint32_t firstBlock = 0;
+    while (true)
+    {
+        while (firstBlock < gBlocks && gPending[firstBlock] == 0)
+            firstBlock++;
+        if (firstBlock == gBlocks)
+            break;
+
+        // the first lane still pending leads the next group
+        uint32_t leader = firstBlock * VECTOR_LANE_BLOCK + CountTrailingZeros(gPending[firstBlock]);
+        uint16_t pc = gPC[leader];
+        if (pc > 0xFFE)
+        {
+            // wrap like Chip8::WrapPC, in every lane at this PC so they still run together
+            uint16_t wrapped = (pc & 0xFFF) == 0xFFF ? 0 : pc & 0xFFF;
+            for (uint32_t lane = 0; lane < gLanes; lane++)
+            {
+                if (gPC[lane] == pc)
+                    gPC[lane] = wrapped;
+            }
+            pc = wrapped;
+        }
+        const uint8_t *memory = &gMemory[leader * 4096];
+        uint16_t opcode = memory[pc & 0xFFF] << 8 | memory[(pc + 1) & 0xFFF];
+
+        ExecuteGroup(gDecodeTable[opcode], opcode, pc, firstBlock);
+    }
+}
+
+uint32_t Chip8Vector::CheckCode(uint32_t block, uint32_t lanes, uint16_t pc, uint16_t opcode)
+{
+    uint32_t bits = lanes;
+    while (bits)
+    {
+        uint32_t index = CountTrailingZeros(bits);
+        bits &= bits - 1;
+        uint32_t lane = block * VECTOR_LANE_BLOCK + index;
+        const uint8_t *memory = &gMemory[lane * 4096];
+        if ((memory[pc & 0xFFF] << 8 | memory[(pc + 1) & 0xFFF]) != opcode)
+            lanes &= ~(1u << index);
+    }
+    return lanes;
+}
+
+void Chip8Vector::ExecuteGroup(DecodedOp op, uint16_t opcode, uint16_t pc, uint32_t firstBlock)
+{
+    if (HasAVX2())
+    {
+        ExecuteGroupAVX2(op, opcode, pc, firstBlock);
+        return;
+    }
+
+    bool checkCode = gWrittenPages & ((1 << ((pc >> 8) & 0xF)) | (1 << (((pc + 1) >> 8) & 0xF)));
+    for (uint32_t block = firstBlock; block < gBlocks; block++)
+    {
+        if (gPending[block] == 0)
+            continue;
+
+        uint32_t bits = 0;
+        for (uint32_t i = 0; i < VECTOR_LANE_BLOCK; i++)
+            bits |= (uint32_t)(gPC[block * VECTOR_LANE_BLOCK + i] == pc) << i;
+        bits &= gPending[block];
+        if (checkCode)
+            bits = CheckCode(block, bits, pc, opcode);
+        if (bits == 0)
+            continue;
+
+        gPending[block] &= ~bits;
+        gScalarGroups++;
+        while (bits)
+        {
+            ExecuteLane(block * VECTOR_LANE_BLOCK + CountTrailingZeros(bits), op, pc);
+            bits &= bits - 1;
+        }
+    }
+}
+
+// Ops BlockKernel implements
+static bool IsVectorOp(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JMP_1NNN:
+    case OP_SKIP_3XNN:
+    case OP_SKIP_4XNN:
+    case OP_SKIP_5XY0:
+    case OP_SET_6XNN:
+    case OP_ADD_7XNN:
+    case OP_SETXY_8XY0:
+    case OP_OR_8XY1:
+    case OP_AND_8XY2:
+    case OP_XOR_8XY3:
+    case OP_ADD_8XY4:
+    case OP_SUB_8XY5:
+    case OP_SHR_8XY6:
+    case OP_SUB2_8XY7:
+    case OP_SHL_8XYE:
+    case OP_SKIP_9XY0:
+    case OP_SETI_ANNN:
+    case OP_SKIPKEY_EX9E:
+    case OP_SKIPNKEY_EXA1:
+    case OP_GETTIMER_FX07:
+    case OP_SETTIMER_FX15:
+    case OP_SETSOUND_FX18:
+    case OP_ADDI_FX1E:
+    case OP_FONT_FX29:
+        return true;
+    }
+    return false;
+}
+
+#ifdef CHIP8_VECTOR_AVX2
+// all ones in byte i for every bit i set in bits
+AVX2_FUNCTION static inline __m256i ByteMask(uint32_t bits)
+{
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i select = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32((int)bits), spread);
+    return _mm256_cmpeq_epi8(_mm256_and_si256(bytes, select), select);
+}
+
+// compare 32 words against value, one bit per lane
+AVX2_FUNCTION static inline uint32_t MatchWords(const uint16_t *words, uint16_t value)
+{
+    __m256i target = _mm256_set1_epi16((int16_t)value);
+    __m256i low = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)words), target);
+    __m256i high = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(words + 16)), target);
+    // packs interleaves the 128-bit halves, the permute puts the lanes back in order
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+    return (uint32_t)_mm256_movemask_epi8(packed);
+}
+
+// the low (Shift 0) or high (Shift 8) byte of 32 words, in lane order
+template <int Shift>
+AVX2_FUNCTION static inline __m256i WordBytes(const uint16_t *words)
+{
+    const __m256i low = _mm256_set1_epi16(0xFF);
+    __m256i first = _mm256_and_si256(_mm256_srli_epi16(_mm256_loadu_si256((const __m256i *)words), Shift), low);
+    __m256i second = _mm256_and_si256(_mm256_srli_epi16(_mm256_loadu_si256((const __m256i *)(words + 16)), Shift), low);
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), 0xD8);
+}
+
+// 32 byte lanes widened to words and stored where mask is set
+template <bool Full>
+AVX2_FUNCTION static inline void StoreWords(uint16_t *words, __m256i low, __m256i high, __m256i mask)
+{
+    __m256i *out = (__m256i *)words;
+    if (!Full)
+    {
+        low = _mm256_blendv_epi8(_mm256_loadu_si256(out), low, _mm256_cvtepi8_epi16(_mm256_castsi256_si128(mask)));
+        high = _mm256_blendv_epi8(_mm256_loadu_si256(out + 1), high, _mm256_cvtepi8_epi16(_mm256_extracti128_si256(mask, 1)));
+    }
+    _mm256_storeu_si256(out, low);
+    _mm256_storeu_si256(out + 1, high);
+}
+
+// Per-lane arrays of one block of lanes
+struct LaneBlock
+{
+    // V0 of the first lane, registers are stride bytes apart
+    uint8_t *v;
+    size_t stride;
+    uint16_t *I;
+    uint16_t *PC;
+    uint16_t *keys;
+    uint8_t *delay;
+    uint8_t *sound;
+};
+
+/*
+One vectorized op for the 32 lanes of a block. Full is true when every lane of
+the block is in the group, which lets stores skip the blend.
+Statements follow the order of the Chip8 handlers, so x or y being F behaves the same.
+*/
+template <bool Full>
+AVX2_FUNCTION static inline void BlockKernel(DecodedOp op, uint16_t pc, const LaneBlock &lanes, uint32_t bits)
+{
+    uint8_t x = op.xy & 0xF;
+    uint8_t y = op.xy >> 4;
+    const __m256i mask = Full ? _mm256_set1_epi8(-1) : ByteMask(bits);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i ones = _mm256_set1_epi8(-1);
+
+// 32 bytes at p, stores only touch lanes in the group
+#define LOAD_BYTES(p) _mm256_loadu_si256((const __m256i *)(p))
+#define STORE_BYTES(p, value) _mm256_storeu_si256((__m256i *)(p), Full ? (value) : _mm256_blendv_epi8(LOAD_BYTES(p), (value), mask))
+#define LOAD(r) LOAD_BYTES(lanes.v + (r) * lanes.stride)
+#define STORE(r, value) STORE_BYTES(lanes.v + (r) * lanes.stride, value)
+
+    // lanes whose condition is true skip the next instruction
+    __m256i skip = zero;
+    // where the PC goes for lanes without a skip
+    uint16_t next = pc + 2;
+
+    switch (op.op)
+    {
+    case OP_JMP_1NNN:
+        next = op.imm;
+        break;
+    case OP_SKIP_3XNN:
+        skip = _mm256_cmpeq_epi8(LOAD(x), _mm256_set1_epi8((char)op.imm));
+        break;
+    case OP_SKIP_4XNN:
+        skip = _mm256_xor_si256(_mm256_cmpeq_epi8(LOAD(x), _mm256_set1_epi8((char)op.imm)), ones);
+        break;
+    case OP_SKIP_5XY0:
+        skip = _mm256_cmpeq_epi8(LOAD(x), LOAD(y));
+        break;
+    case OP_SET_6XNN:
+        STORE(x, _mm256_set1_epi8((char)op.imm));
+        break;
+    case OP_ADD_7XNN:
+        STORE(x, _mm256_add_epi8(LOAD(x), _mm256_set1_epi8((char)op.imm)));
+        break;
+    case OP_SETXY_8XY0:
+        STORE(x, LOAD(y));
+        break;
+    case OP_OR_8XY1:
+        STORE(x, _mm256_or_si256(LOAD(x), LOAD(y)));
+        break;
+    case OP_AND_8XY2:
+        STORE(x, _mm256_and_si256(LOAD(x), LOAD(y)));
+        break;
+    case OP_XOR_8XY3:
+        STORE(x, _mm256_xor_si256(LOAD(x), LOAD(y)));
+        break;
+    case OP_ADD_8XY4:
+    {
+        STORE(0xF, zero);
+        __m256i a = LOAD(x);
+        __m256i b = LOAD(y);
+        __m256i sum = _mm256_add_epi8(a, b);
+        // saturating add differs from wrapping add exactly when it carried
+        STORE(0xF, _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_adds_epu8(a, b), sum), one));
+        STORE(x, sum);
+        break;
+    }
+    case OP_SUB_8XY5:
+        STORE(0xF, zero);
+        // a > b exactly when the saturating a - b is non-zero
+        STORE(0xF, _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(LOAD(x), LOAD(y)), zero), one));
+        STORE(x, _mm256_sub_epi8(LOAD(x), LOAD(y)));
+        break;
+    case OP_SHR_8XY6:
+        STORE(0xF, zero);
+        STORE(0xF, _mm256_and_si256(LOAD(x), one));
+        STORE(x, _mm256_and_si256(_mm256_srli_epi16(LOAD(x), 1), _mm256_set1_epi8(0x7F)));
+        break;
+    case OP_SUB2_8XY7:
+        STORE(0xF, zero);
+        STORE(0xF, _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_subs_epu8(LOAD(y), LOAD(x)), zero), one));
+        STORE(x, _mm256_sub_epi8(LOAD(y), LOAD(x)));
+        break;
+    case OP_SHL_8XYE:
+        STORE(0xF, zero);
+        STORE(0xF, _mm256_and_si256(_mm256_srli_epi16(LOAD(x), 7), one));
+        STORE(x, _mm256_add_epi8(LOAD(x), LOAD(x)));
+        break;
+    case OP_SKIP_9XY0:
+        skip = _mm256_xor_si256(_mm256_cmpeq_epi8(LOAD(x), LOAD(y)), ones);
+        break;
+    case OP_SETI_ANNN:
+    {
+        __m256i target = _mm256_set1_epi16((int16_t)op.imm);
+        StoreWords<Full>(lanes.I, target, target, mask);
+        break;
+    }
+    case OP_SKIPKEY_EX9E:
+    case OP_SKIPNKEY_EXA1:
+    {
+        // pick the key byte holding key V[x], then test its bit
+        const __m256i bitOf = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                               1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        __m256i key = _mm256_and_si256(LOAD(x), _mm256_set1_epi8(0xF));
+        __m256i keyBits = _mm256_blendv_epi8(WordBytes<0>(lanes.keys), WordBytes<8>(lanes.keys), _mm256_cmpgt_epi8(key, _mm256_set1_epi8(7)));
+        __m256i bit = _mm256_shuffle_epi8(bitOf, key);
+        __m256i pressed = _mm256_cmpeq_epi8(_mm256_and_si256(keyBits, bit), bit);
+        skip = op.op == OP_SKIPKEY_EX9E ? pressed : _mm256_xor_si256(pressed, ones);
+        break;
+    }
+    case OP_GETTIMER_FX07:
+        STORE(x, LOAD_BYTES(lanes.delay));
+        break;
+    case OP_SETTIMER_FX15:
+        STORE_BYTES(lanes.delay, LOAD(x));
+        break;
+    case OP_SETSOUND_FX18:
+        STORE_BYTES(lanes.sound, LOAD(x));
+        break;
+    case OP_ADDI_FX1E:
+    case OP_FONT_FX29:
+    {
+        __m256i value = LOAD(x);
+        __m256i low = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(value));
+        __m256i high = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(value, 1));
+        if (op.op == OP_ADDI_FX1E)
+        {
+            low = _mm256_add_epi16(low, _mm256_loadu_si256((const __m256i *)lanes.I));
+            high = _mm256_add_epi16(high, _mm256_loadu_si256((const __m256i *)(lanes.I + 16)));
+        }
+        else
+        {
+            // 0x50 + V[x] * 5
+            const __m256i five = _mm256_set1_epi16(5);
+            const __m256i font = _mm256_set1_epi16(0x50);
+            low = _mm256_add_epi16(_mm256_mullo_epi16(low, five), font);
+            high = _mm256_add_epi16(_mm256_mullo_epi16(high, five), font);
+        }
+        StoreWords<Full>(lanes.I, low, high, mask);
+        break;
+    }
+    }
+
+#undef LOAD_BYTES
+#undef STORE_BYTES
+#undef LOAD
+#undef STORE
+
+    // PC = next, plus 2 where the skip was taken
+    __m256i target = _mm256_set1_epi16((int16_t)next);
+    __m256i two = _mm256_set1_epi16(2);
+    __m256i pcLow = _mm256_add_epi16(target, _mm256_and_si256(_mm256_cvtepi8_epi16(_mm256_castsi256_si128(skip)), two));
+    __m256i pcHigh = _mm256_add_epi16(target, _mm256_and_si256(_mm256_cvtepi8_epi16(_mm256_extracti128_si256(skip, 1)), two));
+    StoreWords<Full>(lanes.PC, pcLow, pcHigh, mask);
+}
+
+AVX2_FUNCTION void Chip8Vector::ExecuteGroupAVX2(DecodedOp op, uint16_t opcode, uint16_t pc, uint32_t firstBlock)
+{
+    bool vector = IsVectorOp(op.op);
+    bool checkCode = gWrittenPages & ((1 << ((pc >> 8) & 0xF)) | (1 << (((pc + 1) >> 8) & 0xF)));
+    for (uint32_t block = firstBlock; block < gBlocks; block++)
+    {
+        if (gPending[block] == 0)
+            continue;
+
+        uint32_t base = block * VECTOR_LANE_BLOCK;
+        uint32_t bits = MatchWords(&gPC[base], pc) & gPending[block];
+        if (checkCode)
+            bits = CheckCode(block, bits, pc, opcode);
+        if (bits == 0)
+            continue;
+        gPending[block] &= ~bits;
+
+        if (vector)
+        {
+            LaneBlock lanes = {&gV[base], gLanes, &gI[base], &gPC[base], &gKeys[base], &gDelay[base], &gSound[base]};
+            if (bits == 0xFFFFFFFF)
+                BlockKernel<true>(op, pc, lanes, bits);
+            else
+                BlockKernel<false>(op, pc, lanes, bits);
+            gVectorGroups++;
+            continue;
+        }
+
+        gScalarGroups++;
+        while (bits)
+        {
+            ExecuteLane(base + CountTrailingZeros(bits), op, pc);
+            bits &= bits - 1;
+        }
+    }
+}
+#else
+void Chip8Vector::ExecuteGroupAVX2(DecodedOp op, uint16_t opcode, uint16_t pc, uint32_t firstBlock)
+{
+}
+#endif
+
+void Chip8Vector::ExecuteLane(uint32_t lane, DecodedOp op, uint16_t pc)
+{
+    uint8_t x = op.xy & 0xF;
+    uint8_t y = op.xy >> 4;
+    // register r of this lane
+#define V(r) gV[(r) * gLanes + lane]
+    uint16_t &PC = gPC[lane];
+    uint16_t &I = gI[lane];
+    uint16_t &sp = gSp[lane];
+    uint16_t *stack = &gStack[lane * 16];
+    uint8_t *memory = &gMemory[lane * 4096];
+    uint64_t *display = &gDisplay[lane * 32];
+
+    PC = pc + 2;
+
+    // same semantics as the Chip8 handlers, including for faults, so out of range
+    // memory accesses wrap instead of touching other lanes. Faults are not counted.
+    switch (op.op)
+    {
+    case OP_CLS_00E0:
+        memset(display, 0, 32 * sizeof(uint64_t));
+        break;
+    case OP_RET_00EE:
+        if (sp != 0)
+        {
+            sp--;
+            PC = stack[sp];
+        }
+        break;
+    case OP_JMP_1NNN:
+        PC = op.imm;
+        break;
+    case OP_CALL_2NNN:
+        if (sp < 16)
+        {
+            stack[sp] = PC;
+            sp++;
+            PC = op.imm;
+        }
+        break;
+    case OP_SKIP_3XNN:
+        if (V(x) == op.imm)
+            PC += 2;
+        break;
+    case OP_SKIP_4XNN:
+        if (V(x) != op.imm)
+            PC += 2;
+        break;
+    case OP_SKIP_5XY0:
+        if (V(x) == V(y))
+            PC += 2;
+        break;
+    case OP_SET_6XNN:
+        V(x) = (uint8_t)op.imm;
+        break;
+    case OP_ADD_7XNN:
+        V(x) += (uint8_t)op.imm;
+        break;
+    case OP_SETXY_8XY0:
+        V(x) = V(y);
+        break;
+    case OP_OR_8XY1:
+        V(x) |= V(y);
+        break;
+    case OP_AND_8XY2:
+        V(x) &= V(y);
+        break;
+    case OP_XOR_8XY3:
+        V(x) ^= V(y);
+        break;
+    case OP_ADD_8XY4:
+    {
+        V(0xF) = 0;
+        uint16_t sum = V(x) + V(y);
+        if (sum > 255)
+            V(0xF) = 1;
+        V(x) = sum & 0xFF;
+        break;
+    }
+    case OP_SUB_8XY5:
+        V(0xF) = 0;
+        if (V(x) > V(y))
+            V(0xF) = 1;
+        V(x) = V(x) - V(y);
+        break;
+    case OP_SHR_8XY6:
+        V(0xF) = 0;
+        if (V(x) & 1)
+            V(0xF) = 1;
+        V(x) = V(x) >> 1;
+        break;
+    case OP_SUB2_8XY7:
+        V(0xF) = 0;
+        if (V(y) > V(x))
+            V(0xF) = 1;
+        V(x) = V(y) - V(x);
+        break;
+    case OP_SHL_8XYE:
+        V(0xF) = 0;
+        if (V(x) & 0x80)
+            V(0xF) = 1;
+        V(x) = V(x) << 1;
+        break;
+    case OP_SKIP_9XY0:
+        if (V(x) != V(y))
+            PC += 2;
+        break;
+    case OP_SETI_ANNN:
+        I = op.imm;
+        break;
+    case OP_JMPOFF_BNNN:
+        PC = op.imm + V(0);
+        break;
+    case OP_RAND_CXNN:
+        V(x) = (NextRandom(gRandom[lane]) >> 24) & op.imm;
+        break;
+    case OP_DRAW_DXYN:
+    {
+        uint8_t xPos = V(x) % 64;
+        uint8_t yPos = V(y) % 32;
+        V(0xF) = 0;
+        for (int i = 0; i < op.imm; i++)
+        {
+            uint64_t line = (uint64_t)memory[(I + i) & 0xFFF] << 56;
+            line = (line >> xPos) | (line << ((64 - xPos) & 63));
+            uint64_t &row = display[(yPos + i) % 32];
+            if (row & line)
+                V(0xF) = 1;
+            row ^= line;
+        }
+        break;
+    }
+    case OP_SKIPKEY_EX9E:
+        if ((gKeys[lane] >> (V(x) & 0xF)) & 1)
+            PC += 2;
+        break;
+    case OP_SKIPNKEY_EXA1:
+        if (!((gKeys[lane] >> (V(x) & 0xF)) & 1))
+            PC += 2;
+        break;
+    case OP_GETTIMER_FX07:
+        V(x) = gDelay[lane];
+        break;
+    case OP_WAITINPUT_FX0A:
+        // stay on this instruction until a key is down
+        PC -= 2;
+        for (int i = 0; i < 16; i++)
+        {
+            if ((gKeys[lane] >> i) & 1)
+            {
+                PC += 2;
+                V(x) = i;
+                break;
+            }
+        }
+        break;
+    case OP_SETTIMER_FX15:
+        gDelay[lane] = V(x);
+        break;
+    case OP_SETSOUND_FX18:
+        gSound[lane] = V(x);
+        break;
+    case OP_ADDI_FX1E:
+        I += V(x);
+        break;
+    case OP_FONT_FX29:
+        I = 0x50 + V(x) * 5;
+        break;
+    case OP_BCD_FX33:
+    {
+        uint8_t val = V(x);
+        memory[I & 0xFFF] = val / 100;
+        memory[(I + 1) & 0xFFF] = (val % 100) / 10;
+        memory[(I + 2) & 0xFFF] = val % 10;
+        gWrittenPages |= (1 << ((I >> 8) & 0xF)) | (1 << (((I + 2) >> 8) & 0xF));
+        break;
+    }
+    case OP_REGTOMEM_FX55:
+        for (int i = 0; i <= x; i++)
+            memory[(I + i) & 0xFFF] = V(i);
+        gWrittenPages |= (1 << ((I >> 8) & 0xF)) | (1 << (((I + x) >> 8) & 0xF));
+        break;
+    case OP_MEMTOREG_FX65:
+        for (int i = 0; i <= x; i++)
+            V(i) = memory[(I + i) & 0xFFF];
+        break;
+    default:
+        // unknown opcodes do nothing, as in Chip8
+        break;
+    }
+#undef V
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef CHIP8_VECTOR_HPP
+#define CHIP8_VECTOR_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "Chip8Decode.hpp"
+
+// Lanes are processed in groups of this many, one byte per lane in a 256-bit register
+#define VECTOR_LANE_BLOCK 32
+
+/*
+Many copies of one ROM stepped in lockstep, for running lots of instances with different inputs.
+State is stored struct-of-arrays: register r of every lane is contiguous, as are PC, I and timers.
+Every step executes one instruction in every lane. Lanes whose PC matches are executed together:
+the ALU ops (6XNN, 7XNN, 8XY*), skips (3XNN, 4XNN, 5XY0, 9XY0, EX9E, EXA1), 1NNN, ANNN and
+FX07/15/18/1E/29 with AVX2 across 32 lanes at a time, everything else lane by lane.
+Lanes that diverge are regrouped by PC on every step.
+Instruction semantics match Chip8. Timers always run on virtual time.
+*/
+class Chip8Vector
+{
+public:
+    // pLanes is rounded up to a multiple of VECTOR_LANE_BLOCK
+    Chip8Vector(uint32_t pLanes, uint32_t pInstructionsPerTick);
+    virtual ~Chip8Vector();
+
+public:
+    // Load the ROM into every lane and reset them - Returns 1 if the ROM is too large and 0 otherwise
+    bool LoadRom(const uint8_t *pRomData, uint32_t pRomSize);
+    // Copy a memory image made by Chip8::BuildImage into every lane and reset them
+    void LoadImage(const uint8_t *pImage);
+
+    // Execute pSteps instructions in every lane
+    void Run(uint32_t pSteps);
+
+    // Set keyboard state of one lane (keycode is [0,15], state is 0 or 1)
+    void SetKeyState(uint32_t pLane, uint8_t pKeyCode, uint8_t pState);
+    // Seed the CXNN generator of one lane, like Chip8::SetSeed (every lane defaults to 0)
+    void SetSeed(uint32_t pLane, uint64_t pSeed);
+
+    uint32_t GetLaneCount() { return gLanes; }
+    uint8_t GetRegister(uint32_t pLane, uint8_t pRegister) { return gV[pRegister * gLanes + pLane]; }
+    uint16_t GetPC(uint32_t pLane) { return gPC[pLane]; }
+    uint16_t GetI(uint32_t pLane) { return gI[pLane]; }
+    uint8_t GetDelay(uint32_t pLane) { return gDelay[pLane]; }
+    const uint8_t *GetMemory(uint32_t pLane) { return &gMemory[pLane * 4096]; }
+    // 32 rows of 64 pixels, same layout as Chip8::GetPackedScreen
+    const uint64_t *GetPackedScreen(uint32_t pLane) { return &gDisplay[pLane * 32]; }
+
+    // Lane blocks executed with vector code and lane by lane, for diagnostics
+    uint64_t GetVectorGroups() { return gVectorGroups; }
+    uint64_t GetScalarGroups() { return gScalarGroups; }
+
+    // Returns false if this build or host has no AVX2, in which case every op runs lane by lane
+    static bool IsVectorized();
+
+private:
+    // Execute one instruction in every lane
+    void Step();
+    // Count the delay and sound timers of every lane down by one 60hz tick
+    void TickTimers();
+    /*
+    Execute pOp (decoded from pOpcode) in every pending lane from pFirstBlock on
+    whose PC is pPC, and mark those lanes done.
+    */
+    void ExecuteGroup(DecodedOp pOp, uint16_t pOpcode, uint16_t pPC, uint32_t pFirstBlock);
+    // ExecuteGroup with AVX2 for matching lanes and vectorized ops
+    void ExecuteGroupAVX2(DecodedOp pOp, uint16_t pOpcode, uint16_t pPC, uint32_t pFirstBlock);
+    // Execute pOp in a single lane, used for everything that is not vectorized
+    void ExecuteLane(uint32_t pLane, DecodedOp pOp, uint16_t pPC);
+    /*
+    Drop lanes from pLanes that hold something other than pOpcode at pPC.
+    Only needed once some lane wrote to the pages at pPC, the leader may be the one that did.
+    */
+    uint32_t CheckCode(uint32_t pBlock, uint32_t pLanes, uint16_t pPC, uint16_t pOpcode);
+
+private:
+    uint32_t gLanes;
+    uint32_t gBlocks;
+    uint32_t gInstructionsPerTick;
+    uint32_t gInstructionsUntilTick;
+    const DecodedOp *gDecodeTable;
+
+    // register r of lane l is at gV[r * gLanes + l]
+    std::vector<uint8_t> gV;
+    std::vector<uint16_t> gPC;
+    std::vector<uint16_t> gI;
+    std::vector<uint8_t> gDelay;
+    std::vector<uint8_t> gSound;
+    std::vector<uint16_t> gSp;
+    // 16 entries per lane
+    std::vector<uint16_t> gStack;
+    // key bitmask per lane
+    std::vector<uint16_t> gKeys;
+    // CXNN generator per lane and the seed LoadRom restarts it from
+    std::vector<uint64_t> gRandom;
+    std::vector<uint64_t> gSeed;
+    // 4K per lane
+    std::vector<uint8_t> gMemory;
+    // bit per 256-byte page any lane has written to, groups at those pages check every lane's code
+    uint16_t gWrittenPages;
+    // 32 packed rows per lane
+    std::vector<uint64_t> gDisplay;
+
+    // per lane block, lanes that have not executed their instruction in the current step
+    std::vector<uint32_t> gPending;
+
+    uint64_t gVectorGroups;
+    uint64_t gScalarGroups;
+};
+
+#endif // CHIP8_VECTOR_HPP
@@ -0,0 +1,122 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "FrameConvert.hpp"
+
+// SSE2 is part of x86-64, AVX2 is compiled in with a target attribute and picked at runtime
+#if defined(__x86_64__) || defined(_M_X64)
+#define FRAME_CONVERT_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FRAME_CONVERT_AVX2
+#include <immintrin.h>
+#endif
+
+typedef void (*ExpandFunction)(const uint64_t *pRows, int pRowCount, uint32_t pOn, uint32_t pOff, uint32_t *pPixels);
+
+void ExpandRowsScalar(const uint64_t *rows, int rowCount, uint32_t on, uint32_t off, uint32_t *pixels)
+{
+    for (int y = 0; y < rowCount; y++)
+    {
+        uint64_t row = rows[y];
+        for (int x = 0; x < 64; x++)
+        {
+            // all ones when the pixel is set
+            uint32_t mask = 0 - (uint32_t)((row >> (63 - x)) & 1);
+            pixels[x + y * 64] = (on & mask) | (off & ~mask);
+        }
+    }
+}
+
+void ExpandPlanes(const uint64_t *plane0, const uint64_t *plane1, int rowCount, const uint32_t palette[4], uint32_t *pixels)
+{
+    for (int y = 0; y < rowCount; y++)
+    {
+        uint64_t low = plane0[y];
+        uint64_t high = plane1[y];
+        for (int x = 0; x < 64; x++)
+            pixels[x + y * 64] = palette[((low >> (63 - x)) & 1) | ((high >> (63 - x)) & 1) << 1];
+    }
+}
+
+#ifdef FRAME_CONVERT_SSE2
+static void ExpandRowsSSE2(const uint64_t *rows, int rowCount, uint32_t on, uint32_t off, uint32_t *pixels)
+{
+    // lane 0 tests the highest bit of a nibble, which is the leftmost pixel
+    const __m128i bits = _mm_set_epi32(1, 2, 4, 8);
+    const __m128i onColor = _mm_set1_epi32((int)on);
+    const __m128i offColor = _mm_set1_epi32((int)off);
+
+    for (int y = 0; y < rowCount; y++)
+    {
+        uint64_t row = rows[y];
+        __m128i *out = (__m128i *)(pixels + y * 64);
+        for (int n = 0; n < 16; n++)
+        {
+            __m128i nibble = _mm_set1_epi32((int)((row >> (60 - n * 4)) & 0xF));
+            __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(nibble, bits), bits);
+            _mm_storeu_si128(out + n, _mm_or_si128(_mm_and_si128(mask, onColor), _mm_andnot_si128(mask, offColor)));
+        }
+    }
+}
+#endif
+
+#ifdef FRAME_CONVERT_AVX2
+__attribute__((target("avx2"))) static void ExpandRowsAVX2(const uint64_t *rows, int rowCount, uint32_t on, uint32_t off, uint32_t *pixels)
+{
+    // one byte of the row per store, lane 0 is the byte's top bit
+    const __m256i bits = _mm256_set_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const __m256i onColor = _mm256_set1_epi32((int)on);
+    const __m256i offColor = _mm256_set1_epi32((int)off);
+
+    for (int y = 0; y < rowCount; y++)
+    {
+        uint64_t row = rows[y];
+        __m256i *out = (__m256i *)(pixels + y * 64);
+        for (int b = 0; b < 8; b++)
+        {
+            __m256i byte = _mm256_set1_epi32((int)((row >> (56 - b * 8)) & 0xFF));
+            __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(byte, bits), bits);
+            _mm256_storeu_si256(out + b, _mm256_blendv_epi8(offColor, onColor, mask));
+        }
+    }
+}
+#endif
+
+static ExpandFunction SelectKernel(const char **name)
+{
+#ifdef FRAME_CONVERT_AVX2
+    // static init may run before the CPU model is, GCC only promises it after this
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *name = "avx2";
+        return ExpandRowsAVX2;
+    }
+#endif
+#ifdef FRAME_CONVERT_SSE2
+    *name = "sse2";
+    return ExpandRowsSSE2;
+#else
+    *name = "scalar";
+    return ExpandRowsScalar;
+#endif
+}
+
+static const char *kernelName = nullptr;
+// Static init runs before main, so the pointer is set before any thread can call ExpandRows
+static const ExpandFunction kernel = SelectKernel(&kernelName);
+
+void ExpandRows(const uint64_t *rows, int rowCount, uint32_t on, uint32_t off, uint32_t *pixels)
+{
+    kernel(rows, rowCount, on, off, pixels);
+}
+
+const char *GetExpandKernelName()
+{
+    return kernelName;
+}
@@ -0,0 +1,32 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef FRAME_CONVERT_HPP
+#define FRAME_CONVERT_HPP
+
+#include <stdint.h>
+
+/*
+Expands packed 64-pixel display rows (leftmost pixel in the most significant bit,
+as returned by Chip8::GetPackedScreen) into 32-bit pixels.
+Set bits become pOn and clear bits pOff. pPixels must hold pRowCount * 64 values.
+Uses AVX2 when the CPU has it, SSE2 on other x86-64 hosts and plain C++ elsewhere.
+*/
+void ExpandRows(const uint64_t *pRows, int pRowCount, uint32_t pOn, uint32_t pOff, uint32_t *pPixels);
+
+// Portable version of ExpandRows, used as the fallback and as the reference in tests
+void ExpandRowsScalar(const uint64_t *pRows, int pRowCount, uint32_t pOn, uint32_t pOff, uint32_t *pPixels);
+
+/*
+Expands two bit-planes of packed rows (XO-CHIP) into 32-bit pixels. Each pixel takes
+pPalette[plane 0 bit | plane 1 bit << 1]. pPixels must hold pRowCount * 64 values.
+*/
+void ExpandPlanes(const uint64_t *pPlane0, const uint64_t *pPlane1, int pRowCount, const uint32_t pPalette[4], uint32_t *pPixels);
+
+// Name of the kernel ExpandRows picked on this host ("avx2", "sse2" or "scalar")
+const char *GetExpandKernelName();
+
+#endif // FRAME_CONVERT_HPP
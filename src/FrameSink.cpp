@@ -0,0 +1,293 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "FrameSink.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+static const uint8_t LAYOUT_HIRES = 1;
+static const uint8_t LAYOUT_PLANES = 2;
+static const uint8_t LAYOUT_KEY = 4;
+
+static void Put(std::vector<uint8_t> &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+static uint64_t Get(const uint8_t *in, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)in[i] << (i * 8);
+    return value;
+}
+
+static void PutVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// Returns false if the varint runs past end or is longer than 64 bits
+static bool GetVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (data == end)
+            return false;
+        uint8_t byte = *data++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+FrameSink::FrameSink(size_t pQueueBytes) : gQueue(pQueueBytes),
+                                           gStop(false),
+                                           gFailed(false),
+                                           gFrameCount(0),
+                                           gRecordCount(0),
+                                           gRetryCount(0),
+                                           gLastRecordFrame(0),
+                                           gLayout(0xFF)
+{
+    memset(gPrevious, 0, sizeof(gPrevious));
+}
+
+FrameSink::~FrameSink()
+{
+    Close();
+}
+
+bool FrameSink::Open(const char *fileName)
+{
+    Close();
+    gFile.open(fileName, std::ofstream::binary);
+    if (!gFile.is_open())
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 1;
+    }
+
+    std::vector<uint8_t> header(FRAME_STREAM_MAGIC, FRAME_STREAM_MAGIC + 4);
+    Put(header, FRAME_STREAM_VERSION, 1);
+    Put(header, 0, 3);
+    gFile.write((const char *)header.data(), header.size());
+
+    gFrameCount = 0;
+    gRecordCount = 0;
+    gRetryCount = 0;
+    gLastRecordFrame = 0;
+    gLayout = 0xFF;
+    gStop = false;
+    gFailed = !gFile;
+    gWriter = std::thread(&FrameSink::WriterLoop, this);
+    return 0;
+}
+
+void FrameSink::Submit(Chip8 &chip8)
+{
+    uint32_t frame = gFrameCount++;
+    if (!chip8.IsScreenDirty() || !gWriter.joinable())
+        return;
+
+    int width = chip8.GetScreenWidth();
+    int height = chip8.GetScreenHeight();
+    int planes = chip8.GetProfile() == Chip8::PROFILE_XOCHIP ? 2 : 1;
+    int rowWords = width / 64;
+    uint8_t layout = (width == Chip8::MAX_SCREEN_WIDTH ? LAYOUT_HIRES : 0) | (planes == 2 ? LAYOUT_PLANES : 0);
+    bool key = layout != gLayout;
+    static const uint64_t empty[Chip8::MAX_SCREEN_WIDTH / 64 * Chip8::MAX_SCREEN_HEIGHT] = {};
+
+    // rows that differ in any plane
+    uint64_t changed = 0;
+    for (int plane = 0; plane < planes; plane++)
+    {
+        const uint64_t *current = chip8.GetPackedScreen(plane);
+        const uint64_t *previous = key ? empty : gPrevious[plane];
+        for (int row = 0; row < height; row++)
+        {
+            uint64_t difference = 0;
+            for (int word = 0; word < rowWords; word++)
+                difference |= current[row * rowWords + word] ^ previous[row * rowWords + word];
+            if (difference)
+                changed |= 1ull << row;
+        }
+    }
+    // drawn and erased again within the frame
+    if (!changed && !key)
+    {
+        chip8.MarkScreenClean();
+        return;
+    }
+
+    gRecord.clear();
+    PutVarint(gRecord, frame - gLastRecordFrame);
+    Put(gRecord, layout | (key ? LAYOUT_KEY : 0), 1);
+    Put(gRecord, changed, height / 8);
+    for (int plane = 0; plane < planes; plane++)
+    {
+        const uint64_t *current = chip8.GetPackedScreen(plane);
+        const uint64_t *previous = key ? empty : gPrevious[plane];
+        for (int row = 0; row < height; row++)
+        {
+            if (!(changed & (1ull << row)))
+                continue;
+            for (int word = 0; word < rowWords; word++)
+                Put(gRecord, current[row * rowWords + word] ^ previous[row * rowWords + word], 8);
+        }
+    }
+
+    // a full queue leaves the screen dirty, so the next frame carries this one's changes too
+    if (!gQueue.Write(gRecord.data(), gRecord.size()))
+    {
+        gRetryCount++;
+        return;
+    }
+
+    for (int plane = 0; plane < planes; plane++)
+        memcpy(gPrevious[plane], chip8.GetPackedScreen(plane), height * rowWords * sizeof(uint64_t));
+    gLayout = layout;
+    gLastRecordFrame = frame;
+    gRecordCount++;
+    chip8.MarkScreenClean();
+}
+
+bool FrameSink::Close()
+{
+    if (!gWriter.joinable())
+        return 0;
+
+    gStop = true;
+    gWriter.join();
+    gFile.close();
+    if (gFailed || !gFile)
+    {
+        printf("Could not write frame stream\n");
+        return 1;
+    }
+    return 0;
+}
+
+void FrameSink::WriterLoop()
+{
+    std::vector<uint8_t> chunk(64 * 1024);
+    while (true)
+    {
+        // checked before draining, so whatever was queued before Close is written
+        bool stopping = gStop;
+        size_t count = gQueue.Read(chunk.data(), chunk.size());
+        if (count > 0)
+        {
+            gFile.write((const char *)chunk.data(), count);
+            if (!gFile)
+                gFailed = true;
+            continue;
+        }
+        if (stopping)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    gFile.flush();
+    if (!gFile)
+        gFailed = true;
+}
+
+FrameReader::FrameReader() : gPosition(0)
+{
+    memset(&gFrame, 0, sizeof(gFrame));
+}
+
+FrameReader::~FrameReader()
+{
+}
+
+bool FrameReader::Open(const char *fileName)
+{
+    std::ifstream file(fileName, std::ifstream::binary);
+    if (!file.is_open())
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 1;
+    }
+    gData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    if (gData.size() < FRAME_STREAM_HEADER_SIZE || memcmp(gData.data(), FRAME_STREAM_MAGIC, 4) != 0 ||
+        gData[4] != FRAME_STREAM_VERSION)
+    {
+        printf("Not a frame stream: %s\n", fileName);
+        gData.clear();
+        return 1;
+    }
+    Rewind();
+    return 0;
+}
+
+void FrameReader::Rewind()
+{
+    gPosition = FRAME_STREAM_HEADER_SIZE;
+    memset(&gFrame, 0, sizeof(gFrame));
+}
+
+bool FrameReader::Next(CapturedFrame &frame)
+{
+    if (gPosition >= gData.size())
+        return false;
+
+    const uint8_t *data = gData.data() + gPosition;
+    const uint8_t *end = gData.data() + gData.size();
+    uint64_t frames;
+    if (!GetVarint(data, end, frames) || data == end)
+        return false;
+    uint8_t layout = *data++;
+    int width = (layout & LAYOUT_HIRES) ? 128 : 64;
+    int height = (layout & LAYOUT_HIRES) ? 64 : 32;
+    int planes = (layout & LAYOUT_PLANES) ? 2 : 1;
+    int rowWords = width / 64;
+    if ((size_t)(end - data) < (size_t)height / 8)
+        return false;
+    uint64_t changed = Get(data, height / 8);
+    data += height / 8;
+
+    int changedRows = 0;
+    for (int row = 0; row < height; row++)
+        changedRows += (changed >> row) & 1;
+    if ((size_t)(end - data) < (size_t)planes * changedRows * rowWords * 8)
+        return false;
+
+    if ((layout & LAYOUT_KEY) || width != gFrame.width || planes != gFrame.planes)
+        memset(gFrame.words, 0, sizeof(gFrame.words));
+    gFrame.frame += (uint32_t)frames;
+    gFrame.width = width;
+    gFrame.height = height;
+    gFrame.planes = planes;
+    for (int plane = 0; plane < planes; plane++)
+    {
+        for (int row = 0; row < height; row++)
+        {
+            if (!(changed & (1ull << row)))
+                continue;
+            for (int word = 0; word < rowWords; word++)
+            {
+                gFrame.words[plane][row * rowWords + word] ^= Get(data, 8);
+                data += 8;
+            }
+        }
+    }
+
+    gPosition = data - gData.data();
+    frame = gFrame;
+    return true;
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef FRAME_SINK_HPP
+#define FRAME_SINK_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include "Chip8.hpp"
+#include "SpscRing.hpp"
+
+/*
+Frame stream format, all values little endian:
+    "C8FS", version (1), 3 zero bytes
+    one record per frame that changed the display:
+        frames since the previous record (LEB128 varint, the first counts from frame 0)
+        layout (1): bit 0 set for 128x64 rather than 64x32, bit 1 for two planes,
+            bit 2 for a key frame, which is XOR'd against an empty display
+        changed rows (height / 8 bytes), bit per row
+        for each plane, each changed row: the row XOR the previous record's (8 bytes per 64 pixels)
+A change of layout always starts a key frame. Rows are packed as Chip8::GetPackedScreen.
+*/
+static const uint8_t FRAME_STREAM_MAGIC[4] = {'C', '8', 'F', 'S'};
+static const uint8_t FRAME_STREAM_VERSION = 1;
+static const size_t FRAME_STREAM_HEADER_SIZE = 4 + 1 + 3;
+
+// One display as stored in a frame stream
+struct CapturedFrame
+{
+    // 60hz frames since capture started
+    uint32_t frame;
+    int width;
+    int height;
+    int planes;
+    // rows of width / 64 words, as Chip8::GetPackedScreen
+    uint64_t words[Chip8::PLANE_COUNT][Chip8::MAX_SCREEN_WIDTH / 64 * Chip8::MAX_SCREEN_HEIGHT];
+};
+
+/*
+Headless capture of what a Chip8 shows. Submit is called once per 60hz frame by the
+thread running the machine. Frames the ROM did not draw to are skipped, the rest are
+delta-encoded and queued, and a background thread writes the queue to the file.
+Submit does no I/O, takes no locks and doesn't allocate once warmed up, so capture
+can't stall emulation. If the writer falls behind the frame is left pending and
+tried again next frame.
+*/
+class FrameSink
+{
+public:
+    // pQueueBytes is how much encoded video can wait for the writer
+    FrameSink(size_t pQueueBytes = 1 << 20);
+    virtual ~FrameSink();
+
+public:
+    // Create the stream and start the writer - Returns 1 if the file could not be opened and 0 otherwise
+    bool Open(const char *pFileName);
+    // Capture pChip8's display if it changed since the last frame captured from it
+    void Submit(Chip8 &pChip8);
+    // Write out everything queued and close the file - Returns 1 if any write failed and 0 otherwise
+    bool Close();
+
+    // Frames submitted, frames stored, and frames that found the queue full
+    uint32_t GetFrameCount() const { return gFrameCount; }
+    uint32_t GetRecordCount() const { return gRecordCount; }
+    uint32_t GetRetryCount() const { return gRetryCount; }
+
+private:
+    void WriterLoop();
+
+private:
+    SpscRing<uint8_t> gQueue;
+    std::ofstream gFile;
+    std::thread gWriter;
+    std::atomic<bool> gStop;
+    std::atomic<bool> gFailed;
+
+    // producer side
+    uint32_t gFrameCount;
+    uint32_t gRecordCount;
+    uint32_t gRetryCount;
+    uint32_t gLastRecordFrame;
+    // layout byte of the last record, 0xFF before the first
+    uint8_t gLayout;
+    uint64_t gPrevious[Chip8::PLANE_COUNT][Chip8::MAX_SCREEN_WIDTH / 64 * Chip8::MAX_SCREEN_HEIGHT];
+    std::vector<uint8_t> gRecord;
+};
+
+// Reads a frame stream back one captured frame at a time
+class FrameReader
+{
+public:
+    FrameReader();
+    virtual ~FrameReader();
+
+public:
+    // Read a stream file - Returns 1 if it could not be read or is not a frame stream and 0 otherwise
+    bool Open(const char *pFileName);
+    // Decode the next frame into pFrame - Returns false at the end or on damaged data
+    bool Next(CapturedFrame &pFrame);
+    // Back to the first frame
+    void Rewind();
+
+private:
+    std::vector<uint8_t> gData;
+    size_t gPosition;
+    // the last frame decoded, what the next record is XOR'd against
+    CapturedFrame gFrame;
+};
+
+#endif // FRAME_SINK_HPP
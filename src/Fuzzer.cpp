@@ -0,0 +1,436 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "Fuzzer.hpp"
+#include "Bits.hpp"
+#include "Chip8Decode.hpp"
+#include "Random.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+// LoadRom takes less than this
+static const size_t FUZZ_MAX_ROM = 0xE00 - 2;
+static const uint32_t FUZZ_MAX_RUN_FAULTS = 32;
+// key in gFound for divergences
+static const uint32_t FUZZ_DIVERGENCE = 0xFF;
+
+// Hit counts are compared by class, so a loop running a few more times is not new
+static uint8_t HitClass(uint8_t count)
+{
+    if (count < 3)
+        return count;
+    if (count < 4)
+        return 4;
+    if (count < 8)
+        return 8;
+    if (count < 16)
+        return 16;
+    if (count < 32)
+        return 32;
+    if (count < 128)
+        return 64;
+    return 128;
+}
+
+Fuzzer::Fuzzer(uint64_t seed) : gTrace(Chip8::COVERAGE_MAP_SIZE),
+                                gSeen(Chip8::COVERAGE_MAP_SIZE),
+                                gEdges(0),
+                                gRandom(SeedRandom(seed)),
+                                gCyclesPerRun(2000),
+                                gRuns(0)
+{
+    gChip8.SetInstructionsPerTick(12);
+    gChip8.SetCoverage(gTrace.data());
+}
+
+Fuzzer::~Fuzzer()
+{
+}
+
+void Fuzzer::SetDifferential(Chip8::Engine engine)
+{
+    gLockstep.reset(new LockstepRunner(Chip8::ENGINE_INTERPRETER, engine));
+    gLockstep->SetInterval(64);
+}
+
+void Fuzzer::AddSeed(const uint8_t *rom, size_t size)
+{
+    FuzzInput input;
+    input.rom.assign(rom, rom + std::min(size, FUZZ_MAX_ROM));
+    if (input.rom.empty())
+        return;
+
+    gCurrent = input;
+    Execute(gCurrent);
+    MergeCoverage();
+    gCorpus.push_back(gCurrent);
+}
+
+uint32_t Fuzzer::Pick(uint32_t bound)
+{
+    return (uint32_t)(((uint64_t)::NextRandom(gRandom) * bound) >> 32);
+}
+
+void Fuzzer::Run(uint64_t runs)
+{
+    if (gCorpus.empty())
+    {
+        std::vector<uint8_t> rom(128);
+        for (uint8_t &byte : rom)
+            byte = (uint8_t)Pick(256);
+        AddSeed(rom.data(), rom.size());
+    }
+
+    for (uint64_t run = 0; run < runs; run++)
+    {
+        // assigning reuses gCurrent's buffers
+        gCurrent = gCorpus[Pick((uint32_t)gCorpus.size())];
+        Mutate(gCurrent);
+        Execute(gCurrent);
+        gRuns++;
+
+        bool fresh = MergeCoverage();
+        // copy, CheckFault runs more inputs
+        std::vector<FuzzFault> faults = gRunFaults;
+        for (const FuzzFault &fault : faults)
+            CheckFault(fault);
+
+        if (fresh)
+        {
+            gCorpus.push_back(gCurrent);
+            if (gLockstep)
+                CheckDivergence();
+        }
+    }
+}
+
+void Fuzzer::Execute(const FuzzInput &input)
+{
+    Execute(input, gCyclesPerRun);
+}
+
+void Fuzzer::Execute(const FuzzInput &input, uint64_t cycles)
+{
+    gRunFaults.clear();
+    memset(gTrace.data(), 0, gTrace.size());
+    if (gChip8.LoadRom((uint8_t *)input.rom.data(), (uint32_t)input.rom.size()) != 0)
+        return;
+
+    size_t nextKey = 0;
+    while (gChip8.GetCycleCount() < cycles)
+    {
+        uint64_t cycle = gChip8.GetCycleCount();
+        for (; nextKey < input.keys.size() && input.keys[nextKey].cycle <= cycle; nextKey++)
+            gChip8.SetKeyState(input.keys[nextKey].key, input.keys[nextKey].state);
+
+        uint64_t end = cycles;
+        if (nextKey < input.keys.size() && input.keys[nextKey].cycle < end)
+            end = input.keys[nextKey].cycle;
+        gChip8.RunCycles((uint32_t)(end - cycle), Chip8::EVENT_FAULT);
+
+        if (!(gChip8.GetEvents() & Chip8::EVENT_FAULT) || gRunFaults.size() >= FUZZ_MAX_RUN_FAULTS)
+            continue;
+
+        FuzzFault fault;
+        fault.fault = gChip8.GetLastFault();
+        fault.PC = gChip8.GetLastFaultPC();
+        const uint8_t *memory = gChip8.GetMemory();
+        // a PC fault is not raised by an instruction
+        fault.opcode = fault.fault == Chip8::FAULT_PC ? 0 : memory[fault.PC] << 8 | memory[(fault.PC + 1) & 0xFFF];
+        fault.cycle = gChip8.GetCycleCount();
+
+        bool known = false;
+        for (const FuzzFault &other : gRunFaults)
+            known |= other.fault == fault.fault && other.PC == fault.PC;
+        if (!known)
+            gRunFaults.push_back(fault);
+    }
+}
+
+bool Fuzzer::MergeCoverage()
+{
+    // looked up, this runs over the whole map after every run
+    static uint8_t hitClasses[256];
+    if (hitClasses[1] == 0)
+    {
+        for (int count = 0; count < 256; count++)
+            hitClasses[count] = HitClass((uint8_t)count);
+    }
+
+    bool fresh = false;
+    const uint64_t *words = (const uint64_t *)gTrace.data();
+    for (size_t word = 0; word < gTrace.size() / 8; word++)
+    {
+        // most of the map is untouched, and most touched words have one edge
+        for (uint64_t bits = words[word]; bits; )
+        {
+            int shift = CountTrailingZeros(bits) & ~7;
+            bits &= ~(0xFFull << shift);
+            size_t i = word * 8 + shift / 8;
+            uint8_t hitClass = hitClasses[gTrace[i]];
+            if ((hitClass & ~gSeen[i]) == 0)
+                continue;
+            if (gSeen[i] == 0)
+                gEdges++;
+            gSeen[i] |= hitClass;
+            fresh = true;
+        }
+    }
+    return fresh;
+}
+
+void Fuzzer::Mutate(FuzzInput &input)
+{
+    std::vector<uint8_t> &rom = input.rom;
+    std::vector<InputEvent> &keys = input.keys;
+
+    int count = 1 + Pick(8);
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t size = (uint32_t)rom.size();
+        // even offset of an opcode in the ROM
+        uint32_t word = Pick(size / 2) * 2;
+        uint16_t opcode = 0;
+
+        switch (Pick(10))
+        {
+        case 0:
+            rom[Pick(size)] ^= 1 << Pick(8);
+            break;
+        case 1:
+            rom[Pick(size)] = (uint8_t)Pick(256);
+            break;
+        case 2:
+            opcode = (uint16_t)Pick(0x10000);
+            break;
+        case 3:
+        {
+            // opcodes that use the stack, memory or the PC, aimed inside the ROM
+            uint16_t address = (uint16_t)(0x200 + word);
+            uint16_t x = (uint16_t)(Pick(16) << 8);
+            const uint16_t hazards[] = {0x00EE, (uint16_t)(0x2000 | address), (uint16_t)(0x1000 | address), (uint16_t)(0xB000 | address),
+                                        (uint16_t)(0xA000 | Pick(0x1000)), (uint16_t)(0xF01E | x), (uint16_t)(0xF033 | x),
+                                        (uint16_t)(0xF055 | x), (uint16_t)(0xF065 | x), (uint16_t)(0xD000 | Pick(0x1000))};
+            opcode = hazards[Pick(sizeof(hazards) / sizeof(hazards[0]))];
+            break;
+        }
+        case 4:
+            if (size + 2 <= FUZZ_MAX_ROM)
+                rom.insert(rom.begin() + word, 2, 0);
+            opcode = (uint16_t)Pick(0x10000);
+            break;
+        case 5:
+            if (size > 2)
+                rom.erase(rom.begin() + word, rom.begin() + word + 2);
+            break;
+        case 6:
+        {
+            uint32_t from = Pick(size);
+            uint32_t to = Pick(size);
+            uint32_t length = 1 + Pick(std::min(32u, size - std::max(from, to)));
+            memmove(&rom[to], &rom[from], length);
+            break;
+        }
+        case 7:
+        {
+            // splice the tail of another input onto this one
+            const std::vector<uint8_t> &other = gCorpus[Pick((uint32_t)gCorpus.size())].rom;
+            uint32_t cut = Pick(std::min(size, (uint32_t)other.size()));
+            rom.resize(cut);
+            rom.insert(rom.end(), other.begin() + cut, other.end());
+            break;
+        }
+        case 8:
+        {
+            InputEvent event = {Pick(gCyclesPerRun), (uint8_t)Pick(16), (uint8_t)Pick(2)};
+            keys.insert(std::upper_bound(keys.begin(), keys.end(), event,
+                                         [](const InputEvent &a, const InputEvent &b) { return a.cycle < b.cycle; }),
+                        event);
+            break;
+        }
+        case 9:
+            if (!keys.empty())
+                keys.erase(keys.begin() + Pick((uint32_t)keys.size()));
+            break;
+        }
+
+        if (opcode && word + 1 < rom.size())
+        {
+            rom[word] = opcode >> 8;
+            rom[word + 1] = opcode & 0xFF;
+        }
+        if (rom.empty())
+            rom.push_back(0);
+    }
+}
+
+void Fuzzer::Minimize(FuzzInput &input, const std::function<bool(const FuzzInput &)> &stillFails)
+{
+    FuzzInput candidate = input;
+
+    for (size_t i = input.keys.size(); i-- > 0;)
+    {
+        candidate.keys.erase(candidate.keys.begin() + i);
+        if (stillFails(candidate))
+            input.keys = candidate.keys;
+        else
+            candidate.keys = input.keys;
+    }
+
+    // cut the ROM short, big steps first
+    for (size_t step = input.rom.size() / 2; step >= 1; step /= 2)
+    {
+        while (input.rom.size() > step)
+        {
+            candidate.rom.assign(input.rom.begin(), input.rom.end() - step);
+            if (!stillFails(candidate))
+                break;
+            input.rom = candidate.rom;
+        }
+    }
+    candidate.rom = input.rom;
+
+    // zero every byte that doesn't matter, whole runs of them first
+    size_t chunk = 1;
+    while (chunk * 2 < input.rom.size())
+        chunk *= 2;
+    for (; chunk >= 1; chunk /= 2)
+    {
+        for (size_t start = 0; start < input.rom.size(); start += chunk)
+        {
+            size_t end = std::min(start + chunk, input.rom.size());
+            if (std::all_of(&input.rom[start], &input.rom[0] + end, [](uint8_t byte) { return byte == 0; }))
+                continue;
+            std::fill(&candidate.rom[start], &candidate.rom[0] + end, 0);
+            if (stillFails(candidate))
+                std::fill(&input.rom[start], &input.rom[0] + end, 0);
+            else
+                std::copy(&input.rom[start], &input.rom[0] + end, &candidate.rom[start]);
+        }
+    }
+}
+
+void Fuzzer::CheckFault(const FuzzFault &fault)
+{
+    // random code wanders all over memory, one reproducer per kind of instruction is plenty
+    if (!gFound.insert((uint32_t)fault.fault << 16 | DecodeOpcode(fault.opcode).op).second)
+        return;
+
+    FuzzFinding finding;
+    finding.fault = fault.fault;
+    finding.PC = fault.PC;
+    finding.field = nullptr;
+    finding.input = gCurrent;
+
+    auto findFault = [this, &fault]() -> const FuzzFault * {
+        for (const FuzzFault &other : gRunFaults)
+        {
+            if (other.fault == fault.fault && other.PC == fault.PC)
+                return &other;
+        }
+        return nullptr;
+    };
+    // a reduced input has to fault no later than the original did
+    Minimize(finding.input, [this, &fault, &findFault](const FuzzInput &input) {
+        Execute(input, fault.cycle);
+        return findFault() != nullptr;
+    });
+
+    Execute(finding.input, fault.cycle);
+    const FuzzFault *minimized = findFault();
+    finding.opcode = minimized->opcode;
+    finding.cycle = minimized->cycle;
+    gFindings.push_back(finding);
+}
+
+void Fuzzer::CheckDivergence()
+{
+    if (gLockstep->Run(gCurrent.rom.data(), (uint32_t)gCurrent.rom.size(), gCurrent.keys, gCyclesPerRun))
+        return;
+
+    uint16_t pc = gLockstep->GetDivergence().PC;
+    if (!gFound.insert(FUZZ_DIVERGENCE << 16 | DecodeOpcode(gLockstep->GetDivergence().opcode).op).second)
+        return;
+
+    FuzzFinding finding;
+    finding.fault = Chip8::FAULT_NONE;
+    finding.PC = pc;
+    finding.input = gCurrent;
+    Minimize(finding.input, [this, pc](const FuzzInput &input) {
+        FuzzInput copy = input;
+        return !gLockstep->Run(copy.rom.data(), (uint32_t)copy.rom.size(), copy.keys, gCyclesPerRun) &&
+               gLockstep->GetDivergence().PC == pc;
+    });
+
+    gLockstep->Run(finding.input.rom.data(), (uint32_t)finding.input.rom.size(), finding.input.keys, gCyclesPerRun);
+    const LockstepDivergence &divergence = gLockstep->GetDivergence();
+    finding.opcode = divergence.opcode;
+    finding.field = divergence.field;
+    finding.cycle = divergence.cycle + 1;
+    gFindings.push_back(finding);
+}
+
+bool Fuzzer::SaveFinding(const FuzzFinding &finding, const char *directory)
+{
+    const char *kind = "divergence";
+    switch (finding.fault)
+    {
+    case Chip8::FAULT_STACK_OVERFLOW:
+        kind = "stack-overflow";
+        break;
+    case Chip8::FAULT_STACK_UNDERFLOW:
+        kind = "stack-underflow";
+        break;
+    case Chip8::FAULT_MEMORY:
+        kind = "memory";
+        break;
+    case Chip8::FAULT_PC:
+        kind = "pc";
+        break;
+    default:
+        break;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "/%s-%03X", kind, finding.PC);
+    std::string path = std::string(directory) + name;
+
+    std::ofstream outFile(path + ".ch8", std::ofstream::binary);
+    if (!outFile.is_open())
+    {
+        printf("Could not open file: %s.ch8\n", path.c_str());
+        return 1;
+    }
+    outFile.write((const char *)finding.input.rom.data(), finding.input.rom.size());
+    outFile.close();
+
+    // record the key presses by running the input once more, up to the finding
+    Chip8 chip8;
+    chip8.SetInstructionsPerTick(12);
+    std::vector<uint8_t> rom = finding.input.rom;
+    if (chip8.LoadRom(rom.data(), (uint32_t)rom.size()) != 0)
+        return 1;
+
+    InputRecording recording;
+    recording.Begin(chip8);
+    auto runTo = [&chip8](uint64_t cycle) {
+        while (chip8.GetCycleCount() < cycle)
+            chip8.RunCycles((uint32_t)(cycle - chip8.GetCycleCount()), Chip8::EVENT_NONE);
+    };
+    for (const InputEvent &event : finding.input.keys)
+    {
+        if (event.cycle >= finding.cycle)
+            break;
+        runTo(event.cycle);
+        recording.SetKeyState(chip8, event.key, event.state);
+    }
+    runTo(finding.cycle);
+    recording.End(chip8);
+
+    return recording.Save((path + ".c8in").c_str());
+}
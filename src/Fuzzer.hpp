@@ -0,0 +1,139 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef FUZZER_HPP
+#define FUZZER_HPP
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "Chip8.hpp"
+#include "InputRecording.hpp"
+#include "Lockstep.hpp"
+
+// One fuzzing input: ROM bytes and the key presses applied while it runs
+struct FuzzInput
+{
+    std::vector<uint8_t> rom;
+    // sorted by cycle
+    std::vector<InputEvent> keys;
+};
+
+// A fault raised while running an input
+struct FuzzFault
+{
+    Chip8::Fault fault;
+    // the faulting instruction, see Chip8::GetLastFaultPC
+    uint16_t PC;
+    // 0 for FAULT_PC
+    uint16_t opcode;
+    // instructions run up to and including it
+    uint64_t cycle;
+};
+
+// A fault or engine divergence the fuzzer found, with the smallest input it could reduce it to
+struct FuzzFinding
+{
+    // FAULT_NONE for a divergence
+    Chip8::Fault fault;
+    // the instruction that faulted, or the first one after which the engines differed
+    uint16_t PC;
+    uint16_t opcode;
+    // for divergences, what differed (see LockstepDivergence)
+    const char *field;
+    FuzzInput input;
+    // instructions run up to and including the one the finding is about
+    uint64_t cycle;
+};
+
+/*
+Coverage guided fuzzer for the Chip8 core.
+Inputs from the corpus are mutated (ROM bytes, opcodes, splices, key presses) and run for
+a short, fixed number of instructions on one reused Chip8 with edge coverage attached.
+Inputs that reach a new edge, or a known edge a new number of times, join the corpus.
+The first fault of each kind per kind of instruction is minimized and kept as a finding. Optionally each
+new corpus input is also run on two engines in lockstep, and divergences are findings too.
+*/
+class Fuzzer
+{
+public:
+    Fuzzer(uint64_t pSeed);
+    virtual ~Fuzzer();
+
+public:
+    // Instructions each input runs at most (default 2000)
+    void SetCyclesPerRun(uint32_t pCycles) { gCyclesPerRun = pCycles; }
+    // Check new corpus inputs on the interpreter against pEngine
+    void SetDifferential(Chip8::Engine pEngine);
+
+    // Add a ROM to the corpus as it is, without key presses
+    void AddSeed(const uint8_t *pRom, size_t pSize);
+
+    // Run pRuns mutated inputs
+    void Run(uint64_t pRuns);
+
+    /*
+    Run pInput once on the coverage machine. A fault does not end the run, the machine
+    carries on as Chip8::Fault describes. The distinct faults it raised are in GetRunFaults.
+    */
+    void Execute(const FuzzInput &pInput);
+    const std::vector<FuzzFault> &GetRunFaults() const { return gRunFaults; }
+    // Shrink pInput while pStillFails holds: drop key presses, cut the ROM short, zero bytes
+    void Minimize(FuzzInput &pInput, const std::function<bool(const FuzzInput &)> &pStillFails);
+
+    /*
+    Write a finding into pDirectory as <kind>-<PC>.ch8 plus a .c8in recording of its key
+    presses that ends where the finding shows, for Chip8Replay.
+    Returns 1 if an error occurred and 0 otherwise.
+    */
+    bool SaveFinding(const FuzzFinding &pFinding, const char *pDirectory);
+
+    const std::vector<FuzzFinding> &GetFindings() const { return gFindings; }
+    uint64_t GetRuns() const { return gRuns; }
+    size_t GetCorpusSize() const { return gCorpus.size(); }
+    // edges reached at least once
+    uint32_t GetEdgeCount() const { return gEdges; }
+    // the input being run, for crash handlers
+    const FuzzInput &GetCurrentInput() const { return gCurrent; }
+
+private:
+    // Execute for at most pCycles instructions
+    void Execute(const FuzzInput &pInput, uint64_t pCycles);
+    // Random number below pBound
+    uint32_t Pick(uint32_t pBound);
+    void Mutate(FuzzInput &pInput);
+    // Fold the last run's counters into gSeen. Returns true if any were new.
+    bool MergeCoverage();
+    // Record and minimize a fault if it is the first of its kind at its PC
+    void CheckFault(const FuzzFault &pFault);
+    // Compare engines on gCurrent and record a new divergence
+    void CheckDivergence();
+
+private:
+    Chip8 gChip8;
+    // edge counters of the current run, see Chip8::SetCoverage
+    std::vector<uint8_t> gTrace;
+    std::vector<FuzzFault> gRunFaults;
+    // per edge, the hit count classes seen so far
+    std::vector<uint8_t> gSeen;
+    uint32_t gEdges;
+
+    std::vector<FuzzInput> gCorpus;
+    FuzzInput gCurrent;
+    std::vector<FuzzFinding> gFindings;
+    // fault << 16 | Chip8Op of every finding, divergences use fault 0xFF
+    std::set<uint32_t> gFound;
+
+    uint64_t gRandom;
+    uint32_t gCyclesPerRun;
+    uint64_t gRuns;
+    std::unique_ptr<LockstepRunner> gLockstep;
+};
+
+#endif // FUZZER_HPP
@@ -0,0 +1,243 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "InputRecording.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+static const uint8_t RECORDING_MAGIC[4] = {'C', '8', 'I', 'N'};
+static const uint8_t RECORDING_VERSION = 2;
+static const size_t RECORDING_HEADER_SIZE = 4 + 1 + 4 + 8 + 4 + 1;
+// key byte that ends the event list
+static const uint8_t RECORDING_END = 0xFF;
+
+static void Put(std::vector<uint8_t> &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+static uint64_t Get(const uint8_t *&data, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)data[i] << (i * 8);
+    data += bytes;
+    return value;
+}
+
+// 7 bits per byte, low bits first, high bit set on all but the last byte
+static void PutVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+// Returns false if the varint runs past end or is longer than 64 bits
+static bool GetVarint(const uint8_t *&data, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (data == end)
+            return false;
+        uint8_t byte = *data++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+InputRecording::InputRecording() : gRomHash(0),
+                                   gSeed(0),
+                                   gInstructionsPerTick(0),
+                                   gQuirks(Chip8::QUIRK_NONE),
+                                   gEndCycle(0),
+                                   gKeys(0)
+{
+}
+
+InputRecording::~InputRecording()
+{
+}
+
+void InputRecording::Begin(Chip8 &chip8)
+{
+    gRomHash = chip8.GetRomHash();
+    gSeed = chip8.GetSeed();
+    gInstructionsPerTick = chip8.GetInstructionsPerTick();
+    gQuirks = chip8.GetQuirks();
+    gEndCycle = chip8.GetCycleCount();
+    gKeys = 0;
+    gEvents.clear();
+}
+
+void InputRecording::SetKeyState(Chip8 &chip8, uint8_t keyCode, uint8_t state)
+{
+    chip8.SetKeyState(keyCode, state);
+
+    uint16_t bit = 1 << (keyCode & 0xF);
+    if (((gKeys & bit) != 0) == (state != 0))
+        return;
+    gKeys ^= bit;
+
+    InputEvent event = {chip8.GetCycleCount(), (uint8_t)(keyCode & 0xF), (uint8_t)(state ? 1 : 0)};
+    gEvents.push_back(event);
+    gEndCycle = event.cycle;
+}
+
+void InputRecording::End(Chip8 &chip8)
+{
+    gEndCycle = chip8.GetCycleCount();
+}
+
+bool InputRecording::Replay(Chip8 &chip8, const std::function<void(Chip8 &)> &onFrame) const
+{
+    if (chip8.GetRomHash() != gRomHash || gInstructionsPerTick == 0)
+        return false;
+
+    chip8.SetSeed(gSeed);
+    chip8.SetInstructionsPerTick(gInstructionsPerTick);
+    chip8.SetQuirks(gQuirks);
+
+    // RunCycles takes 32-bit counts, so long gaps take several calls
+    auto runTo = [&chip8, &onFrame](uint64_t cycle) {
+        while (chip8.GetCycleCount() < cycle)
+        {
+            uint64_t remaining = cycle - chip8.GetCycleCount();
+            chip8.RunCycles(remaining > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)remaining,
+                            onFrame ? Chip8::EVENT_FRAME : Chip8::EVENT_NONE);
+            if (onFrame && (chip8.GetEvents() & Chip8::EVENT_FRAME))
+                onFrame(chip8);
+        }
+    };
+
+    for (const InputEvent &event : gEvents)
+    {
+        runTo(event.cycle);
+        chip8.SetKeyState(event.key, event.state);
+    }
+    runTo(gEndCycle);
+
+    return true;
+}
+
+void InputRecording::Encode(std::vector<uint8_t> &out) const
+{
+    out.clear();
+    for (uint8_t byte : RECORDING_MAGIC)
+        out.push_back(byte);
+    Put(out, RECORDING_VERSION, 1);
+    Put(out, gRomHash, 4);
+    Put(out, gSeed, 8);
+    Put(out, gInstructionsPerTick, 4);
+    Put(out, gQuirks, 1);
+
+    uint64_t cycle = 0;
+    for (const InputEvent &event : gEvents)
+    {
+        PutVarint(out, event.cycle - cycle);
+        out.push_back(event.key | event.state << 7);
+        cycle = event.cycle;
+    }
+    PutVarint(out, gEndCycle - cycle);
+    out.push_back(RECORDING_END);
+}
+
+bool InputRecording::Decode(const uint8_t *data, size_t size)
+{
+    const uint8_t *end = data + size;
+    if (size < RECORDING_HEADER_SIZE || memcmp(data, RECORDING_MAGIC, 4) != 0)
+        return false;
+    data += 4;
+    if (Get(data, 1) != RECORDING_VERSION)
+        return false;
+    uint32_t romHash = (uint32_t)Get(data, 4);
+    uint64_t seed = Get(data, 8);
+    uint32_t instructionsPerTick = (uint32_t)Get(data, 4);
+    uint8_t quirks = (uint8_t)Get(data, 1);
+    if (quirks >= Chip8::QUIRK_COMBINATIONS)
+        return false;
+
+    std::vector<InputEvent> events;
+    uint64_t cycle = 0;
+    uint16_t keys = 0;
+    while (true)
+    {
+        uint64_t delta;
+        if (!GetVarint(data, end, delta) || data == end)
+            return false;
+        cycle += delta;
+        uint8_t key = *data++;
+        if (key == RECORDING_END)
+            break;
+        if (key & 0x70)
+            return false;
+
+        InputEvent event = {cycle, (uint8_t)(key & 0xF), (uint8_t)(key >> 7)};
+        events.push_back(event);
+        keys ^= 1 << event.key;
+    }
+
+    gRomHash = romHash;
+    gSeed = seed;
+    gInstructionsPerTick = instructionsPerTick;
+    gQuirks = quirks;
+    gEndCycle = cycle;
+    gKeys = keys;
+    gEvents.swap(events);
+    return true;
+}
+
+bool InputRecording::Save(const char *fileName) const
+{
+    std::vector<uint8_t> data;
+    Encode(data);
+
+    std::ofstream outFile(fileName, std::ofstream::binary);
+    if (!outFile.is_open())
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 1;
+    }
+    outFile.write((const char *)data.data(), data.size());
+    if (!outFile)
+    {
+        printf("Could not write file: %s\n", fileName);
+        return 1;
+    }
+
+    return 0;
+}
+
+bool InputRecording::Load(const char *fileName)
+{
+    std::ifstream inFile(fileName, std::ifstream::binary | std::ifstream::ate);
+    if (!inFile.is_open())
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 1;
+    }
+
+    std::streampos fileSize = inFile.tellg();
+    inFile.seekg(0);
+    std::vector<uint8_t> data((size_t)fileSize);
+    inFile.read((char *)data.data(), fileSize);
+
+    if (!inFile || !Decode(data.data(), data.size()))
+    {
+        printf("Not a valid input recording: %s\n", fileName);
+        return 1;
+    }
+
+    return 0;
+}
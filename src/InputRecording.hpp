@@ -0,0 +1,84 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef INPUT_RECORDING_HPP
+#define INPUT_RECORDING_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+#include "Chip8.hpp"
+
+// One key transition, at the cycle count it was applied before
+struct InputEvent
+{
+    uint64_t cycle;
+    uint8_t key;
+    uint8_t state;
+};
+
+/*
+Key transitions of a session stamped with the emulated cycle count, so a run can be
+reproduced exactly on a headless Chip8 at full speed. Needs virtual timers
+(SetInstructionsPerTick != 0), since wall-clock timers are not reproducible.
+*/
+class InputRecording
+{
+public:
+    InputRecording();
+    virtual ~InputRecording();
+
+public:
+    // Start recording pChip8, which must have just loaded its ROM
+    void Begin(Chip8 &pChip8);
+    // Apply a key transition to pChip8 and log it. Repeats of the current state are not logged.
+    void SetKeyState(Chip8 &pChip8, uint8_t pKeyCode, uint8_t pState);
+    // Mark the end of the session at pChip8's current cycle
+    void End(Chip8 &pChip8);
+
+    /*
+    Run pChip8, which must have just loaded the recorded ROM, through the session.
+    Applies the recorded seed, timer rate and quirks, then runs to the end cycle in as few
+    RunCycles calls as the events allow. With pOnFrame, it also stops at every 60hz frame
+    to call it, such as to capture the display or the sound.
+    Returns false without running if the ROM differs or the recording has no timer rate.
+    */
+    bool Replay(Chip8 &pChip8, const std::function<void(Chip8 &)> &pOnFrame = nullptr) const;
+
+    /*
+    File format, all values little endian:
+        "C8IN", version (1 byte), ROM image hash (4), seed (8), instructions per tick (4), quirks (1)
+        per event: cycles since the previous event as a LEB128 varint, key | state << 7 (1)
+        cycles to the end as a varint, 0xFF
+    */
+    void Encode(std::vector<uint8_t> &pOut) const;
+    // Returns false and leaves the recording untouched if the data is invalid
+    bool Decode(const uint8_t *pData, size_t pSize);
+
+    // Returns 1 if an error occurred and 0 otherwise
+    bool Save(const char *pFileName) const;
+    bool Load(const char *pFileName);
+
+    const std::vector<InputEvent> &GetEvents() const { return gEvents; }
+    uint64_t GetEndCycle() const { return gEndCycle; }
+    uint32_t GetRomHash() const { return gRomHash; }
+    uint64_t GetSeed() const { return gSeed; }
+    uint32_t GetInstructionsPerTick() const { return gInstructionsPerTick; }
+    uint8_t GetQuirks() const { return gQuirks; }
+
+private:
+    uint32_t gRomHash;
+    uint64_t gSeed;
+    uint32_t gInstructionsPerTick;
+    uint8_t gQuirks;
+    uint64_t gEndCycle;
+    // key bitmask as recorded so far, to drop repeats
+    uint16_t gKeys;
+    std::vector<InputEvent> gEvents;
+};
+
+#endif // INPUT_RECORDING_HPP
@@ -0,0 +1,556 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "JitCache.hpp"
+#include "Chip8Decode.hpp"
+#include <cstring>
+
+#ifdef CHIP8_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+// size of the executable buffer for one instance
+#define JIT_BUFFER_SIZE (256 * 1024)
+// upper bound on the code emitted for one run, each op is at most 48 bytes plus 18 for the limit check
+#define JIT_MAX_RUN_BYTES (JIT_MAX_OPS * 66 + 256)
+
+bool JitCache::IsSupported()
+{
+#ifdef CHIP8_JIT_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+JitCache::JitCache() : gCodeBuffer(nullptr),
+                       gCodeSize(0),
+                       gCodeUsed(0)
+{
+#ifdef CHIP8_JIT_SUPPORTED
+    void *buffer = mmap(nullptr, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer != MAP_FAILED)
+    {
+        gCodeBuffer = (uint8_t *)buffer;
+        gCodeSize = JIT_BUFFER_SIZE;
+    }
+#endif
+    Flush();
+}
+
+JitCache::~JitCache()
+{
+#ifdef CHIP8_JIT_SUPPORTED
+    if (gCodeBuffer)
+        munmap(gCodeBuffer, gCodeSize);
+#endif
+}
+
+void JitCache::Flush()
+{
+    for (int i = 0; i < 4096; i++)
+        gRuns[i].code = nullptr;
+    memset(gCompiled, 0, sizeof(gCompiled));
+    memset(gCodeMap, 0, sizeof(gCodeMap));
+    gCodeUsed = 0;
+}
+
+#ifndef CHIP8_JIT_SUPPORTED
+
+void JitCache::Compile(uint16_t pc, const uint8_t *memory)
+{
+    gCompiled[pc] = 1;
+}
+
+#else
+
+// x86-64 register numbers
+enum HostReg
+{
+    RAX,
+    RCX,
+    RDX,
+    RBX,
+    RSP,
+    RBP,
+    RSI,
+    RDI,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15
+};
+
+// condition codes for Jcc and SETcc
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_A 0x7
+
+// V registers used by a run are kept in these. RAX and RCX are scratch, RDX holds I and
+// RSI the instruction limit, with the pointer to I saved on the stack.
+static const uint8_t gVRegPool[] = {R8, R9, R10, R11, RBX, RBP, R12, R13, R14, R15};
+#define V_REG_POOL_SIZE (sizeof(gVRegPool) / sizeof(gVRegPool[0]))
+
+static bool IsCalleeSaved(uint8_t reg)
+{
+    return reg == RBX || reg == RBP || reg >= R12;
+}
+
+/*
+Minimal x86-64 encoder for the handful of instructions the JIT needs.
+All arithmetic is 32 bit. Every V register lives zero-extended in a 32 bit
+host register, so results are masked back to 8 bits where they can overflow.
+*/
+class Emitter
+{
+public:
+    Emitter(uint8_t *pOut) : gOut(pOut), gPos(0) {}
+
+    size_t Position() { return gPos; }
+
+    void Byte(uint8_t value) { gOut[gPos++] = value; }
+    void Dword(uint32_t value)
+    {
+        memcpy(gOut + gPos, &value, 4);
+        gPos += 4;
+    }
+
+    // REX prefix, only emitted if needed (or forced for byte access to SPL..DIL and R8B..R15B)
+    void Rex(int reg, int rm, bool force = false)
+    {
+        uint8_t rex = 0x40 | ((reg >> 3) & 1) << 2 | ((rm >> 3) & 1);
+        if (rex != 0x40 || force)
+            Byte(rex);
+    }
+    void ModRM(int mod, int reg, int rm) { Byte(mod << 6 | (reg & 7) << 3 | (rm & 7)); }
+
+    // opcode r/m32, r32 - 0x89 mov, 0x01 add, 0x09 or, 0x21 and, 0x31 xor, 0x29 sub, 0x39 cmp
+    void RegReg(uint8_t opcode, int dst, int src)
+    {
+        Rex(src, dst);
+        Byte(opcode);
+        ModRM(3, src, dst);
+    }
+    void Mov(int dst, int src) { RegReg(0x89, dst, src); }
+    void MovImm(int dst, uint32_t imm)
+    {
+        Rex(0, dst);
+        Byte(0xB8 + (dst & 7));
+        Dword(imm);
+    }
+    // 81 /ext - 0 add, 4 and, 7 cmp
+    void RegImm(int ext, int dst, uint32_t imm)
+    {
+        Rex(0, dst);
+        Byte(0x81);
+        ModRM(3, ext, dst);
+        Dword(imm);
+    }
+    // C1 /ext - 4 shl, 5 shr
+    void Shift(int ext, int dst, uint8_t count)
+    {
+        Rex(0, dst);
+        Byte(0xC1);
+        ModRM(3, ext, dst);
+        Byte(count);
+    }
+    void SetCC(uint8_t cc, int dst)
+    {
+        Rex(0, dst, dst >= RSP);
+        Byte(0x0F);
+        Byte(0x90 + cc);
+        ModRM(3, 0, dst);
+    }
+    void ImulImm8(int dst, int src, int8_t imm)
+    {
+        Rex(dst, src);
+        Byte(0x6B);
+        ModRM(3, dst, src);
+        Byte((uint8_t)imm);
+    }
+    // movzx dst, byte [base + disp]
+    void LoadByte(int dst, int base, uint8_t disp)
+    {
+        Rex(dst, base);
+        Byte(0x0F);
+        Byte(0xB6);
+        ModRM(1, dst, base);
+        Byte(disp);
+    }
+    // mov byte [base + disp], src
+    void StoreByte(int base, uint8_t disp, int src)
+    {
+        Rex(src, base, true);
+        Byte(0x88);
+        ModRM(1, src, base);
+        Byte(disp);
+    }
+    // movzx dst, word [base]
+    void LoadWord(int dst, int base)
+    {
+        Rex(dst, base);
+        Byte(0x0F);
+        Byte(0xB7);
+        ModRM(0, dst, base);
+    }
+    // mov word [base], src
+    void StoreWord(int base, int src)
+    {
+        Byte(0x66);
+        Rex(src, base);
+        Byte(0x89);
+        ModRM(0, src, base);
+    }
+    void Push(int reg)
+    {
+        Rex(0, reg);
+        Byte(0x50 + (reg & 7));
+    }
+    void Pop(int reg)
+    {
+        Rex(0, reg);
+        Byte(0x58 + (reg & 7));
+    }
+    void Ret() { Byte(0xC3); }
+    void JccShort(uint8_t cc, int8_t offset)
+    {
+        Byte(0x70 + cc);
+        Byte((uint8_t)offset);
+    }
+    // jmp rel32 with the target patched in later. Returns where the offset goes.
+    size_t Jmp()
+    {
+        Byte(0xE9);
+        size_t at = gPos;
+        Dword(0);
+        return at;
+    }
+    void PatchJmp(size_t at, size_t target)
+    {
+        int32_t offset = (int32_t)(target - (at + 4));
+        memcpy(gOut + at, &offset, 4);
+    }
+
+private:
+    uint8_t *gOut;
+    size_t gPos;
+};
+
+// Ops the JIT can translate
+static bool IsCompilable(uint8_t op)
+{
+    switch (op)
+    {
+    case OP_JMP_1NNN:
+    case OP_SKIP_3XNN:
+    case OP_SKIP_4XNN:
+    case OP_SKIP_5XY0:
+    case OP_SET_6XNN:
+    case OP_ADD_7XNN:
+    case OP_SETXY_8XY0:
+    case OP_OR_8XY1:
+    case OP_AND_8XY2:
+    case OP_XOR_8XY3:
+    case OP_ADD_8XY4:
+    case OP_SUB_8XY5:
+    case OP_SHR_8XY6:
+    case OP_SUB2_8XY7:
+    case OP_SHL_8XYE:
+    case OP_SKIP_9XY0:
+    case OP_SETI_ANNN:
+    case OP_ADDI_FX1E:
+    case OP_FONT_FX29:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// V registers an op reads or writes, one bit per register
+static uint16_t RegistersUsed(const DecodedOp &op)
+{
+    uint8_t x = op.xy & 0xF;
+    uint8_t y = op.xy >> 4;
+
+    switch (op.op)
+    {
+    case OP_JMP_1NNN:
+    case OP_SETI_ANNN:
+        return 0;
+    case OP_SKIP_3XNN:
+    case OP_SKIP_4XNN:
+    case OP_SET_6XNN:
+    case OP_ADD_7XNN:
+    case OP_ADDI_FX1E:
+    case OP_FONT_FX29:
+        return 1 << x;
+    case OP_SKIP_5XY0:
+    case OP_SKIP_9XY0:
+    case OP_SETXY_8XY0:
+    case OP_OR_8XY1:
+    case OP_AND_8XY2:
+    case OP_XOR_8XY3:
+        return 1 << x | 1 << y;
+    default:
+        // arithmetic and shifts also write VF
+        return 1 << x | 1 << y | 1 << 0xF;
+    }
+}
+
+static int CountBits(uint16_t bits)
+{
+    int count = 0;
+    for (; bits; bits &= bits - 1)
+        count++;
+    return count;
+}
+
+void JitCache::Compile(uint16_t pc, const uint8_t *memory)
+{
+    gCompiled[pc] = 1;
+    if (!gCodeBuffer)
+        return;
+
+    // collect the run
+    const DecodedOp *table = GetDecodeTable();
+    DecodedOp ops[JIT_MAX_OPS];
+    int count = 0;
+    uint16_t used = 0;
+    uint16_t addr = pc;
+
+    while (count < JIT_MAX_OPS && addr < 0xFFF)
+    {
+        DecodedOp op = table[memory[addr] << 8 | memory[addr + 1]];
+        if (!IsCompilable(op.op))
+            break;
+        if (CountBits(used | RegistersUsed(op)) > (int)V_REG_POOL_SIZE)
+            break;
+
+        used |= RegistersUsed(op);
+        ops[count++] = op;
+        addr += 2;
+
+        if (op.op == OP_JMP_1NNN)
+            break;
+    }
+
+    // a single instruction is cheaper to interpret than to call
+    if (count < 2)
+        return;
+
+    if (gCodeUsed + JIT_MAX_RUN_BYTES > gCodeSize)
+    {
+        Flush();
+        gCompiled[pc] = 1;
+    }
+
+    for (uint16_t a = pc; a < addr; a++)
+        gCodeMap[a] = 1;
+
+    // assign host registers
+    int8_t hostReg[16];
+    int poolIndex = 0;
+    for (int v = 0; v < 16; v++)
+        hostReg[v] = (used & (1 << v)) ? gVRegPool[poolIndex++] : -1;
+
+    mprotect(gCodeBuffer, gCodeSize, PROT_READ | PROT_WRITE);
+
+    uint8_t *start = gCodeBuffer + gCodeUsed;
+    Emitter e(start);
+
+    // prologue: save callee-saved registers we use, load V and I, move the limit to RSI
+    for (int i = 0; i < poolIndex; i++)
+    {
+        if (IsCalleeSaved(gVRegPool[i]))
+            e.Push(gVRegPool[i]);
+    }
+    for (int v = 0; v < 16; v++)
+    {
+        if (hostReg[v] >= 0)
+            e.LoadByte(hostReg[v], RDI, v);
+    }
+    e.Push(RSI);
+    e.Mov(RCX, RDX);
+    e.LoadWord(RDX, RSI);
+    e.Mov(RSI, RCX);
+
+    // a limit check before every op but the first and a skip in every op
+    size_t exits[JIT_MAX_OPS * 2];
+    int exitCount = 0;
+    bool jumped = false;
+    uint16_t opAddr = pc;
+
+    for (int i = 0; i < count; i++, opAddr += 2)
+    {
+        const DecodedOp &op = ops[i];
+        int vx = hostReg[op.xy & 0xF];
+        int vy = hostReg[op.xy >> 4];
+        int vf = hostReg[0xF];
+
+        // stop before this op once the limit is used up. 10 bytes to skip: mov eax, imm32 + jmp rel32
+        if (i > 0)
+        {
+            e.RegImm(7, RSI, i);
+            e.JccShort(CC_A, 10);
+            e.MovImm(RAX, (uint32_t)i << 16 | opAddr);
+            exits[exitCount++] = e.Jmp();
+        }
+
+        // return (executed << 16 | PC) if the skip was taken
+        uint32_t skipResult = (uint32_t)(i + 1) << 16 | (uint16_t)(opAddr + 4);
+
+        switch (op.op)
+        {
+        case OP_JMP_1NNN:
+            e.MovImm(RAX, (uint32_t)(i + 1) << 16 | op.imm);
+            jumped = true;
+            break;
+        case OP_SKIP_3XNN:
+            e.RegImm(7, vx, op.imm);
+            e.JccShort(CC_NE, 10);
+            e.MovImm(RAX, skipResult);
+            exits[exitCount++] = e.Jmp();
+            break;
+        case OP_SKIP_4XNN:
+            e.RegImm(7, vx, op.imm);
+            e.JccShort(CC_E, 10);
+            e.MovImm(RAX, skipResult);
+            exits[exitCount++] = e.Jmp();
+            break;
+        case OP_SKIP_5XY0:
+            e.RegReg(0x39, vx, vy);
+            e.JccShort(CC_NE, 10);
+            e.MovImm(RAX, skipResult);
+            exits[exitCount++] = e.Jmp();
+            break;
+        case OP_SKIP_9XY0:
+            e.RegReg(0x39, vx, vy);
+            e.JccShort(CC_E, 10);
+            e.MovImm(RAX, skipResult);
+            exits[exitCount++] = e.Jmp();
+            break;
+        case OP_SET_6XNN:
+            e.MovImm(vx, op.imm);
+            break;
+        case OP_ADD_7XNN:
+            e.RegImm(0, vx, op.imm);
+            e.RegImm(4, vx, 0xFF);
+            break;
+        case OP_SETXY_8XY0:
+            e.Mov(vx, vy);
+            break;
+        case OP_OR_8XY1:
+            e.RegReg(0x09, vx, vy);
+            break;
+        case OP_AND_8XY2:
+            e.RegReg(0x21, vx, vy);
+            break;
+        case OP_XOR_8XY3:
+            e.RegReg(0x31, vx, vy);
+            break;
+
+        // the flag ops clear VF first and write V[x] last, exactly like the interpreter,
+        // so they behave the same when x or y is F
+        case OP_ADD_8XY4:
+            e.MovImm(vf, 0);
+            e.Mov(RAX, vx);
+            e.RegReg(0x01, RAX, vy);
+            e.Mov(RCX, RAX);
+            e.Shift(5, RCX, 8);
+            e.Mov(vf, RCX);
+            e.RegImm(4, RAX, 0xFF);
+            e.Mov(vx, RAX);
+            break;
+        case OP_SUB_8XY5:
+            e.MovImm(vf, 0);
+            e.MovImm(RCX, 0);
+            e.RegReg(0x39, vx, vy);
+            e.SetCC(CC_A, RCX);
+            e.Mov(vf, RCX);
+            e.Mov(RAX, vx);
+            e.RegReg(0x29, RAX, vy);
+            e.RegImm(4, RAX, 0xFF);
+            e.Mov(vx, RAX);
+            break;
+        case OP_SUB2_8XY7:
+            e.MovImm(vf, 0);
+            e.MovImm(RCX, 0);
+            e.RegReg(0x39, vy, vx);
+            e.SetCC(CC_A, RCX);
+            e.Mov(vf, RCX);
+            e.Mov(RAX, vy);
+            e.RegReg(0x29, RAX, vx);
+            e.RegImm(4, RAX, 0xFF);
+            e.Mov(vx, RAX);
+            break;
+        case OP_SHR_8XY6:
+            e.MovImm(vf, 0);
+            e.Mov(RCX, vx);
+            e.RegImm(4, RCX, 1);
+            e.Mov(vf, RCX);
+            e.Shift(5, vx, 1);
+            break;
+        case OP_SHL_8XYE:
+            e.MovImm(vf, 0);
+            e.Mov(RCX, vx);
+            e.Shift(5, RCX, 7);
+            e.Mov(vf, RCX);
+            e.Shift(4, vx, 1);
+            e.RegImm(4, vx, 0xFF);
+            break;
+
+        case OP_SETI_ANNN:
+            e.MovImm(RDX, op.imm);
+            break;
+        case OP_ADDI_FX1E:
+            e.RegReg(0x01, RDX, vx);
+            e.RegImm(4, RDX, 0xFFFF);
+            break;
+        case OP_FONT_FX29:
+            e.ImulImm8(RDX, vx, 5);
+            e.RegImm(0, RDX, 0x50);
+            break;
+        }
+    }
+
+    // fell off the end of the run
+    if (!jumped)
+        e.MovImm(RAX, (uint32_t)count << 16 | opAddr);
+
+    // epilogue: write back V and I, restore registers
+    size_t epilogue = e.Position();
+    for (int i = 0; i < exitCount; i++)
+        e.PatchJmp(exits[i], epilogue);
+
+    for (int v = 0; v < 16; v++)
+    {
+        if (hostReg[v] >= 0)
+            e.StoreByte(RDI, v, hostReg[v]);
+    }
+    e.Pop(RSI);
+    e.StoreWord(RSI, RDX);
+    for (int i = poolIndex - 1; i >= 0; i--)
+    {
+        if (IsCalleeSaved(gVRegPool[i]))
+            e.Pop(gVRegPool[i]);
+    }
+    e.Ret();
+
+    gCodeUsed += e.Position();
+    // keep the next run 16 byte aligned
+    gCodeUsed = (gCodeUsed + 15) & ~(size_t)15;
+
+    mprotect(gCodeBuffer, gCodeSize, PROT_READ | PROT_EXEC);
+
+    gRuns[pc].code = (JitFunction)start;
+    gRuns[pc].length = (uint16_t)count;
+}
+
+#endif // CHIP8_JIT_SUPPORTED
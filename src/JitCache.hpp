@@ -0,0 +1,100 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef JIT_CACHE_HPP
+#define JIT_CACHE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The JIT emits x86-64 code for the System V calling convention and needs mmap
+#if defined(__x86_64__) && !defined(_WIN32)
+#define CHIP8_JIT_SUPPORTED
+#endif
+
+// Longest run of instructions compiled into one native function
+#define JIT_MAX_OPS 64
+
+/*
+Native code for a run of ALU instructions.
+Takes pointers to V[16] and I and the most instructions to execute (at least 1), and
+returns the number of instructions executed in the high 16 bits and the new PC in the
+low 16 bits. Stopping at pLimit lets a run be entered with less budget or time to the
+next timer tick left than its length.
+*/
+typedef uint32_t (*JitFunction)(uint8_t *pV, uint16_t *pI, uint32_t pLimit);
+
+struct JitRun
+{
+    JitFunction code;
+    // instructions in the run if no skip or limit leaves it early
+    uint16_t length;
+};
+
+/*
+Compiles runs of CHIP-8 instructions starting at a given PC into x86-64 code.
+Only register and I arithmetic, skips on register values and jumps are compiled:
+6XNN, 7XNN, 8XY*, ANNN, FX1E, FX29, 3XNN, 4XNN, 5XY0, 9XY0 and 1NNN.
+Everything else (draw, keys, timers, memory, calls) is left to the interpreter.
+Within a run the V registers and I are kept in host registers, and the PC is
+known at compile time.
+Like BlockCache, memory covered by compiled code is marked so writes to it
+flush the cache.
+*/
+class JitCache
+{
+public:
+    JitCache();
+    virtual ~JitCache();
+
+public:
+    // Returns false if this build or host can't run generated code
+    static bool IsSupported();
+
+    // Get the compiled run starting at pPC, or nullptr if the instruction there can't be compiled
+    const JitRun *Lookup(uint16_t pPC, const uint8_t *pMemory)
+    {
+        if (pPC >= 4096)
+            return nullptr;
+        if (!gCompiled[pPC])
+            Compile(pPC, pMemory);
+        return gRuns[pPC].code ? &gRuns[pPC] : nullptr;
+    }
+
+    // Must be called after the core writes pLength bytes at pAddress
+    void Invalidate(uint16_t pAddress, uint16_t pLength)
+    {
+        for (uint32_t i = 0; i < pLength; i++)
+        {
+            if (gCodeMap[(pAddress + i) & 0xFFF])
+            {
+                Flush();
+                return;
+            }
+        }
+    }
+
+    // Drop all generated code
+    void Flush();
+
+private:
+    void Compile(uint16_t pPC, const uint8_t *pMemory);
+
+private:
+    // run for each start address, code is nullptr if nothing could be compiled there
+    JitRun gRuns[4096];
+    // non-zero once Compile has been tried for an address
+    uint8_t gCompiled[4096];
+    // non-zero for every byte of memory read by compiled code
+    uint8_t gCodeMap[4096];
+
+    // executable buffer and how much of it is used
+    uint8_t *gCodeBuffer;
+    size_t gCodeSize;
+    size_t gCodeUsed;
+};
+
+#endif // JIT_CACHE_HPP
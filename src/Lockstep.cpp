@@ -0,0 +1,158 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "Lockstep.hpp"
+#include <cstring>
+
+LockstepRunner::LockstepRunner(Chip8::Engine reference, Chip8::Engine candidate) : gInterval(1000),
+                                                                                   gDivergence()
+{
+    gReference.SetEngine(reference);
+    gCandidate.SetEngine(candidate);
+    SetInstructionsPerTick(12);
+}
+
+LockstepRunner::~LockstepRunner()
+{
+}
+
+void LockstepRunner::SetInstructionsPerTick(uint32_t instructionsPerTick)
+{
+    gReference.SetInstructionsPerTick(instructionsPerTick);
+    gCandidate.SetInstructionsPerTick(instructionsPerTick);
+}
+
+void LockstepRunner::SetSeed(uint64_t seed)
+{
+    gReference.SetSeed(seed);
+    gCandidate.SetSeed(seed);
+}
+
+void LockstepRunner::SetQuirks(uint8_t quirks)
+{
+    gReference.SetQuirks(quirks);
+    gCandidate.SetQuirks(quirks);
+}
+
+bool LockstepRunner::Run(uint8_t *rom, uint32_t romSize, const std::vector<InputEvent> &events, uint64_t cycles)
+{
+    gDivergence = LockstepDivergence();
+    if (gReference.LoadRom(rom, romSize) != 0 || gCandidate.LoadRom(rom, romSize) != 0)
+    {
+        gDivergence.field = "load";
+        return false;
+    }
+
+    size_t nextEvent = 0;
+    while (gReference.GetCycleCount() < cycles)
+    {
+        uint64_t cycle = gReference.GetCycleCount();
+        for (; nextEvent < events.size() && events[nextEvent].cycle <= cycle; nextEvent++)
+        {
+            gReference.SetKeyState(events[nextEvent].key, events[nextEvent].state);
+            gCandidate.SetKeyState(events[nextEvent].key, events[nextEvent].state);
+        }
+
+        // compare at every interval and before every key change
+        uint64_t end = cycle + gInterval;
+        if (end > cycles)
+            end = cycles;
+        if (nextEvent < events.size() && events[nextEvent].cycle < end)
+            end = events[nextEvent].cycle;
+
+        gReference.Capture(gReferenceCheckpoint);
+        gCandidate.Capture(gCandidateCheckpoint);
+        Advance((uint32_t)(end - cycle));
+        if (Compare())
+        {
+            Bisect((uint32_t)(end - cycle));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool LockstepRunner::Run(uint8_t *rom, uint32_t romSize, const InputRecording &recording)
+{
+    SetSeed(recording.GetSeed());
+    SetInstructionsPerTick(recording.GetInstructionsPerTick());
+    SetQuirks(recording.GetQuirks());
+    return Run(rom, romSize, recording.GetEvents(), recording.GetEndCycle());
+}
+
+void LockstepRunner::Advance(uint32_t cycles)
+{
+    // RunCycles takes 32-bit counts and may return early, so run each machine up to the same cycle
+    uint64_t end = gReference.GetCycleCount() + cycles;
+    while (gReference.GetCycleCount() < end)
+        gReference.RunCycles((uint32_t)(end - gReference.GetCycleCount()), Chip8::EVENT_NONE);
+    end = gCandidate.GetCycleCount() + cycles;
+    while (gCandidate.GetCycleCount() < end)
+        gCandidate.RunCycles((uint32_t)(end - gCandidate.GetCycleCount()), Chip8::EVENT_NONE);
+}
+
+const char *LockstepRunner::Compare()
+{
+    StateDigest &a = gDivergence.reference;
+    StateDigest &b = gDivergence.candidate;
+    gReference.GetDigest(a);
+    gCandidate.GetDigest(b);
+
+    if (a.PC != b.PC)
+        return "PC";
+    if (a.I != b.I)
+        return "I";
+    if (a.sp != b.sp)
+        return "sp";
+    if (memcmp(a.V, b.V, sizeof(a.V)) != 0)
+        return "V";
+    if (memcmp(a.stack, b.stack, sizeof(a.stack)) != 0)
+        return "stack";
+    if (a.delay != b.delay || a.sound != b.sound)
+        return "timers";
+    if (a.randomState != b.randomState)
+        return "random";
+    if (a.trapCount != b.trapCount)
+        return "traps";
+    if (a.memoryHash != b.memoryHash)
+        return "memory";
+    if (a.displayHash != b.displayHash)
+        return "display";
+    return nullptr;
+}
+
+void LockstepRunner::Bisect(uint32_t cycles)
+{
+    // the machines match after good instructions and differ after bad ones
+    uint32_t good = 0;
+    uint32_t bad = cycles;
+    while (bad - good > 1)
+    {
+        uint32_t middle = good + (bad - good) / 2;
+        gReference.Restore(gReferenceCheckpoint);
+        gCandidate.Restore(gCandidateCheckpoint);
+        Advance(middle);
+        if (Compare())
+            bad = middle;
+        else
+            good = middle;
+    }
+
+    gReference.Restore(gReferenceCheckpoint);
+    gCandidate.Restore(gCandidateCheckpoint);
+    Advance(good);
+    const uint8_t *memory = gReference.GetMemory();
+    gDivergence.cycle = gReference.GetCycleCount();
+    StateDigest digest;
+    gReference.GetDigest(digest);
+    gDivergence.PC = digest.PC;
+    uint32_t mask = gReference.GetMemorySize() - 1;
+    gDivergence.opcode = memory[digest.PC & mask] << 8 | memory[(digest.PC + 1) & mask];
+
+    Advance(1);
+    gDivergence.field = Compare();
+}
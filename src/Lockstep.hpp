@@ -0,0 +1,88 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef LOCKSTEP_HPP
+#define LOCKSTEP_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "Chip8.hpp"
+#include "InputRecording.hpp"
+
+// Where two machines first disagreed
+struct LockstepDivergence
+{
+    // instructions both ran before the one that made them differ
+    uint64_t cycle;
+    // that instruction, as the reference saw it
+    uint16_t PC;
+    uint16_t opcode;
+    // first part of the state that differs afterwards: "PC", "I", "sp", "V", "stack",
+    // "timers", "random", "traps", "memory" or "display"
+    const char *field;
+    StateDigest reference;
+    StateDigest candidate;
+};
+
+/*
+Runs the same ROM and key presses on two Chip8s, normally with different engines,
+and compares their state (see Chip8::GetDigest) every few instructions.
+When a comparison fails, both machines go back to the last matching point and the
+run is bisected down to the first instruction after which they differ.
+Timers run on virtual time so both machines see the same ticks.
+*/
+class LockstepRunner
+{
+public:
+    LockstepRunner(Chip8::Engine pReference, Chip8::Engine pCandidate);
+    virtual ~LockstepRunner();
+
+public:
+    // Instructions between comparisons (default 1000). Smaller catches divergence sooner, larger runs faster.
+    void SetInterval(uint32_t pInterval) { gInterval = pInterval ? pInterval : 1; }
+    // Applied to both machines. pInstructionsPerTick must not be 0 (default 12).
+    void SetInstructionsPerTick(uint32_t pInstructionsPerTick);
+    void SetSeed(uint64_t pSeed);
+    // Chip8::Quirk flags for both machines (default none)
+    void SetQuirks(uint8_t pQuirks);
+
+    /*
+    Load pRom into both machines and run pCycles instructions, applying each of pEvents
+    (sorted by cycle) before the instruction at its cycle.
+    Returns true if the machines agreed throughout, otherwise GetDivergence says where
+    they split. A ROM that does not fit fails with field "load".
+    */
+    bool Run(uint8_t *pRom, uint32_t pRomSize, const std::vector<InputEvent> &pEvents, uint64_t pCycles);
+    // Run with a recording's key presses, seed, timer rate and quirks, up to its end
+    bool Run(uint8_t *pRom, uint32_t pRomSize, const InputRecording &pRecording);
+
+    const LockstepDivergence &GetDivergence() const { return gDivergence; }
+
+    // The machines themselves, for settings the runner does not manage
+    Chip8 &GetReference() { return gReference; }
+    Chip8 &GetCandidate() { return gCandidate; }
+
+private:
+    // Run pCycles instructions on both machines
+    void Advance(uint32_t pCycles);
+    // First field that differs between the machines' digests, or nullptr
+    const char *Compare();
+    // Find the first bad instruction among the pCycles run since the checkpoint
+    void Bisect(uint32_t pCycles);
+
+private:
+    Chip8 gReference;
+    Chip8 gCandidate;
+    uint32_t gInterval;
+
+    // both machines as of the last matching comparison
+    Snapshot gReferenceCheckpoint;
+    Snapshot gCandidateCheckpoint;
+
+    LockstepDivergence gDivergence;
+};
+
+#endif // LOCKSTEP_HPP
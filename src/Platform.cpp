@@ -1,19 +1,45 @@
 #include <SDL.h>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
 #include "Platform.hpp"
+#include "FrameConvert.hpp"
+
+// Audio is asked for in buffers of AUDIO_DEVICE_SAMPLES (5ms at 48khz). The emulation thread
+// adds a 60th of a second (800 samples) at a time, after topping the queue up with silence to
+// one device buffer whenever it has run that low. The device takes whole buffers, so just
+// before a frame arrives one to two buffers are left, and about 16ms of sound is queued on
+// average, 22ms counting the buffer being played. Frames are only dropped when the queue is
+// full, which the slow drift between the two clocks takes a long time to get to.
+static const int AUDIO_SAMPLE_RATE = 48000;
+static const int AUDIO_DEVICE_SAMPLES = 256;
+static const size_t AUDIO_QUEUE_SAMPLES = 4096;
 
 Platform::Platform(int pWidth, int pInstructionsPerSecond, Chip8 *pChip8Object) : gWidth(pWidth),
                                                                                   gHeight(gWidth / 2),
-                                                                                  gChip8Object(pChip8Object),
                                                                                   gInstructionsPerSecond(pInstructionsPerSecond),
+                                                                                  gChip8Object(pChip8Object),
+                                                                                  gRecording(nullptr),
                                                                                   gWindow(nullptr),
                                                                                   gRenderer(nullptr),
-                                                                                  gTexture(nullptr)
+                                                                                  gTexture(nullptr),
+                                                                                  gRunning(false),
+                                                                                  gKeys(0),
+                                                                                  gKeysTime(0),
+                                                                                  gAudioQueue(AUDIO_QUEUE_SAMPLES),
+                                                                                  gAudioDevice(0),
+                                                                                  gAudioDeviceSamples(0),
+                                                                                  gAudioStats()
 {
 }
 
 Platform::~Platform()
 {
+    if (gAudioDevice)
+        SDL_CloseAudioDevice(gAudioDevice);
     SDL_DestroyTexture(gTexture);
     SDL_DestroyRenderer(gRenderer);
 
@@ -23,18 +49,48 @@ Platform::~Platform()
 
 void Platform::Loop()
 {
+    typedef std::chrono::steady_clock Clock;
+
     bool running = true;
     SDL_Event event;
-    uint32_t pixels[64 * 32];
-    uint64_t lastTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-    double unprocessedSeconds = 0;
-    double secondsPerTick = 1.0 / (double)gInstructionsPerSecond;
+    uint32_t pixels[Chip8::MAX_SCREEN_WIDTH * Chip8::MAX_SCREEN_HEIGHT];
+    // XO-CHIP colors for each combination of the two planes
+    static const uint32_t palette[4] = {0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555};
+    // set when the window needs repainting even though the Chip8 screen did not change
+    bool windowDirty = true;
+    SDL_Rect screenRect = {0, 0, gChip8Object->GetScreenWidth(), gChip8Object->GetScreenHeight()};
+
+    // timers tick once per frame, so each frame runs exactly one tick's worth of instructions
+    uint32_t instructionsPerFrame = (gInstructionsPerSecond + 30) / 60;
+    if (instructionsPerFrame == 0)
+        instructionsPerFrame = 1;
+    gChip8Object->SetInstructionsPerTick(instructionsPerFrame);
+    if (gRecording)
+        gRecording->Begin(*gChip8Object);
+
+    // the Chip8 belongs to the emulation thread until it is joined
+    FrameStats stats = {};
+    PresentStats presentStats = {};
+    uint16_t keys = 0;
+    // input time of the last frame measured
+    int64_t lastInputTime = 0;
+    gKeys = 0;
+    gKeysTime = 0;
+    gRunning = true;
+    std::thread emulation(&Platform::EmulationLoop, this, std::ref(stats));
+    if (gAudioDevice)
+        SDL_PauseAudioDevice(gAudioDevice, 0);
 
     while (running)
     {
+        // Take the latest screen. With nothing new to present, wait briefly for input instead.
+        bool newFrame = gFrames.Update();
+        bool haveEvent = newFrame || windowDirty ? SDL_PollEvent(&event) : SDL_WaitEventTimeout(&event, 1);
+
         // Events
-        while (SDL_PollEvent(&event))
+        for (; haveEvent; haveEvent = SDL_PollEvent(&event))
         {
+            uint16_t oldKeys = keys;
             switch (event.type)
             {
             case SDL_QUIT:
@@ -47,18 +103,14 @@ void Platform::Loop()
                 for (int i = 0; i < 16; i++)
                 {
                     if (event.key.keysym.sym == gChip8KeyMap[i])
-                    {
-                        gChip8Object->SetKeyState(i, 1);
-                    }
+                        keys |= 1 << i;
                 }
                 break;
             case SDL_KEYUP:
                 for (int i = 0; i < 16; i++)
                 {
                     if (event.key.keysym.sym == gChip8KeyMap[i])
-                    {
-                        gChip8Object->SetKeyState(i, 0);
-                    }
+                        keys &= ~(1 << i);
                 }
                 break;
             case SDL_WINDOWEVENT:
@@ -67,33 +119,230 @@ void Platform::Loop()
                     printf("Window Resized: %d X %d\n", event.window.data1, event.window.data2);
                     fflush(stdout);
                 }
+                windowDirty = true;
                 break;
             }
+
+            // the time first, so the emulation thread never sees new keys with an old time
+            if (keys != oldKeys)
+            {
+                gKeysTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+                gKeys.store(keys, std::memory_order_release);
+            }
+        }
+
+        //Render, only when a frame was published or the window was exposed or resized
+        // the texture fits the largest screen of the profile, only the current resolution's corner is used
+        const DisplayFrame &frame = gFrames.GetFront();
+        if (newFrame || (windowDirty && frame.width))
+        {
+            screenRect = {0, 0, frame.width, frame.height};
+            // rows wider than 64 pixels are consecutive words, so they expand as more 64 pixel rows
+            int rowWords = screenRect.w * screenRect.h / 64;
+            if (frame.xoChip)
+                ExpandPlanes(frame.words[0], frame.words[1], rowWords, palette, pixels);
+            else
+                ExpandRows(frame.words[0], rowWords, 0xFFFFFFFF, 0xFF000000, pixels);
+            SDL_UpdateTexture(gTexture, &screenRect, pixels, screenRect.w * sizeof(uint32_t));
+            windowDirty = true;
+        }
+        if (windowDirty)
+        {
+            SDL_RenderClear(gRenderer);
+            SDL_RenderCopy(gRenderer, gTexture, &screenRect, NULL);
+            SDL_RenderPresent(gRenderer);
+            windowDirty = false;
+            presentStats.presents++;
+
+            // a time carried over from a replaced frame can also reach the frame after the one that showed it
+            if (newFrame && frame.inputTime && frame.inputTime != lastInputTime)
+            {
+                lastInputTime = frame.inputTime;
+                double latencyUs = std::chrono::duration<double, std::micro>(Clock::now() - Clock::time_point(Clock::duration(frame.inputTime))).count();
+                presentStats.inputs++;
+                presentStats.latencySum += latencyUs;
+                if (latencyUs > presentStats.latencyMax)
+                    presentStats.latencyMax = latencyUs;
+            }
+        }
+    }
+
+    gRunning = false;
+    emulation.join();
+    if (gAudioDevice)
+        SDL_PauseAudioDevice(gAudioDevice, 1);
+
+    if (gRecording)
+        gRecording->End(*gChip8Object);
+    PrintFrameStats(stats, presentStats);
+
+    // the core counts these instead of printing them as they happen
+    if (gChip8Object->GetTrapCount())
+        printf("Unknown opcodes executed: %u, last %04X\n", gChip8Object->GetTrapCount(), gChip8Object->GetLastTrapOpcode());
+    if (gChip8Object->GetFaultCount())
+        printf("Faults: %u, last %s at PC %03X\n", gChip8Object->GetFaultCount(),
+               Chip8::GetFaultName(gChip8Object->GetLastFault()), gChip8Object->GetLastFaultPC());
+}
+
+void Platform::EmulationLoop(FrameStats &stats)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    uint16_t keys = 0;
+    // when the key change the screen has not shown yet was read, 0 if there is none
+    int64_t pendingInputTime = 0;
+    int16_t samples[AudioSynth::MAX_FRAME_SAMPLES];
+
+    const Clock::duration framePeriod = std::chrono::nanoseconds(1000000000 / 60);
+    Clock::time_point deadline = Clock::now() + framePeriod;
+
+    while (gRunning.load(std::memory_order_relaxed))
+    {
+        Clock::time_point frameStart = Clock::now();
+
+        // Input, applied at the frame boundary as the render thread left it
+        uint16_t newKeys = gKeys.load(std::memory_order_acquire);
+        if (newKeys != keys)
+        {
+            if (!pendingInputTime)
+                pendingInputTime = gKeysTime.load(std::memory_order_relaxed);
+            for (int i = 0; i < 16; i++)
+            {
+                uint8_t state = (newKeys >> i) & 1;
+                if (state == ((keys >> i) & 1))
+                    continue;
+                if (gRecording)
+                    gRecording->SetKeyState(*gChip8Object, i, state);
+                else
+                    gChip8Object->SetKeyState(i, state);
+            }
+            keys = newKeys;
         }
 
-        //Cycle
-        uint64_t currentTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-        unprocessedSeconds += ((double)(currentTime - lastTime) / 1000.0);
-        lastTime = currentTime;
+        //Cycle, one frame's worth of instructions
+        gChip8Object->RunUntilFrame(Chip8::EVENT_NONE);
 
-        while (unprocessedSeconds >= secondsPerTick)
+        //Sound, never waiting for the audio thread
+        int sampleCount = gSynth.RenderFrame(*gChip8Object, samples);
+        if (gAudioDevice)
         {
-            gChip8Object->Cycle();
-            unprocessedSeconds -= secondsPerTick;
+            // at the start or after running dry, so the device has a buffer ready until the next frame.
+            // used can be more than is left if the device just took a buffer, which only delays the top up a frame.
+            static const int16_t silence[AudioSynth::MAX_FRAME_SAMPLES] = {};
+            size_t used = gAudioQueue.GetUsed();
+            while (used < (size_t)gAudioDeviceSamples)
+            {
+                size_t count = gAudioDeviceSamples - used < (size_t)AudioSynth::MAX_FRAME_SAMPLES ? gAudioDeviceSamples - used : AudioSynth::MAX_FRAME_SAMPLES;
+                if (!gAudioQueue.Write(silence, count))
+                    break;
+                used += count;
+            }
+            if (!gAudioQueue.Write(samples, sampleCount))
+                stats.audioDropped++;
         }
 
-        //Render
-        const uint8_t *chip8Pixels = gChip8Object->GetScreen();
-        for (int i = 0; i < 64 * 32; i++)
+        //Publish, only when something was drawn
+        if (gChip8Object->IsScreenDirty())
         {
-            uint8_t curPixel = chip8Pixels[i];
-            pixels[i] = (0x00FFFFFF * curPixel) | 0xFF000000;
+            DisplayFrame &frame = gFrames.GetBack();
+            frame.width = gChip8Object->GetScreenWidth();
+            frame.height = gChip8Object->GetScreenHeight();
+            frame.xoChip = gChip8Object->GetProfile() == Chip8::PROFILE_XOCHIP;
+            int words = frame.width * frame.height / 64;
+            for (int plane = 0; plane < (frame.xoChip ? 2 : 1); plane++)
+                memcpy(frame.words[plane], gChip8Object->GetPackedScreen(plane), words * sizeof(uint64_t));
+            frame.inputTime = pendingInputTime;
+            gChip8Object->MarkScreenClean();
+
+            stats.published++;
+            if (gFrames.Publish())
+            {
+                // the replaced frame was never shown, so the next one carries the earlier of the two inputs again
+                int64_t replacedTime = gFrames.GetBack().inputTime;
+                if (replacedTime && (!pendingInputTime || replacedTime < pendingInputTime))
+                    pendingInputTime = replacedTime;
+                stats.dropped++;
+            }
+            else
+                pendingInputTime = 0;
         }
 
-        SDL_UpdateTexture(gTexture, NULL, pixels, 64 * sizeof(uint32_t));
-        SDL_RenderClear(gRenderer);
-        SDL_RenderCopy(gRenderer, gTexture, NULL, NULL);
-        SDL_RenderPresent(gRenderer);
+        //Wait for the next 60hz deadline
+        Clock::time_point workDone = Clock::now();
+        if (workDone < deadline)
+            std::this_thread::sleep_until(deadline);
+        else
+            stats.missed++;
+
+        Clock::time_point wake = Clock::now();
+        RecordFrame(stats, wake - deadline, workDone - frameStart);
+
+        deadline += framePeriod;
+        // if we fell far behind (debugger, suspended window) start over instead of running frames back to back
+        if (wake - deadline > 4 * framePeriod)
+            deadline = wake + framePeriod;
+    }
+}
+
+void Platform::RecordFrame(FrameStats &pStats, std::chrono::steady_clock::duration pLateness, std::chrono::steady_clock::duration pWork)
+{
+    double lateUs = std::chrono::duration<double, std::micro>(pLateness).count();
+    double workUs = std::chrono::duration<double, std::micro>(pWork).count();
+
+    pStats.frames++;
+    pStats.lateSum += lateUs;
+    pStats.lateSquaredSum += lateUs * lateUs;
+    if (lateUs > pStats.lateMax)
+        pStats.lateMax = lateUs;
+    pStats.workSum += workUs;
+}
+
+void Platform::PrintFrameStats(const FrameStats &pStats, const PresentStats &pPresentStats)
+{
+    if (pStats.frames == 0)
+        return;
+
+    double mean = pStats.lateSum / pStats.frames;
+    double variance = pStats.lateSquaredSum / pStats.frames - mean * mean;
+    double jitter = variance > 0 ? sqrt(variance) : 0;
+
+    printf("Frames: %llu, missed deadlines: %llu\n", (unsigned long long)pStats.frames, (unsigned long long)pStats.missed);
+    printf("Wake-up lateness: mean %.1f us, max %.1f us, jitter (std dev) %.1f us\n", mean, pStats.lateMax, jitter);
+    printf("Emulation per frame: %.1f us (%.2f%% of a frame)\n", pStats.workSum / pStats.frames,
+           100.0 * (pStats.workSum / pStats.frames) / (1000000.0 / 60));
+    printf("Screens published: %llu, presented: %llu, replaced before presenting: %llu\n", (unsigned long long)pStats.published,
+           (unsigned long long)pPresentStats.presents, (unsigned long long)pStats.dropped);
+    if (pPresentStats.inputs)
+        printf("Input to present: mean %.1f us, max %.1f us over %llu key changes\n", pPresentStats.latencySum / pPresentStats.inputs,
+               pPresentStats.latencyMax, (unsigned long long)pPresentStats.inputs);
+
+    if (!gAudioDevice)
+        return;
+    // the callback has stopped, the lock makes its last writes visible
+    SDL_LockAudioDevice(gAudioDevice);
+    AudioStats audio = gAudioStats;
+    SDL_UnlockAudioDevice(gAudioDevice);
+    if (audio.callbacks)
+        printf("Audio latency: mean %.1f ms, underruns: %llu of %llu buffers, frames of sound skipped: %llu\n",
+               1000.0 * ((double)audio.queuedSum / audio.callbacks + gAudioDeviceSamples) / gSynth.GetSampleRate(),
+               (unsigned long long)audio.underruns, (unsigned long long)audio.callbacks, (unsigned long long)pStats.audioDropped);
+    fflush(stdout);
+}
+
+void Platform::AudioCallback(void *pPlatform, Uint8 *pStream, int pLength)
+{
+    Platform *platform = (Platform *)pPlatform;
+    int16_t *out = (int16_t *)pStream;
+    size_t count = pLength / sizeof(int16_t);
+
+    platform->gAudioStats.callbacks++;
+    platform->gAudioStats.queuedSum += platform->gAudioQueue.GetUsed();
+    size_t read = platform->gAudioQueue.Read(out, count);
+    if (read < count)
+    {
+        // silence rather than wait
+        memset(out + read, 0, (count - read) * sizeof(int16_t));
+        platform->gAudioStats.underruns++;
     }
 }
 
@@ -120,11 +369,35 @@ int Platform::InitPlatform(const char *pTitle)
         return 1;
     }
 
-    gTexture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, 64, 32);
+    gTexture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                 Chip8::GetMaxScreenWidth(gChip8Object->GetProfile()), Chip8::GetMaxScreenHeight(gChip8Object->GetProfile()));
     if (gTexture == nullptr)
     {
         printf("Failed to create texture. ERROR: %s\n", SDL_GetError());
         return 1;
     }
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+    {
+        printf("No audio: %s\n", SDL_GetError());
+        return 0;
+    }
+    SDL_AudioSpec wanted = {};
+    SDL_AudioSpec obtained;
+    wanted.freq = AUDIO_SAMPLE_RATE;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 1;
+    wanted.samples = AUDIO_DEVICE_SAMPLES;
+    wanted.callback = AudioCallback;
+    wanted.userdata = this;
+    // any rate and buffer size will do, the format must be as asked
+    gAudioDevice = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    if (gAudioDevice == 0)
+    {
+        printf("No audio: %s\n", SDL_GetError());
+        return 0;
+    }
+    gSynth = AudioSynth(obtained.freq);
+    gAudioDeviceSamples = obtained.samples;
     return 0;
 }
@@ -2,7 +2,65 @@
 #define PLATFORM_H
 
 #include <SDL.h>
+#include <atomic>
+#include <chrono>
+#include "AudioOutput.hpp"
 #include "Chip8.hpp"
+#include "InputRecording.hpp"
+#include "SpscRing.hpp"
+#include "TripleBuffer.hpp"
+
+// Frame pacing measurements collected by Platform::Loop, times in microseconds
+struct FrameStats
+{
+    uint64_t frames;
+    // frames whose work ran past the deadline, so there was no sleep
+    uint64_t missed;
+    // how long after the deadline the loop woke up
+    double lateSum;
+    double lateSquaredSum;
+    double lateMax;
+    // time spent emulating
+    double workSum;
+    // frames handed to the render thread, and those it never took because a newer one came first
+    uint64_t published;
+    uint64_t dropped;
+    // frames of sound not queued because the audio device was already a buffer behind
+    uint64_t audioDropped;
+};
+
+// Measured by the render thread, times in microseconds
+struct PresentStats
+{
+    uint64_t presents;
+    // key changes whose effect on the screen was presented, and how long each took to get there
+    uint64_t inputs;
+    double latencySum;
+    double latencyMax;
+};
+
+// Measured by SDL's audio thread
+struct AudioStats
+{
+    uint64_t callbacks;
+    // callbacks that found fewer samples queued than the device asked for
+    uint64_t underruns;
+    // samples waiting in the queue when each callback started
+    uint64_t queuedSum;
+};
+
+// A finished frame, handed from the emulation thread to the render thread
+struct DisplayFrame
+{
+    // 0 until the first frame
+    int width = 0;
+    int height = 0;
+    bool xoChip = false;
+    // as Chip8::GetPackedScreen
+    uint64_t words[Chip8::PLANE_COUNT][Chip8::MAX_SCREEN_WIDTH / 64 * Chip8::MAX_SCREEN_HEIGHT];
+    // when the key change this frame is the first to show was read, in steady_clock ticks, 0 if none
+    int64_t inputTime = 0;
+};
 
 class Platform
 {
@@ -11,17 +69,32 @@ public:
     virtual ~Platform();
 
 public:
-    // Event Loop for input and running Chip8
+    /*
+    Event Loop for input and running Chip8.
+    The Chip8 runs on a thread of its own, one 60hz frame of instructions (timers in
+    virtual time) per deadline, and publishes the screen whenever it changed. This
+    thread reads input and presents the latest published screen, so a slow present
+    can't hold up emulation. Prints frame timing and input latency stats on exit.
+    */
     void Loop();
 
     /*
     Initializes SDL
     Returns 1 if an error occurs and 0 otherwise. Will print error to stdout.
+    Having no audio device is not an error, the sound is then made and dropped.
     */
     int InitPlatform(const char * pWindowTitle);
 
+    // Record every key transition of the next Loop into pRecording (nullptr to stop recording)
+    void SetRecording(InputRecording *pRecording) { gRecording = pRecording; }
 
-
+private:
+    // Runs gChip8Object at 60hz until gRunning is cleared
+    void EmulationLoop(FrameStats &pStats);
+    void RecordFrame(FrameStats &pStats, std::chrono::steady_clock::duration pLateness, std::chrono::steady_clock::duration pWork);
+    void PrintFrameStats(const FrameStats &pStats, const PresentStats &pPresentStats);
+    // SDL audio callback, pPlatform is the Platform
+    static void SDLCALL AudioCallback(void *pPlatform, Uint8 *pStream, int pLength);
 
 private:
     int gWidth;
@@ -29,11 +102,29 @@ private:
     int gInstructionsPerSecond;
 
     Chip8 * gChip8Object;
+    InputRecording *gRecording;
 
     SDL_Window *gWindow;
     SDL_Renderer *gRenderer;
     SDL_Texture *gTexture;
 
+    // shared by the two threads of Loop
+    std::atomic<bool> gRunning;
+    // bit per Chip8 key held down, written by the render thread
+    std::atomic<uint16_t> gKeys;
+    // when gKeys last changed, in steady_clock ticks
+    std::atomic<int64_t> gKeysTime;
+    TripleBuffer<DisplayFrame> gFrames;
+
+    // sound, made by the emulation thread and played from SDL's audio thread
+    AudioSynth gSynth;
+    SpscRing<int16_t> gAudioQueue;
+    // 0 if there is no audio device
+    SDL_AudioDeviceID gAudioDevice;
+    // samples the device takes per callback
+    int gAudioDeviceSamples;
+    AudioStats gAudioStats;
+
     // Key Map for Chip8 (See Readme)
     SDL_KeyCode gChip8KeyMap[16] = {
         SDLK_x,
@@ -0,0 +1,138 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "Profiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+Profiler::Profiler()
+{
+    Reset();
+}
+
+Profiler::~Profiler()
+{
+}
+
+void Profiler::Reset()
+{
+    gInstructions = 0;
+    memset(gOpCounts, 0, sizeof(gOpCounts));
+    gPCCounts.assign(Chip8::MAX_MEMORY_SIZE, 0);
+    gPCOpcodes.assign(Chip8::MAX_MEMORY_SIZE, 0);
+    gDraws = 0;
+    gDrawNanoseconds = 0;
+
+    ProfileNode root = {};
+    gNodes.assign(1, root);
+    gCurrent = 0;
+}
+
+uint32_t Profiler::EnterCall(uint16_t address)
+{
+    ProfileNode &current = gNodes[gCurrent];
+    if (current.depth >= 16)
+        return gCurrent;
+
+    for (uint32_t child = current.firstChild; child != 0; child = gNodes[child].nextSibling)
+    {
+        if (gNodes[child].address == address)
+            return child;
+    }
+
+    ProfileNode node = {};
+    node.address = address;
+    node.parent = gCurrent;
+    node.nextSibling = current.firstChild;
+    node.depth = current.depth + 1;
+    uint32_t index = (uint32_t)gNodes.size();
+    // current is a reference into gNodes, so link it before growing the vector
+    current.firstChild = index;
+    gNodes.push_back(node);
+    return index;
+}
+
+bool Profiler::WriteJson(const char *fileName, int hotCount) const
+{
+    FILE *file = fopen(fileName, "w");
+    if (!file)
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 1;
+    }
+
+    fprintf(file, "{\n  \"instructions\": %llu,\n", (unsigned long long)gInstructions);
+
+    fprintf(file, "  \"ops\": {");
+    bool first = true;
+    for (int op = 0; op < OP_COUNT; op++)
+    {
+        if (gOpCounts[op] == 0)
+            continue;
+        fprintf(file, "%s\n    \"%s\": %llu", first ? "" : ",", GetOpName(op), (unsigned long long)gOpCounts[op]);
+        first = false;
+    }
+    fprintf(file, "\n  },\n");
+
+    std::vector<uint16_t> pcs;
+    for (uint32_t pc = 0; pc < Chip8::MAX_MEMORY_SIZE; pc++)
+    {
+        if (gPCCounts[pc])
+            pcs.push_back((uint16_t)pc);
+    }
+    std::sort(pcs.begin(), pcs.end(), [this](uint16_t a, uint16_t b) { return gPCCounts[a] > gPCCounts[b]; });
+    if ((int)pcs.size() > hotCount)
+        pcs.resize(hotCount);
+
+    fprintf(file, "  \"hot_pcs\": [");
+    for (size_t i = 0; i < pcs.size(); i++)
+    {
+        fprintf(file, "%s\n    {\"pc\": \"0x%03X\", \"opcode\": \"%04X\", \"count\": %llu}", i ? "," : "",
+                pcs[i], gPCOpcodes[pcs[i]], (unsigned long long)gPCCounts[pcs[i]]);
+    }
+    fprintf(file, "\n  ],\n");
+
+    fprintf(file, "  \"draw\": {\"count\": %llu, \"total_ns\": %llu, \"mean_ns\": %.1f}\n}\n",
+            (unsigned long long)gDraws, (unsigned long long)gDrawNanoseconds,
+            gDraws ? (double)gDrawNanoseconds / gDraws : 0.0);
+
+    fclose(file);
+    return 0;
+}
+
+bool Profiler::WriteFolded(const char *fileName) const
+{
+    FILE *file = fopen(fileName, "w");
+    if (!file)
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 1;
+    }
+
+    for (uint32_t index = 0; index < gNodes.size(); index++)
+    {
+        // the path is rebuilt from the parents, the tree is small
+        std::string path;
+        for (uint32_t node = index; node != 0; node = gNodes[node].parent)
+        {
+            char frame[16];
+            snprintf(frame, sizeof(frame), ";sub_%03X", gNodes[node].address);
+            path.insert(0, frame);
+        }
+        path.insert(0, "rom");
+
+        for (int op = 0; op < OP_COUNT; op++)
+        {
+            if (gNodes[index].opCounts[op])
+                fprintf(file, "%s;%s %llu\n", path.c_str(), GetOpName(op), (unsigned long long)gNodes[index].opCounts[op]);
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
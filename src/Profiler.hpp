@@ -0,0 +1,104 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <stdint.h>
+#include <vector>
+#include "Chip8.hpp"
+#include "Chip8Decode.hpp"
+
+// One subroutine in the call tree, identified by its entry address
+struct ProfileNode
+{
+    uint16_t address;
+    uint32_t parent;
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    uint32_t depth;
+    // instructions executed in this subroutine (not its callees), per Chip8Op
+    uint64_t opCounts[OP_COUNT];
+};
+
+/*
+Execution counts collected by Chip8 while a profiler is attached (Chip8::SetProfiler):
+instructions per opcode class and per PC, time spent drawing, and a call tree built
+by following 2NNN and 00EE, for finding where a ROM spends its cycles.
+Profiled runs always go through the interpreter, so attaching one slows the run down,
+but a Chip8 without a profiler runs exactly as before.
+*/
+class Profiler
+{
+public:
+    Profiler();
+    virtual ~Profiler();
+
+public:
+    // Forget everything counted so far
+    void Reset();
+
+    // Count one executed instruction, called after it ran
+    inline void Record(uint16_t pPC, uint16_t pOpcode, uint8_t pOp)
+    {
+        gInstructions++;
+        gOpCounts[pOp]++;
+        gPCCounts[pPC]++;
+        gPCOpcodes[pPC] = pOpcode;
+        gNodes[gCurrent].opCounts[pOp]++;
+
+        if (pOp == OP_CALL_2NNN)
+            gCurrent = EnterCall(pOpcode & 0x0FFF);
+        else if (pOp == OP_RET_00EE && gCurrent != 0)
+            gCurrent = gNodes[gCurrent].parent;
+    }
+    // Add the time one DXYN took
+    inline void RecordDraw(uint64_t pNanoseconds)
+    {
+        gDraws++;
+        gDrawNanoseconds += pNanoseconds;
+    }
+
+    uint64_t GetInstructions() const { return gInstructions; }
+    uint64_t GetOpCount(uint8_t pOp) const { return gOpCounts[pOp]; }
+    uint64_t GetPCCount(uint16_t pPC) const { return gPCCounts[pPC]; }
+    uint64_t GetDrawNanoseconds() const { return gDrawNanoseconds; }
+    const std::vector<ProfileNode> &GetCallTree() const { return gNodes; }
+
+    /*
+    Write the counters as JSON: totals per opcode class, the pHotCount most executed
+    PCs with their opcodes, and DXYN timing.
+    Returns 1 if the file could not be written and 0 otherwise.
+    */
+    bool WriteJson(const char *pFileName, int pHotCount = 64) const;
+    /*
+    Write the call tree in the folded stack format flamegraph.pl and speedscope read,
+    one line per subroutine path and opcode class: "rom;sub_2A4;DXYN 1200".
+    Returns 1 if the file could not be written and 0 otherwise.
+    */
+    bool WriteFolded(const char *pFileName) const;
+
+private:
+    // Node for a call to pAddress from the current node, created on first use.
+    // Calls deeper than the 16-entry Chip8 stack stay in the current node.
+    uint32_t EnterCall(uint16_t pAddress);
+
+private:
+    uint64_t gInstructions;
+    uint64_t gOpCounts[OP_COUNT];
+    // per PC over all of XO-CHIP's 64K, on the heap so a Profiler on the stack stays small
+    std::vector<uint64_t> gPCCounts;
+    // last opcode seen at each PC, code can change under a PC
+    std::vector<uint16_t> gPCOpcodes;
+    uint64_t gDraws;
+    uint64_t gDrawNanoseconds;
+
+    // node 0 is the top level of the ROM
+    std::vector<ProfileNode> gNodes;
+    uint32_t gCurrent;
+};
+
+#endif // PROFILER_HPP
@@ -0,0 +1,38 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <stdint.h>
+
+/*
+PCG32 (XSH RR) random numbers for CXNN.
+The whole generator is one 64-bit state, so every instance owns its own,
+it costs a multiply per number and it fits in save states and snapshots.
+*/
+
+// Next 32 random bits, advancing pState
+inline uint32_t NextRandom(uint64_t &pState)
+{
+    uint64_t old = pState;
+    pState = old * 6364136223846793005ull + 1442695040888963407ull;
+    uint32_t shifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rotation = (uint32_t)(old >> 59);
+    return (shifted >> rotation) | (shifted << ((0 - rotation) & 31));
+}
+
+// Starting state for pSeed
+inline uint64_t SeedRandom(uint64_t pSeed)
+{
+    uint64_t state = 0;
+    NextRandom(state);
+    state += pSeed;
+    NextRandom(state);
+    return state;
+}
+
+#endif // RANDOM_HPP
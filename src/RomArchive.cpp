@@ -0,0 +1,246 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "RomArchive.hpp"
+#include "Chip8.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+static void Put(std::vector<uint8_t> &out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+static std::string Trim(const std::string &text)
+{
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos)
+        return "";
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+static std::string Lower(std::string text)
+{
+    for (char &c : text)
+        c = (char)tolower((unsigned char)c);
+    return text;
+}
+
+// A Chip8 key written as a word of its own, 0-9 or A-F
+static int KeyDigit(const std::string &word)
+{
+    if (word.size() != 1)
+        return -1;
+    char c = word[0];
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Keys mentioned right after "key", "use", "press" and the like, such as "use 4 and 6 to move"
+static uint16_t GuessKeys(const std::string &notes)
+{
+    static const char *triggers[] = {"key", "keys", "use", "press", "hit", "button", "buttons"};
+    static const char *joiners[] = {"and", "or", "to", "the", "then", "hex"};
+
+    uint16_t keys = 0;
+    bool collecting = false;
+    std::string word;
+    for (size_t i = 0; i <= notes.size(); i++)
+    {
+        char c = i < notes.size() ? notes[i] : '.';
+        if (isalnum((unsigned char)c))
+        {
+            word += c;
+            continue;
+        }
+
+        if (!word.empty())
+        {
+            std::string lower = Lower(word);
+            int key = KeyDigit(word);
+            bool trigger = false;
+            bool joiner = false;
+            for (const char *t : triggers)
+                trigger |= lower == t;
+            for (const char *j : joiners)
+                joiner |= lower == j;
+
+            if (trigger)
+                collecting = true;
+            else if (collecting && key >= 0)
+                keys |= 1 << key;
+            else if (!joiner)
+                collecting = false;
+            word.clear();
+        }
+
+        // a phrase ends with its sentence
+        if (c == '.' || c == '!' || c == '?' || c == ':' || c == ';')
+            collecting = false;
+    }
+    return keys;
+}
+
+void ParseRomInfo(const std::string &romPath, RomInfo &info)
+{
+    info = RomInfo();
+    std::filesystem::path path(romPath);
+
+    // "Title [Author, Year]", anything around the brackets stays in the title
+    std::string stem = path.stem().string();
+    size_t open = stem.find('[');
+    size_t close = stem.find(']', open);
+    if (open != std::string::npos && close != std::string::npos)
+    {
+        info.title = Trim(Trim(stem.substr(0, open)) + " " + Trim(stem.substr(close + 1)));
+        std::string credit = stem.substr(open + 1, close - open - 1);
+        size_t comma = credit.rfind(',');
+        std::string year = comma != std::string::npos ? Trim(credit.substr(comma + 1)) : "";
+        if (year.size() == 4 && isdigit((unsigned char)year[0]) && year.find_first_not_of("0123456789") == std::string::npos)
+        {
+            info.year = (uint16_t)atoi(year.c_str());
+            credit = credit.substr(0, comma);
+        }
+        else if (year.size() == 4 && isdigit((unsigned char)year[0]))
+        {
+            // "199x", a year but not an exact one
+            credit = credit.substr(0, comma);
+        }
+        info.author = Trim(credit);
+    }
+    else
+    {
+        info.title = Trim(stem);
+    }
+
+    std::ifstream notesFile(std::filesystem::path(path).replace_extension(".txt"), std::ifstream::binary);
+    if (!notesFile.is_open())
+        return;
+    info.description.assign(std::istreambuf_iterator<char>(notesFile), std::istreambuf_iterator<char>());
+    info.keys = GuessKeys(info.description);
+
+    // explicit fields win
+    size_t lineStart = 0;
+    while (lineStart < info.description.size())
+    {
+        size_t lineEnd = info.description.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = info.description.size();
+        std::string line = info.description.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t colon = line.find(':');
+        if (colon == std::string::npos)
+            continue;
+        std::string field = Lower(Trim(line.substr(0, colon)));
+        std::string value = Trim(line.substr(colon + 1));
+        if (field == "title")
+            info.title = value;
+        else if (field == "author")
+            info.author = value;
+        else if (field == "year")
+            info.year = (uint16_t)atoi(value.c_str());
+        else if (field == "speed")
+            info.speed = (uint32_t)strtoul(value.c_str(), nullptr, 10);
+        else if (field == "quirks")
+        {
+            if (Chip8::ParseQuirks(value.c_str(), info.quirks) != 0)
+                printf("Unknown quirk in %s: %s\n", romPath.c_str(), value.c_str());
+        }
+        else if (field == "keys")
+        {
+            info.keys = 0;
+            std::string word;
+            for (char c : value + " ")
+            {
+                if (isalnum((unsigned char)c))
+                {
+                    word += (char)toupper((unsigned char)c);
+                    continue;
+                }
+                if (KeyDigit(word) >= 0)
+                    info.keys |= 1 << KeyDigit(word);
+                word.clear();
+            }
+        }
+    }
+}
+
+RomArchiveWriter::RomArchiveWriter()
+{
+}
+
+RomArchiveWriter::~RomArchiveWriter()
+{
+}
+
+bool RomArchiveWriter::AddRom(const std::string &name, const std::vector<uint8_t> &data, const RomInfo &info)
+{
+    // XO-CHIP has the most memory, a ROM that does not fit there fits nowhere
+    std::vector<uint8_t> image(Chip8::GetMemorySize(Chip8::PROFILE_XOCHIP));
+    if (Chip8::BuildImage(data.data(), (uint32_t)data.size(), image.data(), Chip8::PROFILE_XOCHIP) != 0)
+        return 1;
+
+    gRoms.push_back({name, data, Chip8::HashImage(data.data(), (uint32_t)data.size()), info});
+    return 0;
+}
+
+bool RomArchiveWriter::Write(const char *fileName)
+{
+    std::vector<uint8_t> out(ROM_ARCHIVE_MAGIC, ROM_ARCHIVE_MAGIC + 4);
+    Put(out, ROM_ARCHIVE_VERSION, 1);
+    Put(out, 0, 3);
+    Put(out, gRoms.size(), 4);
+
+    // ROM bytes then strings, after the index
+    std::vector<uint8_t> tail;
+    size_t base = ROM_ARCHIVE_HEADER_SIZE + gRoms.size() * ROM_ARCHIVE_RECORD_SIZE;
+    auto putString = [&](const std::string &text) {
+        Put(out, base + tail.size(), 4);
+        Put(out, text.size(), 4);
+        tail.insert(tail.end(), text.begin(), text.end());
+    };
+
+    for (const Member &member : gRoms)
+    {
+        Put(out, base + tail.size(), 4);
+        Put(out, member.data.size(), 4);
+        tail.insert(tail.end(), member.data.begin(), member.data.end());
+        Put(out, member.hash, 4);
+        Put(out, member.info.year, 2);
+        Put(out, member.info.keys, 2);
+        Put(out, member.info.speed, 4);
+        putString(member.name);
+        putString(member.info.title);
+        putString(member.info.author);
+        putString(member.info.description);
+        Put(out, member.info.quirks, 1);
+    }
+    out.insert(out.end(), tail.begin(), tail.end());
+
+    std::ofstream outFile(fileName, std::ofstream::binary);
+    if (!outFile.is_open())
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 1;
+    }
+    outFile.write((const char *)out.data(), out.size());
+    if (!outFile)
+    {
+        printf("Could not write file: %s\n", fileName);
+        return 1;
+    }
+    return 0;
+}
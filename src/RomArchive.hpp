@@ -0,0 +1,68 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef ROM_ARCHIVE_HPP
+#define ROM_ARCHIVE_HPP
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "RomLibrary.hpp"
+
+/*
+Packed ROM archive, all values little endian:
+    "C8RA", version (1), 3 zero bytes, ROM count (4)
+    one index record per ROM:
+        ROM offset (4), ROM size (4), hash (4), year (2), keys (2), speed (4),
+        then offset (4) and length (4) of the name, title, author and description,
+        then quirks (1)
+    followed by the ROM bytes and the strings the records point at.
+Offsets are from the start of the file. The hash is Chip8::HashImage of the ROM's bytes,
+which catches damage whatever machine it is loaded on. The other fields are a RomInfo. Names are paths relative to the directory the archive was
+built from, with / separators. RomLibrary::AddArchive reads it in place.
+*/
+static const uint8_t ROM_ARCHIVE_MAGIC[4] = {'C', '8', 'R', 'A'};
+static const uint8_t ROM_ARCHIVE_VERSION = 3;
+static const size_t ROM_ARCHIVE_HEADER_SIZE = 4 + 1 + 3 + 4;
+static const size_t ROM_ARCHIVE_RECORD_SIZE = 4 + 4 + 4 + 2 + 2 + 4 + 4 * 8 + 1;
+
+/*
+Fill pInfo for the ROM at pRomPath. Title, author and year come from a file name like
+"Title [Author, Year].ch8". The .txt file next to the ROM becomes the description, and
+keys are guessed from phrases in it such as "use 4 and 6" or "press 5". Lines like
+"Title:", "Author:", "Year:", "Keys:" (hex digits) or "Speed:" (instructions per
+second) in the notes override all of that. A "Quirks:" line lists the quirks the ROM
+needs, as Chip8::ParseQuirks reads them.
+*/
+void ParseRomInfo(const std::string &pRomPath, RomInfo &pInfo);
+
+// Collects ROMs and writes them out as an archive
+class RomArchiveWriter
+{
+public:
+    RomArchiveWriter();
+    virtual ~RomArchiveWriter();
+
+public:
+    // Add a ROM - Returns 1 if it is too large for every machine and 0 otherwise
+    bool AddRom(const std::string &pName, const std::vector<uint8_t> &pData, const RomInfo &pInfo);
+    size_t GetRomCount() const { return gRoms.size(); }
+
+    // Write the archive - Returns 1 if an error occurred and 0 otherwise
+    bool Write(const char *pFileName);
+
+private:
+    struct Member
+    {
+        std::string name;
+        std::vector<uint8_t> data;
+        uint32_t hash;
+        RomInfo info;
+    };
+    std::vector<Member> gRoms;
+};
+
+#endif // ROM_ARCHIVE_HPP
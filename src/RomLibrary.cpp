@@ -0,0 +1,260 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include "RomLibrary.hpp"
+#include "Chip8.hpp"
+#include "RomArchive.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Map a whole file read only. An empty file gets no mapping. Returns false if it could not be mapped.
+static bool MapFile(const char *fileName, void *&address, size_t &size)
+{
+    address = nullptr;
+    size = 0;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    bool mapped = GetFileSizeEx(file, &fileSize) != 0;
+    size = mapped ? (size_t)fileSize.QuadPart : 0;
+    if (mapped && size > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        address = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        mapped = address != nullptr;
+        // the view holds its own reference
+        if (mapping)
+            CloseHandle(mapping);
+    }
+    CloseHandle(file);
+    return mapped;
+#else
+    int file = open(fileName, O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    bool mapped = fstat(file, &info) == 0;
+    size = mapped ? (size_t)info.st_size : 0;
+    if (mapped && size > 0)
+    {
+        address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+        mapped = address != MAP_FAILED;
+        if (!mapped)
+            address = nullptr;
+    }
+    // the mapping holds its own reference to the file
+    close(file);
+    return mapped;
+#endif
+}
+
+static uint32_t Get(const uint8_t *in, int bytes)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint32_t)in[i] << (i * 8);
+    return value;
+}
+
+static void UnmapFile(void *address, size_t size)
+{
+    if (!address)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(address);
+#else
+    munmap(address, size);
+#endif
+}
+
+RomLibrary::RomLibrary() : gProfile(Chip8::PROFILE_CHIP8)
+{
+}
+
+RomLibrary::~RomLibrary()
+{
+    for (const Mapping &mapping : gMappings)
+        UnmapFile(mapping.address, mapping.size);
+}
+
+const RomEntry *RomLibrary::AddRomFile(const char *fileName)
+{
+    auto known = gByName.find(fileName);
+    if (known != gByName.end())
+        return &gRoms[known->second];
+
+    void *address;
+    size_t size;
+    if (!MapFile(fileName, address, size))
+    {
+        printf("Could not open file: %s\n", fileName);
+        return nullptr;
+    }
+
+    // anything past 4 GB is too large anyway
+    const RomEntry *entry = AddRom(fileName, (const uint8_t *)address, (uint32_t)std::min<size_t>(size, UINT32_MAX));
+    if (!entry)
+    {
+        printf("Rom Is Too Large: %s\n", fileName);
+        UnmapFile(address, size);
+        return nullptr;
+    }
+
+    gMappings.push_back({address, size});
+    return entry;
+}
+
+int RomLibrary::AddRomDirectory(const char *directory)
+{
+    std::error_code error;
+    std::vector<std::string> files;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error);
+         it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if (error)
+            break;
+        if (it->is_regular_file() && it->path().extension() == ".ch8")
+            files.push_back(it->path().string());
+    }
+    if (error)
+        printf("Could not read directory: %s\n", directory);
+
+    // directory order is unspecified, keep the library the same between runs
+    std::sort(files.begin(), files.end());
+
+    int added = 0;
+    for (const std::string &file : files)
+    {
+        if (AddRomFile(file.c_str()))
+            added++;
+    }
+    return added;
+}
+
+int RomLibrary::AddArchive(const char *fileName)
+{
+    void *address;
+    size_t size;
+    if (!MapFile(fileName, address, size))
+    {
+        printf("Could not open file: %s\n", fileName);
+        return 0;
+    }
+
+    const uint8_t *archive = (const uint8_t *)address;
+    uint32_t count = size >= ROM_ARCHIVE_HEADER_SIZE ? Get(archive + 8, 4) : 0;
+    if (size < ROM_ARCHIVE_HEADER_SIZE || memcmp(archive, ROM_ARCHIVE_MAGIC, 4) != 0 ||
+        archive[4] != ROM_ARCHIVE_VERSION || count > (size - ROM_ARCHIVE_HEADER_SIZE) / ROM_ARCHIVE_RECORD_SIZE)
+    {
+        printf("Not a ROM archive: %s\n", fileName);
+        UnmapFile(address, size);
+        return 0;
+    }
+
+    // an offset and length pair, checked against the end of the file
+    auto inside = [&](const uint8_t *field) {
+        uint64_t offset = Get(field, 4);
+        uint64_t length = Get(field + 4, 4);
+        return offset + length <= size;
+    };
+    auto text = [&](const uint8_t *field) {
+        return std::string((const char *)archive + Get(field, 4), Get(field + 4, 4));
+    };
+
+    int added = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint8_t *record = archive + ROM_ARCHIVE_HEADER_SIZE + i * ROM_ARCHIVE_RECORD_SIZE;
+        if (!inside(record) || !inside(record + 20) || !inside(record + 28) || !inside(record + 36) || !inside(record + 44))
+        {
+            printf("Damaged entry %u in archive: %s\n", i, fileName);
+            continue;
+        }
+
+        RomInfo info;
+        info.year = (uint16_t)Get(record + 12, 2);
+        info.keys = (uint16_t)Get(record + 14, 2);
+        info.speed = Get(record + 16, 4);
+        info.title = text(record + 28);
+        info.author = text(record + 36);
+        info.description = text(record + 44);
+        info.quirks = record[52];
+        std::string name = text(record + 20);
+
+        // the stored hash catches a damaged ROM before it is indexed
+        const uint8_t *data = archive + Get(record, 4);
+        uint32_t dataSize = Get(record + 4, 4);
+        if (Chip8::HashImage(data, dataSize) != Get(record + 8, 4))
+        {
+            printf("Damaged entry %s in archive: %s\n", name.c_str(), fileName);
+            continue;
+        }
+        if (!AddRom(name, data, dataSize, info))
+        {
+            printf("Rom Is Too Large: %s\n", name.c_str());
+            continue;
+        }
+        added++;
+    }
+
+    // entries point into the mapping even if some were rejected
+    gMappings.push_back({address, size});
+    return added;
+}
+
+const RomEntry *RomLibrary::AddRom(const std::string &name, const uint8_t *data, uint32_t size, const RomInfo &info)
+{
+    gRoms.emplace_back();
+    RomEntry &entry = gRoms.back();
+    entry.image.resize(Chip8::GetMemorySize(gProfile));
+    if (Chip8::BuildImage(data, size, entry.image.data(), gProfile) != 0)
+    {
+        gRoms.pop_back();
+        return nullptr;
+    }
+    entry.name = name;
+    entry.data = data;
+    entry.size = size;
+    entry.hash = Chip8::HashImage(entry.image.data(), (uint32_t)entry.image.size());
+    entry.info = info;
+
+    size_t index = gRoms.size() - 1;
+    gByName[name] = index;
+    gByFileName.emplace(std::filesystem::path(name).filename().string(), index);
+    gByHash.emplace(entry.hash, index);
+    return &entry;
+}
+
+const RomEntry *RomLibrary::FindByName(const std::string &name) const
+{
+    auto found = gByName.find(name);
+    if (found != gByName.end())
+        return &gRoms[found->second];
+
+    found = gByFileName.find(name);
+    if (found != gByFileName.end())
+        return &gRoms[found->second];
+
+    return nullptr;
+}
+
+const RomEntry *RomLibrary::FindByHash(uint32_t hash) const
+{
+    auto found = gByHash.find(hash);
+    return found != gByHash.end() ? &gRoms[found->second] : nullptr;
+}
@@ -0,0 +1,116 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef ROM_LIBRARY_HPP
+#define ROM_LIBRARY_HPP
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Chip8.hpp"
+
+// What a ROM's file name and .txt notes say about it, see ParseRomInfo
+struct RomInfo
+{
+    std::string title;
+    std::string author;
+    // 0 if unknown
+    uint16_t year = 0;
+    // bit per Chip8 key the notes mention the ROM using
+    uint16_t keys = 0;
+    // recommended instructions per second, 0 if the notes don't say
+    uint32_t speed = 0;
+    // Chip8::Quirk flags the ROM needs
+    uint8_t quirks = 0;
+    // the notes as they are
+    std::string description;
+};
+
+// One ROM in a RomLibrary
+struct RomEntry
+{
+    // what it was added as, such as the file's path
+    std::string name;
+    // the ROM's bytes, inside the library's mapping of its file
+    const uint8_t *data;
+    uint32_t size;
+    // Chip8::HashImage of image, what Chip8::GetRomHash returns once it is loaded
+    uint32_t hash;
+    // empty unless it came from an archive
+    RomInfo info;
+    // memory right after loading on the library's machine, font and ROM laid out, for Chip8::LoadImage
+    std::vector<uint8_t> image;
+};
+
+/*
+ROMs memory-mapped once, from single files or a packed archive, and indexed by name
+and by content hash.
+Each keeps a pristine memory image for the library's machine, so any number of Chip8
+instances set to that profile can load and reset it with a single copy and no file I/O.
+Files are mapped read only and stay mapped until the library is destroyed. Add ROMs
+from one thread, after that the entries can be shared by every thread.
+*/
+class RomLibrary
+{
+public:
+    RomLibrary();
+    virtual ~RomLibrary();
+
+public:
+    // Machine the images are laid out for (default Chip8::PROFILE_CHIP8). Set it before adding ROMs.
+    void SetProfile(Chip8::Profile pProfile) { gProfile = pProfile; }
+    Chip8::Profile GetProfile() const { return gProfile; }
+
+    /*
+    Map a ROM file and index it. A path that was added before gives the same entry.
+    Returns nullptr if the file could not be read or the ROM is too large for the machine.
+    */
+    const RomEntry *AddRomFile(const char *pFileName);
+    // Add every .ch8 file below a directory in name order - Returns the number of ROMs added
+    int AddRomDirectory(const char *pDirectory);
+    /*
+    Map a packed archive (see RomArchive.hpp) and index every ROM in it that fits the machine,
+    named as in the archive. Returns the number of ROMs added, 0 if the file could not be read
+    or is not a valid archive.
+    */
+    int AddArchive(const char *pFileName);
+    /*
+    Index ROM bytes that stay valid as long as the library, such as part of a mapped archive.
+    Returns nullptr if the ROM is too large for the machine.
+    */
+    const RomEntry *AddRom(const std::string &pName, const uint8_t *pData, uint32_t pSize,
+                           const RomInfo &pInfo = RomInfo());
+
+    // By the name it was added as, or by its file name alone. nullptr if there is none.
+    const RomEntry *FindByName(const std::string &pName) const;
+    // By Chip8::GetRomHash, such as an InputRecording's. nullptr if there is none.
+    const RomEntry *FindByHash(uint32_t pHash) const;
+
+    size_t GetRomCount() const { return gRoms.size(); }
+    const RomEntry &GetRom(size_t pIndex) const { return gRoms[pIndex]; }
+
+private:
+    Chip8::Profile gProfile;
+
+    struct Mapping
+    {
+        void *address;
+        size_t size;
+    };
+    std::vector<Mapping> gMappings;
+
+    // a deque so entries never move
+    std::deque<RomEntry> gRoms;
+    std::unordered_map<std::string, size_t> gByName;
+    // the first ROM added under each file name
+    std::unordered_map<std::string, size_t> gByFileName;
+    // the first ROM added with each content hash
+    std::unordered_map<uint32_t, size_t> gByHash;
+};
+
+#endif // ROM_LIBRARY_HPP
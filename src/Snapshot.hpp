@@ -0,0 +1,60 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <stdint.h>
+#include <memory>
+
+// Memory is shared between snapshots in this many pages, of 256 bytes for 4K and 4K for 64K
+#define SNAPSHOT_PAGE_COUNT 16
+
+/*
+In-memory copy of a Chip8's state for forking, made by Chip8::Capture.
+Memory and display pages are immutable and reference counted, so a snapshot
+shares every page its machine did not write with the snapshot it was forked from.
+Copying a Snapshot is cheap and never copies page data.
+Unlike SaveState this is not a file format and is only valid within the process.
+*/
+class Snapshot
+{
+    friend class Chip8;
+    friend class Chip8Test;
+
+private:
+    // what it can be restored into, Chip8::GetRomHash and the page size of its profile
+    uint32_t romHash = 0;
+    uint8_t pageShift = 0;
+
+    // all empty until captured into. Pages are 1 << pageShift bytes.
+    std::shared_ptr<const uint8_t[]> pages[SNAPSHOT_PAGE_COUNT];
+    // the packed display planes the profile uses, displayWords each and only those
+    // the resolution it was captured at uses, one plane after the other
+    std::shared_ptr<const uint64_t[]> display;
+    uint16_t displayWords = 0;
+
+    uint16_t stack[16];
+    uint16_t sp;
+    uint16_t PC;
+    uint16_t I;
+    uint8_t V[16];
+    uint8_t delay;
+    uint8_t sound;
+    uint16_t keys;
+    uint64_t cycleCount;
+    uint32_t instructionsUntilTick;
+    uint32_t trapCount;
+    uint16_t lastTrapOpcode;
+    uint64_t randomState;
+    bool hires;
+    uint8_t planeMask;
+    uint8_t flags[16];
+    uint8_t audioPattern[16];
+    uint8_t pitch;
+};
+
+#endif // SNAPSHOT_HPP
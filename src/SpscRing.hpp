@@ -0,0 +1,78 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+/*
+Fixed-size lock-free queue between exactly one producer thread and one consumer thread.
+Neither side ever blocks or allocates: Write fails when there is no room and Read
+returns what is there. Items are copied in and out, so T should be plain data.
+*/
+template <typename T>
+class SpscRing
+{
+public:
+    // pCapacity is rounded up to a power of two
+    explicit SpscRing(size_t pCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < pCapacity)
+            capacity <<= 1;
+        gItems.resize(capacity);
+        gMask = capacity - 1;
+    }
+
+public:
+    // Producer side. Queue all pCount items - Returns false, queueing nothing, if they don't fit.
+    bool Write(const T *pItems, size_t pCount)
+    {
+        size_t head = gHead.load(std::memory_order_relaxed);
+        size_t tail = gTail.load(std::memory_order_acquire);
+        if (gItems.size() - (head - tail) < pCount)
+            return false;
+
+        for (size_t i = 0; i < pCount; i++)
+            gItems[(head + i) & gMask] = pItems[i];
+        // the items are visible before the new head is
+        gHead.store(head + pCount, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Take up to pMax items - Returns how many were taken.
+    size_t Read(T *pItems, size_t pMax)
+    {
+        size_t tail = gTail.load(std::memory_order_relaxed);
+        size_t head = gHead.load(std::memory_order_acquire);
+        size_t count = head - tail < pMax ? head - tail : pMax;
+
+        for (size_t i = 0; i < count; i++)
+            pItems[i] = gItems[(tail + i) & gMask];
+        // the slots are free once the items are copied out
+        gTail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Items queued. Each side's own position is exact and the
+    // other's may be stale, so on the producer side this is an upper bound (the consumer may have
+    // taken more since) and on the consumer side a lower bound (the producer may have added more).
+    size_t GetUsed() const { return gHead.load(std::memory_order_acquire) - gTail.load(std::memory_order_acquire); }
+    size_t GetCapacity() const { return gItems.size(); }
+
+private:
+    std::vector<T> gItems;
+    size_t gMask;
+    // positions count up forever and are masked on use, so full and empty differ.
+    // On separate cache lines so the two threads don't invalidate each other's.
+    alignas(64) std::atomic<size_t> gHead{0};
+    alignas(64) std::atomic<size_t> gTail{0};
+};
+
+#endif // SPSC_RING_HPP
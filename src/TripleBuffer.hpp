@@ -0,0 +1,59 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+Hands the latest of a stream of values from one producer thread to one consumer thread.
+The producer fills the back slot and publishes it, the consumer takes whatever was
+published last into the front slot. The third slot sits between them, so neither side
+ever waits for the other and values the consumer was too slow to take are dropped.
+*/
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : gBack(0), gFront(1), gMiddle(2) {}
+
+public:
+    // Producer side. The slot to fill, it keeps whatever it held before.
+    T &GetBack() { return gSlots[gBack]; }
+    // Producer side. Hand the back slot over - Returns true if it replaced a value that was never taken.
+    bool Publish()
+    {
+        uint8_t old = gMiddle.exchange(gBack | FRESH, std::memory_order_acq_rel);
+        gBack = old & INDEX;
+        return (old & FRESH) != 0;
+    }
+
+    // Consumer side. Take the latest published value if there is a new one - Returns false if there isn't.
+    bool Update()
+    {
+        if (!(gMiddle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        gFront = gMiddle.exchange(gFront, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+    // Consumer side. The value last taken by Update.
+    const T &GetFront() const { return gSlots[gFront]; }
+
+private:
+    static const uint8_t INDEX = 3;
+    // the middle slot holds a value the consumer has not taken yet
+    static const uint8_t FRESH = 4;
+
+    T gSlots[3];
+    // each owned by one side, on separate cache lines so they don't invalidate each other's
+    alignas(64) uint8_t gBack;
+    alignas(64) uint8_t gFront;
+    alignas(64) std::atomic<uint8_t> gMiddle;
+};
+
+#endif // TRIPLE_BUFFER_HPP
@@ -0,0 +1,163 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "Chip8.hpp"
+#include "RomArchive.hpp"
+#include "RomLibrary.hpp"
+
+void PrintUsage(const char *pProgram)
+{
+	printf("usage: %s [-o archive] RomFileOrDirectory...\n", pProgram);
+	printf("       %s -l archive\n", pProgram);
+	printf("  -o archive  file to write (default roms.c8ra)\n");
+	printf("  -l archive  list the ROMs in an archive\n");
+}
+
+// Read a ROM and its notes into the archive, named name - Returns 1 if it could not be added
+int AddRom(RomArchiveWriter &pWriter, const std::filesystem::path &pPath, const std::string &pName)
+{
+	std::ifstream romFile(pPath, std::ifstream::binary);
+	if (!romFile.is_open())
+	{
+		printf("Could not open file: %s\n", pPath.string().c_str());
+		return 1;
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(romFile)), std::istreambuf_iterator<char>());
+
+	RomInfo info;
+	ParseRomInfo(pPath.string(), info);
+	if (pWriter.AddRom(pName, data, info) != 0)
+	{
+		printf("Rom Is Too Large: %s\n", pPath.string().c_str());
+		return 1;
+	}
+	return 0;
+}
+
+int List(const char *pArchive)
+{
+	RomLibrary library;
+	if (library.AddArchive(pArchive) == 0)
+		return 1;
+
+	for (size_t i = 0; i < library.GetRomCount(); i++)
+	{
+		const RomEntry &rom = library.GetRom(i);
+		printf("%08x %5u  %s", rom.hash, rom.size, rom.name.c_str());
+		if (!rom.info.author.empty())
+			printf("  (%s%s%s)", rom.info.author.c_str(), rom.info.year ? ", " : "",
+				   rom.info.year ? std::to_string(rom.info.year).c_str() : "");
+		if (rom.info.keys)
+		{
+			printf("  keys");
+			for (int key = 0; key < 16; key++)
+			{
+				if (rom.info.keys & (1 << key))
+					printf(" %X", key);
+			}
+		}
+		if (rom.info.speed)
+			printf("  %u/s", rom.info.speed);
+		if (rom.info.quirks)
+		{
+			printf("  quirks");
+			for (int bit = 0; bit < 4; bit++)
+			{
+				if (rom.info.quirks & (1 << bit))
+					printf(" %s", Chip8::GetQuirkName((Chip8::Quirk)(1 << bit)));
+			}
+		}
+		printf("\n");
+	}
+	printf("%zu ROMs\n", library.GetRomCount());
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *outFile = "roms.c8ra";
+	const char *listFile = nullptr;
+
+	int argIndex = 1;
+
+	// options come first
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
+	{
+		if (argIndex + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[argIndex], "-o") == 0)
+			outFile = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-l") == 0)
+			listFile = argv[++argIndex];
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (listFile)
+		return List(listFile);
+
+	if (argIndex >= argc)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	RomArchiveWriter writer;
+	int failed = 0;
+	for (; argIndex < argc; argIndex++)
+	{
+		std::filesystem::path arg(argv[argIndex]);
+		if (!std::filesystem::is_directory(arg))
+		{
+			failed += AddRom(writer, arg, arg.filename().generic_string());
+			continue;
+		}
+
+		std::error_code error;
+		std::vector<std::filesystem::path> files;
+		for (auto it = std::filesystem::recursive_directory_iterator(arg, error);
+			 it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		{
+			if (error)
+				break;
+			if (it->is_regular_file() && it->path().extension() == ".ch8")
+				files.push_back(it->path());
+		}
+		if (error)
+			printf("Could not read directory: %s\n", argv[argIndex]);
+
+		// directory order is unspecified, keep archives the same between builds
+		std::sort(files.begin(), files.end());
+
+		// named relative to the directory, so "games/Pong (1 player).ch8"
+		for (const std::filesystem::path &file : files)
+			failed += AddRom(writer, file, file.lexically_relative(arg).generic_string());
+	}
+
+	if (writer.Write(outFile) != 0)
+		return 1;
+
+	printf("%zu ROMs written to %s", writer.GetRomCount(), outFile);
+	if (failed)
+		printf(", %d skipped", failed);
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,137 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include "BatchRunner.hpp"
+
+void PrintUsage(const char *pProgram)
+{
+	printf("usage: %s [-c cycles] [-j threads] [-t ticks] [-e engine] [-m machine] [-q quirks] [-l lanes] [-s seed] RomFileDirectoryOrArchive...\n", pProgram);
+	printf("  -c cycles   instructions to run per ROM (default 1000000)\n");
+	printf("  -j threads  worker threads (default: one per core)\n");
+	printf("  -t ticks    instructions per 60hz timer tick, 0 for wall-clock timers (default 12)\n");
+	printf("  -e engine   interpreter, predecoded, block or jit (default predecoded)\n");
+	printf("  -m machine  chip8, schip or xochip (default chip8)\n");
+	printf("  -q quirks   shift, loadstore, clip, jump or none, comma separated, for every ROM\n");
+	printf("              (default each ROM's from its archive)\n");
+	printf("  -l lanes    run each ROM as this many copies in lockstep on the vector engine,\n");
+	printf("              -c is then instructions per copy (default 0, off)\n");
+	printf("  -s seed     seed for the CXNN random numbers (default 0)\n");
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t cycles = 1000000;
+	int threads = 0;
+	uint32_t instructionsPerTick = 12;
+	Chip8::Engine engine = Chip8::ENGINE_PREDECODED;
+	Chip8::Profile machine = Chip8::PROFILE_CHIP8;
+	uint8_t quirks = Chip8::QUIRK_NONE;
+	bool quirksSet = false;
+	uint32_t lanes = 0;
+	uint64_t seed = 0;
+
+	int argIndex = 1;
+
+	// options come first
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
+	{
+		if (argIndex + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[argIndex], "-c") == 0)
+			cycles = strtoull(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-j") == 0)
+			threads = atoi(argv[++argIndex]);
+		else if (strcmp(argv[argIndex], "-t") == 0)
+			instructionsPerTick = (uint32_t)strtoul(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-l") == 0)
+			lanes = (uint32_t)strtoul(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-s") == 0)
+			seed = strtoull(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-q") == 0)
+		{
+			if (Chip8::ParseQuirks(argv[++argIndex], quirks) != 0)
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			quirksSet = true;
+		}
+		else if (strcmp(argv[argIndex], "-m") == 0)
+		{
+			argIndex++;
+			if (strcmp(argv[argIndex], "chip8") == 0)
+				machine = Chip8::PROFILE_CHIP8;
+			else if (strcmp(argv[argIndex], "schip") == 0)
+				machine = Chip8::PROFILE_SCHIP;
+			else if (strcmp(argv[argIndex], "xochip") == 0)
+				machine = Chip8::PROFILE_XOCHIP;
+			else
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[argIndex], "-e") == 0)
+		{
+			argIndex++;
+			if (strcmp(argv[argIndex], "interpreter") == 0)
+				engine = Chip8::ENGINE_INTERPRETER;
+			else if (strcmp(argv[argIndex], "predecoded") == 0)
+				engine = Chip8::ENGINE_PREDECODED;
+			else if (strcmp(argv[argIndex], "block") == 0)
+				engine = Chip8::ENGINE_BLOCK;
+			else if (strcmp(argv[argIndex], "jit") == 0)
+				engine = Chip8::ENGINE_JIT;
+			else
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (argIndex >= argc)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	BatchRunner runner(threads, cycles, instructionsPerTick);
+	runner.SetEngine(engine);
+	runner.SetProfile(machine);
+	if (quirksSet)
+		runner.SetQuirks(quirks);
+	runner.SetLanes(lanes);
+	runner.SetSeed(seed);
+
+	for (; argIndex < argc; argIndex++)
+	{
+		if (std::filesystem::is_directory(argv[argIndex]))
+			runner.AddRomDirectory(argv[argIndex]);
+		else if (std::filesystem::path(argv[argIndex]).extension() == ".c8ra")
+			runner.AddArchive(argv[argIndex]);
+		else
+			runner.AddRomFile(argv[argIndex]);
+	}
+
+	runner.Run();
+	runner.PrintReport();
+
+	return 0;
+}
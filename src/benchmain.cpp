@@ -0,0 +1,380 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BatchRunner.hpp"
+#include "Chip8.hpp"
+
+/*
+Throughput benchmarks for the execution engines.
+"op" benchmarks loop a single opcode class to give its cost per instruction,
+"kernel" benchmarks loop a synthetic ALU, draw or memory mix, and
+"roms" benchmarks run every ROM of a directory for a fixed number of instructions.
+Each benchmark is repeated and the median rate is reported, like Google Benchmark.
+*/
+
+// Instructions per timer tick for every benchmark, same as Chip8Batch
+#define BENCH_INSTRUCTIONS_PER_TICK 12
+
+// A loop of opcodes: setup runs once, then body is repeated and closed by a jump back
+struct Kernel
+{
+	const char *group;
+	const char *name;
+	std::vector<uint16_t> setup;
+	std::vector<uint16_t> body;
+	int repeat;
+	// SUPER-CHIP and XO-CHIP kernels run on the predecoded engine whatever the engine column says
+	Chip8::Profile profile = Chip8::PROFILE_CHIP8;
+};
+
+struct BenchResult
+{
+	std::string name;
+	const char *engine;
+	// instructions per second of each repetition
+	std::vector<double> rates;
+	uint64_t instructions;
+};
+
+static const Kernel KERNELS[] = {
+	// opcode classes, 32 copies per loop so the closing jump is a small share
+	{"op", "6XNN", {}, {0x6A55}, 32},
+	{"op", "7XNN", {}, {0x7A01}, 32},
+	{"op", "8XY4", {}, {0x8AB4}, 32},
+	{"op", "8XYE", {}, {0x8ABE}, 32},
+	// VA is 0, so the skip is never taken
+	{"op", "3XNN", {}, {0x3A01}, 32},
+	{"op", "ANNN", {}, {0xA300}, 32},
+	{"op", "FX1E", {0xA300}, {0xFA1E}, 32},
+	// a jump to itself
+	{"op", "1NNN", {}, {}, 0},
+	// jump over a subroutine that only returns, then call it
+	{"op", "2NNN+00EE", {0x1204, 0x00EE}, {0x2202}, 32},
+	{"op", "00E0", {}, {0x00E0}, 32},
+	// font glyph 0, drawn and erased in turn
+	{"op", "DXYN", {0xA050}, {0xD015}, 32},
+	{"op", "FX33", {0xA300, 0x6A7B}, {0xFA33}, 32},
+	{"op", "FX55", {0xA300}, {0xFF55}, 32},
+	{"op", "FX65", {0xA300}, {0xFF65}, 32},
+	{"op", "FX07", {}, {0xF007}, 32},
+	{"op", "EX9E", {}, {0xE09E}, 32},
+	{"op", "CXNN", {}, {0xC0FF}, 32},
+	{"op", "FX29", {}, {0xF029}, 32},
+
+	// mixes
+	{"kernel", "alu", {0x6001, 0x6103},
+	 {0x7205, 0x8214, 0x8315, 0x8426, 0x852E, 0x8631, 0x8702, 0x8833,
+	  0x3900, 0x7901, 0x8907, 0x6A10, 0x8AA4, 0x4B00, 0x7B01, 0x8BB5},
+	 2},
+	{"kernel", "draw", {}, {0xA050, 0xD015, 0x7008, 0xA055, 0xD015, 0x7105, 0xF029, 0xD015, 0x00E0}, 4},
+	{"kernel", "memory", {}, {0xA300, 0xF033, 0xF265, 0x7001, 0xF255, 0xFF65, 0x7F01, 0xFF55}, 4},
+	// draw on the 128x64 screen, 16x16 sprites from the big font, and the scrolls
+	{"kernel", "draw-hires", {0x00FF}, {0xA050, 0xD015, 0x7008, 0xA055, 0xD015, 0x7105, 0xF030, 0xD010, 0x00E0}, 4, Chip8::PROFILE_SCHIP},
+	{"kernel", "scroll", {0x00FF, 0xA050, 0xD015}, {0x00C1, 0x00FB, 0x00FC, 0x00C4}, 8, Chip8::PROFILE_SCHIP},
+};
+
+// Benchmarks the JIT compiles every instruction of. It has to keep up with the predecoded
+// engine it falls back to on these, 5% slower allows for noise.
+static const char *JIT_COMPILED[] = {"op/6XNN", "op/7XNN", "op/8XY4", "op/8XYE", "op/3XNN", "op/ANNN",
+									 "op/FX1E", "op/FX29", "kernel/alu"};
+#define JIT_SLOWDOWN_ALLOWED 0.95
+
+static const Chip8::Engine ENGINES[] = {Chip8::ENGINE_INTERPRETER, Chip8::ENGINE_PREDECODED, Chip8::ENGINE_BLOCK, Chip8::ENGINE_JIT};
+static const char *ENGINE_NAMES[] = {"interpreter", "predecoded", "block", "jit"};
+
+void PrintUsage(const char *pProgram)
+{
+	printf("usage: %s [-e engine] [-r repetitions] [-m seconds] [-c cycles] [-f filter] [-o file.json] [RomDirectory...]\n", pProgram);
+	printf("  -e engine       interpreter, predecoded, block, jit or all (default all)\n");
+	printf("  -r repetitions  times each benchmark is measured, the median is reported (default 5)\n");
+	printf("  -m seconds      minimum time of one op or kernel repetition (default 0.1)\n");
+	printf("  -c cycles       instructions per ROM in ROM directory benchmarks (default 100000)\n");
+	printf("  -f filter       only run benchmarks whose name contains this text\n");
+	printf("  -o file.json    also write the results as JSON\n");
+	printf("Without directories the bundled roms/games and roms/demos are used.\n");
+}
+
+static std::vector<uint8_t> BuildKernel(const Kernel &pKernel)
+{
+	std::vector<uint16_t> ops = pKernel.setup;
+	uint16_t loop = (uint16_t)(0x200 + ops.size() * 2);
+	for (int i = 0; i < pKernel.repeat; i++)
+		ops.insert(ops.end(), pKernel.body.begin(), pKernel.body.end());
+	ops.push_back(0x1000 | loop);
+
+	std::vector<uint8_t> rom;
+	for (uint16_t op : ops)
+	{
+		rom.push_back(op >> 8);
+		rom.push_back(op & 0xFF);
+	}
+	return rom;
+}
+
+static double Median(std::vector<double> pValues)
+{
+	std::sort(pValues.begin(), pValues.end());
+	size_t middle = pValues.size() / 2;
+	return pValues.size() % 2 ? pValues[middle] : (pValues[middle - 1] + pValues[middle]) / 2;
+}
+
+static void RunKernel(const Kernel &pKernel, Chip8::Engine pEngine, int pRepetitions, double pMinSeconds, BenchResult &pResult)
+{
+	std::vector<uint8_t> rom = BuildKernel(pKernel);
+	Chip8 chip8;
+	chip8.SetEngine(pEngine);
+	chip8.SetInstructionsPerTick(BENCH_INSTRUCTIONS_PER_TICK);
+	chip8.SetProfile(pKernel.profile);
+	chip8.LoadRom(rom.data(), (uint32_t)rom.size());
+
+	// warm up caches and the block/JIT translations
+	chip8.RunCycles(100000, Chip8::EVENT_NONE);
+
+	for (int i = 0; i < pRepetitions; i++)
+	{
+		uint64_t instructions = 0;
+		double seconds = 0;
+		auto start = std::chrono::steady_clock::now();
+		while (seconds < pMinSeconds)
+		{
+			instructions += chip8.RunCycles(1000000, Chip8::EVENT_NONE);
+			seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+		pResult.rates.push_back(instructions / seconds);
+		pResult.instructions += instructions;
+	}
+}
+
+static void RunRomDirectory(BatchRunner &pRunner, Chip8::Engine pEngine, int pRepetitions, BenchResult &pResult)
+{
+	pRunner.SetEngine(pEngine);
+	for (int i = 0; i < pRepetitions; i++)
+	{
+		pRunner.Run();
+
+		uint64_t instructions = 0;
+		double seconds = 0;
+		for (const BatchJob &job : pRunner.GetJobs())
+		{
+			instructions += job.cyclesRun;
+			seconds += job.seconds;
+		}
+		pResult.rates.push_back(seconds > 0 ? instructions / seconds : 0);
+		pResult.instructions += instructions;
+	}
+}
+
+static void PrintResult(const BenchResult &pResult)
+{
+	double median = Median(pResult.rates);
+	double low = *std::min_element(pResult.rates.begin(), pResult.rates.end());
+	double high = *std::max_element(pResult.rates.begin(), pResult.rates.end());
+	printf("%-28s %-12s %10.1f %9.2f %7.1f%%\n", pResult.name.c_str(), pResult.engine, median / 1e6,
+		   median > 0 ? 1e9 / median : 0, median > 0 ? (high - low) * 100 / median : 0);
+}
+
+static std::string JsonString(const std::string &pText)
+{
+	std::string out = "\"";
+	for (char c : pText)
+	{
+		if (c == '"' || c == '\\')
+			out += '\\';
+		if ((unsigned char)c < 0x20)
+			continue;
+		out += c;
+	}
+	return out + "\"";
+}
+
+// Returns 1 if the file could not be written and 0 otherwise
+static int WriteJson(const char *pFileName, const std::vector<BenchResult> &pResults, int pRepetitions)
+{
+	FILE *file = fopen(pFileName, "w");
+	if (!file)
+	{
+		printf("Could not open file: %s\n", pFileName);
+		return 1;
+	}
+
+	char date[32];
+	time_t now = time(nullptr);
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+	fprintf(file, "{\n  \"context\": {\n");
+	fprintf(file, "    \"date\": \"%s\",\n", date);
+	fprintf(file, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+	fprintf(file, "    \"repetitions\": %d,\n", pRepetitions);
+	fprintf(file, "    \"instructions_per_tick\": %d,\n", BENCH_INSTRUCTIONS_PER_TICK);
+#ifdef NDEBUG
+	fprintf(file, "    \"build_type\": \"release\"\n");
+#else
+	fprintf(file, "    \"build_type\": \"debug\"\n");
+#endif
+	fprintf(file, "  },\n  \"benchmarks\": [\n");
+
+	for (size_t i = 0; i < pResults.size(); i++)
+	{
+		const BenchResult &result = pResults[i];
+		double median = Median(result.rates);
+		fprintf(file, "    {\n");
+		fprintf(file, "      \"name\": %s,\n", JsonString(result.name + "/" + result.engine).c_str());
+		fprintf(file, "      \"benchmark\": %s,\n", JsonString(result.name).c_str());
+		fprintf(file, "      \"engine\": \"%s\",\n", result.engine);
+		fprintf(file, "      \"instructions\": %llu,\n", (unsigned long long)result.instructions);
+		fprintf(file, "      \"instructions_per_second\": %.0f,\n", median);
+		fprintf(file, "      \"ns_per_instruction\": %.4f,\n", median > 0 ? 1e9 / median : 0);
+		fprintf(file, "      \"min_instructions_per_second\": %.0f,\n", *std::min_element(result.rates.begin(), result.rates.end()));
+		fprintf(file, "      \"max_instructions_per_second\": %.0f\n", *std::max_element(result.rates.begin(), result.rates.end()));
+		fprintf(file, "    }%s\n", i + 1 < pResults.size() ? "," : "");
+	}
+
+	fprintf(file, "  ]\n}\n");
+	fclose(file);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int engineIndex = -1;
+	int repetitions = 5;
+	double minSeconds = 0.1;
+	uint64_t cyclesPerRom = 100000;
+	const char *filter = "";
+	const char *jsonFile = nullptr;
+
+	int argIndex = 1;
+
+	// options come first
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
+	{
+		if (argIndex + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[argIndex], "-r") == 0)
+			repetitions = atoi(argv[++argIndex]);
+		else if (strcmp(argv[argIndex], "-m") == 0)
+			minSeconds = atof(argv[++argIndex]);
+		else if (strcmp(argv[argIndex], "-c") == 0)
+			cyclesPerRom = strtoull(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-f") == 0)
+			filter = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-o") == 0)
+			jsonFile = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-e") == 0)
+		{
+			argIndex++;
+			engineIndex = -2;
+			if (strcmp(argv[argIndex], "all") == 0)
+				engineIndex = -1;
+			for (int i = 0; i < 4; i++)
+			{
+				if (strcmp(argv[argIndex], ENGINE_NAMES[i]) == 0)
+					engineIndex = i;
+			}
+			if (engineIndex == -2)
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (repetitions < 1)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::vector<std::string> directories;
+	for (; argIndex < argc; argIndex++)
+		directories.push_back(argv[argIndex]);
+#ifdef CHIP8_ROM_DIR
+	if (directories.empty())
+	{
+		directories.push_back(CHIP8_ROM_DIR "/games");
+		directories.push_back(CHIP8_ROM_DIR "/demos");
+	}
+#endif
+
+#ifndef NDEBUG
+	printf("Warning: this is a debug build, configure with -DCMAKE_BUILD_TYPE=Release for meaningful numbers\n\n");
+#endif
+	printf("%-28s %-12s %10s %9s %8s\n", "Benchmark", "Engine", "Minstr/s", "ns/instr", "Spread");
+
+	std::vector<BenchResult> results;
+	for (int engine = 0; engine < 4; engine++)
+	{
+		if (engineIndex >= 0 && engine != engineIndex)
+			continue;
+
+		for (const Kernel &kernel : KERNELS)
+		{
+			BenchResult result = {std::string(kernel.group) + "/" + kernel.name, ENGINE_NAMES[engine], {}, 0};
+			if (result.name.find(filter) == std::string::npos)
+				continue;
+			RunKernel(kernel, ENGINES[engine], repetitions, minSeconds, result);
+			PrintResult(result);
+			results.push_back(result);
+		}
+
+		for (const std::string &directory : directories)
+		{
+			BenchResult result = {"roms/" + std::filesystem::path(directory).filename().string(), ENGINE_NAMES[engine], {}, 0};
+			if (result.name.find(filter) == std::string::npos)
+				continue;
+			BatchRunner runner(1, cyclesPerRom, BENCH_INSTRUCTIONS_PER_TICK);
+			if (runner.AddRomDirectory(directory.c_str()) == 0)
+			{
+				printf("No ROMs found in %s\n", directory.c_str());
+				continue;
+			}
+			RunRomDirectory(runner, ENGINES[engine], repetitions, result);
+			PrintResult(result);
+			results.push_back(result);
+		}
+	}
+
+	if (jsonFile && WriteJson(jsonFile, results, repetitions) != 0)
+		return 1;
+
+	int slower = 0;
+	for (const BenchResult &jit : results)
+	{
+		if (strcmp(jit.engine, "jit") != 0 ||
+			std::find_if(std::begin(JIT_COMPILED), std::end(JIT_COMPILED), [&](const char *name) { return jit.name == name; }) == std::end(JIT_COMPILED))
+			continue;
+		for (const BenchResult &predecoded : results)
+		{
+			if (predecoded.name == jit.name && strcmp(predecoded.engine, "predecoded") == 0 &&
+				Median(jit.rates) < Median(predecoded.rates) * JIT_SLOWDOWN_ALLOWED)
+			{
+				printf("JIT slower than the predecoded engine on %s\n", jit.name.c_str());
+				slower++;
+			}
+		}
+	}
+
+	return slower ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Chip8.hpp"
+#include "FrameConvert.hpp"
+#include "FrameSink.hpp"
+
+// off, on, then the colors only XO-CHIP's second plane can make
+static const uint32_t PALETTE[4] = {0xFF000000, 0xFFFFFFFF, 0xFFAAAAAA, 0xFF555555};
+
+void PrintUsage(const char *pProgram)
+{
+	printf("usage: %s [-f format] [-s scale] FrameStream Output\n", pProgram);
+	printf("  -f format  png: Output_000123.png per captured frame, named by frame number (default)\n");
+	printf("             raw: Output as rgb24 video at 60 fps, for ffmpeg -f rawvideo\n");
+	printf("  -s scale   pixel size, 1 to 32 (default 8 for png, 4 for raw)\n");
+}
+
+static void Put32(std::vector<uint8_t> &out, uint32_t value)
+{
+	for (int i = 3; i >= 0; i--)
+		out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+static uint32_t Crc32(const uint8_t *data, size_t size)
+{
+	static uint32_t table[256];
+	if (table[1] == 0)
+	{
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+	}
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
+
+static void PutChunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+{
+	Put32(out, (uint32_t)data.size());
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	Put32(out, Crc32(out.data() + start, out.size() - start));
+}
+
+// An RGB PNG. Compressed with stored deflate blocks, so there's nothing to link.
+static bool WritePng(const char *fileName, const std::vector<uint8_t> &rgb, int width, int height)
+{
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	std::vector<uint8_t> out(signature, signature + 8);
+
+	std::vector<uint8_t> header;
+	Put32(header, width);
+	Put32(header, height);
+	header.insert(header.end(), {8, 2, 0, 0, 0});
+	PutChunk(out, "IHDR", header);
+
+	// each row starts with filter type 0
+	std::vector<uint8_t> raw;
+	for (int y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgb.begin() + y * width * 3, rgb.begin() + (y + 1) * width * 3);
+	}
+
+	std::vector<uint8_t> zlib = {0x78, 0x01};
+	for (size_t offset = 0; offset < raw.size() || offset == 0; offset += 65535)
+	{
+		size_t length = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+		zlib.push_back(offset + length == raw.size() ? 1 : 0);
+		zlib.push_back((uint8_t)length);
+		zlib.push_back((uint8_t)(length >> 8));
+		zlib.push_back((uint8_t)~length);
+		zlib.push_back((uint8_t)(~length >> 8));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+	}
+	uint32_t a = 1, b = 0;
+	for (uint8_t byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	Put32(zlib, b << 16 | a);
+	PutChunk(out, "IDAT", zlib);
+	PutChunk(out, "IEND", {});
+
+	std::ofstream outFile(fileName, std::ofstream::binary);
+	if (!outFile.is_open())
+	{
+		printf("Could not open file: %s\n", fileName);
+		return 1;
+	}
+	outFile.write((const char *)out.data(), out.size());
+	if (!outFile)
+	{
+		printf("Could not write file: %s\n", fileName);
+		return 1;
+	}
+	return 0;
+}
+
+// Scale a captured frame up by scale into width x height RGB bytes, doubled again if it is half the size
+static void Render(const CapturedFrame &frame, int scale, int width, int height, std::vector<uint8_t> &rgb)
+{
+	uint32_t pixels[Chip8::MAX_SCREEN_WIDTH * Chip8::MAX_SCREEN_HEIGHT];
+	int rows = frame.height * frame.width / 64;
+	if (frame.planes == 2)
+		ExpandPlanes(frame.words[0], frame.words[1], rows, PALETTE, pixels);
+	else
+		ExpandRows(frame.words[0], rows, PALETTE[1], PALETTE[0], pixels);
+
+	// a 64x32 frame in a 128x64 video is doubled
+	int factor = scale * (width / (frame.width * scale));
+	rgb.assign((size_t)width * height * 3, 0);
+	for (int y = 0; y < frame.height * factor && y < height; y++)
+	{
+		for (int x = 0; x < frame.width * factor && x < width; x++)
+		{
+			uint32_t pixel = pixels[(y / factor) * frame.width + x / factor];
+			uint8_t *out = &rgb[((size_t)y * width + x) * 3];
+			out[0] = (uint8_t)(pixel >> 16);
+			out[1] = (uint8_t)(pixel >> 8);
+			out[2] = (uint8_t)pixel;
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	bool raw = false;
+	int scale = 0;
+
+	int argIndex = 1;
+
+	// options come first
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
+	{
+		if (argIndex + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[argIndex], "-s") == 0)
+			scale = atoi(argv[++argIndex]);
+		else if (strcmp(argv[argIndex], "-f") == 0)
+		{
+			argIndex++;
+			if (strcmp(argv[argIndex], "png") == 0)
+				raw = false;
+			else if (strcmp(argv[argIndex], "raw") == 0)
+				raw = true;
+			else
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (scale == 0)
+		scale = raw ? 4 : 8;
+	if (argc - argIndex != 2 || scale < 1 || scale > 32)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	const char *output = argv[argIndex + 1];
+
+	FrameReader reader;
+	if (reader.Open(argv[argIndex]) != 0)
+		return 1;
+
+	CapturedFrame frame;
+	std::vector<uint8_t> rgb;
+	uint32_t count = 0;
+
+	if (!raw)
+	{
+		while (reader.Next(frame))
+		{
+			Render(frame, scale, frame.width * scale, frame.height * scale, rgb);
+			std::string fileName = std::string(output) + "_" + std::to_string(1000000 + frame.frame).substr(1) + ".png";
+			if (WritePng(fileName.c_str(), rgb, frame.width * scale, frame.height * scale) != 0)
+				return 1;
+			count++;
+		}
+		printf("Wrote %u frames\n", count);
+		return 0;
+	}
+
+	// a fixed size video, as large as the largest frame
+	int width = 64;
+	int height = 32;
+	while (reader.Next(frame))
+	{
+		width = frame.width > width ? frame.width : width;
+		height = frame.height > height ? frame.height : height;
+	}
+	width *= scale;
+	height *= scale;
+	reader.Rewind();
+
+	std::ofstream outFile(output, std::ofstream::binary);
+	if (!outFile.is_open())
+	{
+		printf("Could not open file: %s\n", output);
+		return 1;
+	}
+
+	// the stream only has frames that changed, the video repeats each until the next
+	bool first = true;
+	uint32_t next = 0;
+	while (reader.Next(frame))
+	{
+		if (!first)
+		{
+			for (; next < frame.frame; next++, count++)
+				outFile.write((const char *)rgb.data(), rgb.size());
+		}
+		Render(frame, scale, width, height, rgb);
+		next = frame.frame;
+		first = false;
+	}
+	if (!first)
+	{
+		outFile.write((const char *)rgb.data(), rgb.size());
+		count++;
+	}
+	if (!outFile)
+	{
+		printf("Could not write file: %s\n", output);
+		return 1;
+	}
+
+	printf("Wrote %u frames\n", count);
+	printf("ffmpeg -f rawvideo -pixel_format rgb24 -video_size %dx%d -framerate 60 -i %s out.mp4\n", width, height, output);
+	return 0;
+}
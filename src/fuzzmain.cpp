@@ -0,0 +1,233 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+#include "Fuzzer.hpp"
+
+// for the crash handler
+static Fuzzer *gFuzzer = nullptr;
+static char gCrashPath[4096];
+
+void PrintUsage(const char *pProgram)
+{
+	printf("usage: %s [-c cycles] [-n runs] [-T seconds] [-s seed] [-o directory] [-d engine] [SeedRomFileOrDirectory...]\n", pProgram);
+	printf("  -c cycles     instructions per run (default 2000)\n");
+	printf("  -n runs       stop after this many runs (default 0, no limit)\n");
+	printf("  -T seconds    stop after this long (default 60, 0 for no limit)\n");
+	printf("  -s seed       seed for the mutations (default 0)\n");
+	printf("  -o directory  where findings are written (default findings)\n");
+	printf("  -d engine     also check new inputs on the interpreter against predecoded, block or jit\n");
+}
+
+// Save the input that was running when the process crashed, then die as before
+void CrashHandler(int pSignal)
+{
+	if (gFuzzer)
+	{
+		const std::vector<uint8_t> &rom = gFuzzer->GetCurrentInput().rom;
+#ifdef _WIN32
+		int file = _open(gCrashPath, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+		if (file >= 0)
+		{
+			_write(file, rom.data(), (unsigned int)rom.size());
+			_close(file);
+		}
+#else
+		int file = open(gCrashPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (file >= 0)
+		{
+			ssize_t written = write(file, rom.data(), rom.size());
+			(void)written;
+			close(file);
+		}
+#endif
+	}
+	signal(pSignal, SIG_DFL);
+	raise(pSignal);
+}
+
+int ReadRomFile(const char *pFileName, std::vector<uint8_t> &pData)
+{
+	std::ifstream inFile(pFileName, std::ifstream::binary | std::ifstream::ate);
+	if (!inFile.is_open())
+	{
+		printf("Could not open file: %s\n", pFileName);
+		return 1;
+	}
+
+	std::streampos fileSize = inFile.tellg();
+	inFile.seekg(0);
+	pData.resize((size_t)fileSize);
+	inFile.read((char *)pData.data(), fileSize);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t cycles = 2000;
+	uint64_t runs = 0;
+	double seconds = 60;
+	uint64_t seed = 0;
+	const char *directory = "findings";
+	bool differential = false;
+	Chip8::Engine engine = Chip8::ENGINE_JIT;
+
+	int argIndex = 1;
+
+	// options come first
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
+	{
+		if (argIndex + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[argIndex], "-c") == 0)
+			cycles = (uint32_t)strtoul(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-n") == 0)
+			runs = strtoull(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-T") == 0)
+			seconds = atof(argv[++argIndex]);
+		else if (strcmp(argv[argIndex], "-s") == 0)
+			seed = strtoull(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-o") == 0)
+			directory = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-d") == 0)
+		{
+			argIndex++;
+			differential = true;
+			if (strcmp(argv[argIndex], "predecoded") == 0)
+				engine = Chip8::ENGINE_PREDECODED;
+			else if (strcmp(argv[argIndex], "block") == 0)
+				engine = Chip8::ENGINE_BLOCK;
+			else if (strcmp(argv[argIndex], "jit") == 0)
+				engine = Chip8::ENGINE_JIT;
+			else
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (cycles == 0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if (error)
+	{
+		printf("Could not create directory: %s\n", directory);
+		return 1;
+	}
+
+	Fuzzer fuzzer(seed);
+	fuzzer.SetCyclesPerRun(cycles);
+	if (differential)
+		fuzzer.SetDifferential(engine);
+
+	std::vector<uint8_t> rom;
+	for (; argIndex < argc; argIndex++)
+	{
+		std::vector<std::string> files;
+		if (std::filesystem::is_directory(argv[argIndex]))
+		{
+			for (auto it = std::filesystem::recursive_directory_iterator(argv[argIndex], error);
+				 it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+			{
+				if (error)
+					break;
+				if (it->is_regular_file() && it->path().extension() == ".ch8")
+					files.push_back(it->path().string());
+			}
+		}
+		else
+		{
+			files.push_back(argv[argIndex]);
+		}
+
+		for (const std::string &file : files)
+		{
+			if (ReadRomFile(file.c_str(), rom) == 0)
+				fuzzer.AddSeed(rom.data(), rom.size());
+		}
+	}
+
+	snprintf(gCrashPath, sizeof(gCrashPath), "%s/crash.ch8", directory);
+	gFuzzer = &fuzzer;
+	signal(SIGSEGV, CrashHandler);
+	signal(SIGBUS, CrashHandler);
+	signal(SIGILL, CrashHandler);
+	signal(SIGFPE, CrashHandler);
+	signal(SIGABRT, CrashHandler);
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	Clock::time_point lastReport = start;
+	size_t saved = 0;
+	while (true)
+	{
+		uint64_t batch = 1000;
+		if (runs && runs - fuzzer.GetRuns() < batch)
+			batch = runs - fuzzer.GetRuns();
+		fuzzer.Run(batch);
+
+		const std::vector<FuzzFinding> &findings = fuzzer.GetFindings();
+		for (; saved < findings.size(); saved++)
+		{
+			const FuzzFinding &finding = findings[saved];
+			if (finding.fault != Chip8::FAULT_NONE)
+				printf("found %s at PC %03X, opcode %04X, %zu byte ROM\n", Chip8::GetFaultName(finding.fault),
+					   finding.PC, finding.opcode, finding.input.rom.size());
+			else
+				printf("found divergence at PC %03X, opcode %04X: %s differs, %zu byte ROM\n",
+					   finding.PC, finding.opcode, finding.field, finding.input.rom.size());
+			fuzzer.SaveFinding(finding, directory);
+		}
+
+		Clock::time_point now = Clock::now();
+		double elapsed = std::chrono::duration<double>(now - start).count();
+		bool done = (runs && fuzzer.GetRuns() >= runs) || (seconds > 0 && elapsed >= seconds);
+		if (done || now - lastReport >= std::chrono::seconds(5))
+		{
+			printf("%8.0f s  runs %llu (%.0f/s)  corpus %zu  edges %u  findings %zu\n", elapsed,
+				   (unsigned long long)fuzzer.GetRuns(), fuzzer.GetRuns() / elapsed, fuzzer.GetCorpusSize(),
+				   fuzzer.GetEdgeCount(), findings.size());
+			fflush(stdout);
+			lastReport = now;
+		}
+		if (done)
+			break;
+	}
+
+	gFuzzer = nullptr;
+	return 0;
+}
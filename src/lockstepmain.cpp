@@ -0,0 +1,246 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "Lockstep.hpp"
+#include "Random.hpp"
+
+void PrintUsage(const char *pProgram)
+{
+	printf("usage: %s [-a engine] [-b engine] [-c cycles] [-i interval] [-t ticks] [-s seed] [-k keys] [-q quirks] [-r recording] RomFileOrDirectory...\n", pProgram);
+	printf("  -a engine     reference engine: interpreter, predecoded, block or jit (default interpreter)\n");
+	printf("  -b engine     engine checked against it (default jit)\n");
+	printf("  -c cycles     instructions to run per ROM (default 1000000)\n");
+	printf("  -i interval   instructions between state comparisons (default 1000)\n");
+	printf("  -t ticks      instructions per 60hz timer tick (default 12)\n");
+	printf("  -s seed       seed for the CXNN random numbers and key presses (default 0)\n");
+	printf("  -k keys       press a random key for a while every this many instructions, 0 for none (default 20000)\n");
+	printf("  -q quirks     shift, loadstore, clip and/or jump for both engines, comma separated (default none, or as recorded)\n");
+	printf("  -r recording  use the key presses, seed, timer rate and quirks of an input recording instead\n");
+}
+
+bool ParseEngine(const char *pName, Chip8::Engine &pEngine)
+{
+	if (strcmp(pName, "interpreter") == 0)
+		pEngine = Chip8::ENGINE_INTERPRETER;
+	else if (strcmp(pName, "predecoded") == 0)
+		pEngine = Chip8::ENGINE_PREDECODED;
+	else if (strcmp(pName, "block") == 0)
+		pEngine = Chip8::ENGINE_BLOCK;
+	else if (strcmp(pName, "jit") == 0)
+		pEngine = Chip8::ENGINE_JIT;
+	else
+		return false;
+	return true;
+}
+
+int ReadRomFile(const char *pFileName, std::vector<uint8_t> &pData)
+{
+	std::ifstream inFile(pFileName, std::ifstream::binary | std::ifstream::ate);
+	if (!inFile.is_open())
+	{
+		printf("Could not open file: %s\n", pFileName);
+		return 1;
+	}
+
+	std::streampos fileSize = inFile.tellg();
+	inFile.seekg(0);
+	pData.resize((size_t)fileSize);
+	inFile.read((char *)pData.data(), fileSize);
+
+	return 0;
+}
+
+// Hold a random key down for a tenth of every pInterval instructions
+void MakeKeyPresses(uint64_t pSeed, uint64_t pInterval, uint64_t pCycles, std::vector<InputEvent> &pEvents)
+{
+	pEvents.clear();
+	if (pInterval == 0)
+		return;
+
+	uint64_t random = SeedRandom(pSeed);
+	for (uint64_t cycle = pInterval; cycle < pCycles; cycle += pInterval)
+	{
+		uint8_t key = NextRandom(random) & 0xF;
+		pEvents.push_back({cycle, key, 1});
+		pEvents.push_back({cycle + pInterval / 10, key, 0});
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Chip8::Engine reference = Chip8::ENGINE_INTERPRETER;
+	Chip8::Engine candidate = Chip8::ENGINE_JIT;
+	uint64_t cycles = 1000000;
+	uint32_t interval = 1000;
+	uint32_t instructionsPerTick = 12;
+	uint64_t seed = 0;
+	uint64_t keyInterval = 20000;
+	const char *recordingFile = nullptr;
+	uint8_t quirks = Chip8::QUIRK_NONE;
+	bool quirksSet = false;
+
+	int argIndex = 1;
+
+	// options come first
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
+	{
+		if (argIndex + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[argIndex], "-a") == 0)
+		{
+			if (!ParseEngine(argv[++argIndex], reference))
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[argIndex], "-b") == 0)
+		{
+			if (!ParseEngine(argv[++argIndex], candidate))
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[argIndex], "-c") == 0)
+			cycles = strtoull(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-i") == 0)
+			interval = (uint32_t)strtoul(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-t") == 0)
+			instructionsPerTick = (uint32_t)strtoul(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-s") == 0)
+			seed = strtoull(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-k") == 0)
+			keyInterval = strtoull(argv[++argIndex], nullptr, 10);
+		else if (strcmp(argv[argIndex], "-q") == 0)
+		{
+			if (Chip8::ParseQuirks(argv[++argIndex], quirks) != 0)
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			quirksSet = true;
+		}
+		else if (strcmp(argv[argIndex], "-r") == 0)
+			recordingFile = argv[++argIndex];
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (argIndex >= argc || instructionsPerTick == 0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	InputRecording recording;
+	if (recordingFile && recording.Load(recordingFile) != 0)
+		return 1;
+	// the recording applies its own quirks, running under others would not reproduce it
+	if (recordingFile && quirksSet && quirks != recording.GetQuirks())
+	{
+		printf("Recording was made with other quirks\n");
+		return 1;
+	}
+
+	std::vector<std::string> files;
+	for (; argIndex < argc; argIndex++)
+	{
+		if (!std::filesystem::is_directory(argv[argIndex]))
+		{
+			files.push_back(argv[argIndex]);
+			continue;
+		}
+
+		std::vector<std::string> found;
+		std::error_code error;
+		for (auto it = std::filesystem::recursive_directory_iterator(argv[argIndex], error);
+			 it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		{
+			if (error)
+				break;
+			if (it->is_regular_file() && it->path().extension() == ".ch8")
+				found.push_back(it->path().string());
+		}
+		if (error)
+			printf("Could not read directory: %s\n", argv[argIndex]);
+		// directory order is unspecified, keep reports stable between runs
+		std::sort(found.begin(), found.end());
+		files.insert(files.end(), found.begin(), found.end());
+	}
+
+	LockstepRunner runner(reference, candidate);
+	runner.SetInterval(interval);
+	runner.SetInstructionsPerTick(instructionsPerTick);
+	runner.SetSeed(seed);
+	runner.SetQuirks(quirks);
+	std::vector<InputEvent> events;
+	MakeKeyPresses(seed, keyInterval, cycles, events);
+
+	int diverged = 0;
+	int skipped = 0;
+	std::vector<uint8_t> rom;
+	for (const std::string &file : files)
+	{
+		if (ReadRomFile(file.c_str(), rom) != 0)
+		{
+			skipped++;
+			continue;
+		}
+
+		bool agreed;
+		if (recordingFile)
+		{
+			// a recording only fits the ROM it was made with
+			Chip8 probe;
+			if (probe.LoadRom(rom.data(), (uint32_t)rom.size()) != 0 || probe.GetRomHash() != recording.GetRomHash())
+			{
+				printf("skipped   %s (not the recorded ROM)\n", file.c_str());
+				skipped++;
+				continue;
+			}
+			agreed = runner.Run(rom.data(), (uint32_t)rom.size(), recording);
+		}
+		else
+		{
+			agreed = runner.Run(rom.data(), (uint32_t)rom.size(), events, cycles);
+		}
+
+		if (agreed)
+		{
+			printf("ok        %s\n", file.c_str());
+			continue;
+		}
+
+		diverged++;
+		const LockstepDivergence &divergence = runner.GetDivergence();
+		printf("DIVERGED  %s\n", file.c_str());
+		printf("          after %llu instructions, at PC %03X opcode %04X: %s differs\n",
+			   (unsigned long long)divergence.cycle, divergence.PC, divergence.opcode, divergence.field);
+		printf("          reference PC %03X I %03X sp %u, candidate PC %03X I %03X sp %u\n",
+			   divergence.reference.PC, divergence.reference.I, divergence.reference.sp,
+			   divergence.candidate.PC, divergence.candidate.I, divergence.candidate.sp);
+	}
+
+	printf("%zu ROMs, %d diverged, %d skipped\n", files.size(), diverged, skipped);
+
+	return diverged ? 1 : 0;
+}
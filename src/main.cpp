@@ -5,61 +5,141 @@
  */
 
 #include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
 #include <SDL.h>
-#include <fstream>
 #include "Chip8.hpp"
 #include "Platform.hpp"
+#include "InputRecording.hpp"
+#include "RomLibrary.hpp"
 
-
-int LoadRomFile(Chip8 &pChip8, const char *pFileName)
+void PrintUsage(const char *pProgram)
 {
-	// load ROM file
-	std::ifstream inFile(pFileName, std::ifstream::binary | std::ifstream::ate);
-	if (!inFile.is_open())
-	{
-		printf("Could not open file: %s\n", pFileName);
-		return 1;
-	}
-
-	std::streampos fileSize = inFile.tellg();
-	inFile.seekg(0);
-
-	uint8_t *buffer = new uint8_t[fileSize];
-
-	inFile.read((char *)buffer, fileSize);
-	inFile.close();
-
-	bool ret = pChip8.LoadRom(buffer, (uint32_t)fileSize);
-
-	delete[] buffer;
-
-	return ret;
+	printf("usage: %s [-m machine] [-q quirks] [-r recording] [-a archive] RomFileOrName\n", pProgram);
+	printf("  -m machine    chip8, schip or xochip (default chip8)\n");
+	printf("  -q quirks     shift, loadstore, clip, jump or none, comma separated (default from the archive)\n");
+	printf("  -r recording  record the session's input for Chip8Replay\n");
+	printf("  -a archive    look the ROM up by name in a packed archive from Chip8Archive\n");
 }
 
-
 int main(int argc, char **argv)
 {
-	if (argc != 2)
+	const char *recordingFile = nullptr;
+	const char *archiveFile = nullptr;
+	Chip8::Profile machine = Chip8::PROFILE_CHIP8;
+	uint8_t quirks = Chip8::QUIRK_NONE;
+	bool quirksSet = false;
+
+	int argIndex = 1;
+
+	// options come first
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
 	{
-		printf("usage: %s RomFile\n", argv[0]);
+		if (argIndex + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[argIndex], "-r") == 0)
+			recordingFile = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-a") == 0)
+			archiveFile = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-q") == 0)
+		{
+			if (Chip8::ParseQuirks(argv[++argIndex], quirks) != 0)
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			quirksSet = true;
+		}
+		else if (strcmp(argv[argIndex], "-m") == 0)
+		{
+			argIndex++;
+			if (strcmp(argv[argIndex], "chip8") == 0)
+				machine = Chip8::PROFILE_CHIP8;
+			else if (strcmp(argv[argIndex], "schip") == 0)
+				machine = Chip8::PROFILE_SCHIP;
+			else if (strcmp(argv[argIndex], "xochip") == 0)
+				machine = Chip8::PROFILE_XOCHIP;
+			else
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (argIndex != argc - 1)
+	{
+		PrintUsage(argv[0]);
 		return 1;
 	}
 
-	const char *romFile = argv[1];
+	const char *romFile = argv[argIndex];
 
-	Chip8 chip8;
-	if (LoadRomFile(chip8, romFile) != 0)
+	// maps the file, the machine runs from the library's image
+	RomLibrary library;
+	library.SetProfile(machine);
+	const RomEntry *rom = nullptr;
+	if (archiveFile)
+	{
+		if (library.AddArchive(archiveFile) == 0)
+			return 1;
+		rom = library.FindByName(romFile);
+		if (!rom)
+			printf("No ROM named %s in %s\n", romFile, archiveFile);
+	}
+	else
+	{
+		rom = library.AddRomFile(romFile);
+	}
+	if (!rom)
 	{
 		return 1;
 	}
 
-	Platform platform(800, 700, &chip8);
-	if (platform.InitPlatform("WIndow Title") != 0)
+	std::string title = rom->info.title.empty() ? std::filesystem::path(rom->name).filename().string() : rom->info.title;
+	if (!rom->info.author.empty())
+		printf("%s by %s\n", title.c_str(), rom->info.author.c_str());
+	if (rom->info.keys)
+	{
+		printf("Keys:");
+		for (int key = 0; key < 16; key++)
+		{
+			if (rom->info.keys & (1 << key))
+				printf(" %X", key);
+		}
+		printf("\n");
+	}
+
+	Chip8 chip8;
+	chip8.SetProfile(machine);
+	// archives know which quirks their ROMs need
+	chip8.SetQuirks(quirksSet ? quirks : rom->info.quirks);
+	chip8.LoadImage(rom->image.data(), rom->hash);
+
+	Platform platform(800, rom->info.speed ? rom->info.speed : 700, &chip8);
+	if (platform.InitPlatform(title.c_str()) != 0)
 	{
 		return 1;
 	}
 
+	InputRecording recording;
+	if (recordingFile)
+		platform.SetRecording(&recording);
+
 	platform.Loop();
 
+	if (recordingFile && recording.Save(recordingFile) != 0)
+		return 1;
+
 	return 0;
 }
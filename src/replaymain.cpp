@@ -0,0 +1,207 @@
+/**
+ * Copyright 2021 - Jacob R. Blomquist
+ * Original Author: Jacob R. Blomquist <BlomDev at gmail dot com>
+ * License: MIT
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "AudioOutput.hpp"
+#include "Chip8.hpp"
+#include "FrameSink.hpp"
+#include "InputRecording.hpp"
+#include "Profiler.hpp"
+#include "RomLibrary.hpp"
+
+void PrintUsage(const char *pProgram)
+{
+	printf("usage: %s [-e engine] [-m machine] [-q quirks] [-n repeats] [-p profile.json] [-g profile.folded] [-v frames.c8fs] [-w sound.wav] RomFile RecordingFile\n", pProgram);
+	printf("  -e engine   interpreter, predecoded, block or jit (default predecoded)\n");
+	printf("  -m machine  chip8, schip or xochip, as recorded (default chip8)\n");
+	printf("  -q quirks   shift, loadstore, clip and/or jump, comma separated, checked against the recording's (default as recorded)\n");
+	printf("  -n repeats  replay this many times and report the fastest (default 1)\n");
+	printf("  -p file     profile the last replay, write opcode and PC counts as JSON\n");
+	printf("  -g file     profile the last replay, write the call tree as folded stacks\n");
+	printf("  -v file     capture the last replay's display as a frame stream (see Chip8Frames)\n");
+	printf("  -w file     write the last replay's sound as a .wav file\n");
+}
+
+int main(int argc, char **argv)
+{
+	Chip8::Engine engine = Chip8::ENGINE_PREDECODED;
+	Chip8::Profile machine = Chip8::PROFILE_CHIP8;
+	uint8_t quirks = Chip8::QUIRK_NONE;
+	bool quirksSet = false;
+	int repeats = 1;
+	const char *jsonFile = nullptr;
+	const char *foldedFile = nullptr;
+	const char *framesFile = nullptr;
+	const char *wavFile = nullptr;
+
+	int argIndex = 1;
+
+	// options come first
+	for (; argIndex < argc && argv[argIndex][0] == '-'; argIndex++)
+	{
+		if (argIndex + 1 >= argc)
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+
+		if (strcmp(argv[argIndex], "-n") == 0)
+			repeats = atoi(argv[++argIndex]);
+		else if (strcmp(argv[argIndex], "-p") == 0)
+			jsonFile = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-g") == 0)
+			foldedFile = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-v") == 0)
+			framesFile = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-w") == 0)
+			wavFile = argv[++argIndex];
+		else if (strcmp(argv[argIndex], "-q") == 0)
+		{
+			if (Chip8::ParseQuirks(argv[++argIndex], quirks) != 0)
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+			quirksSet = true;
+		}
+		else if (strcmp(argv[argIndex], "-m") == 0)
+		{
+			argIndex++;
+			if (strcmp(argv[argIndex], "chip8") == 0)
+				machine = Chip8::PROFILE_CHIP8;
+			else if (strcmp(argv[argIndex], "schip") == 0)
+				machine = Chip8::PROFILE_SCHIP;
+			else if (strcmp(argv[argIndex], "xochip") == 0)
+				machine = Chip8::PROFILE_XOCHIP;
+			else
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[argIndex], "-e") == 0)
+		{
+			argIndex++;
+			if (strcmp(argv[argIndex], "interpreter") == 0)
+				engine = Chip8::ENGINE_INTERPRETER;
+			else if (strcmp(argv[argIndex], "predecoded") == 0)
+				engine = Chip8::ENGINE_PREDECODED;
+			else if (strcmp(argv[argIndex], "block") == 0)
+				engine = Chip8::ENGINE_BLOCK;
+			else if (strcmp(argv[argIndex], "jit") == 0)
+				engine = Chip8::ENGINE_JIT;
+			else
+			{
+				PrintUsage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (argc - argIndex != 2 || repeats < 1)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	RomLibrary library;
+	library.SetProfile(machine);
+	const RomEntry *rom = library.AddRomFile(argv[argIndex]);
+	if (!rom)
+		return 1;
+
+	InputRecording recording;
+	if (recording.Load(argv[argIndex + 1]) != 0)
+		return 1;
+	// the recording applies its own quirks, replaying under others would not reproduce it
+	if (quirksSet && quirks != recording.GetQuirks())
+	{
+		printf("Recording was made with other quirks\n");
+		return 1;
+	}
+
+	Chip8 chip8;
+	chip8.SetEngine(engine);
+	chip8.SetProfile(machine);
+	Profiler profiler;
+	bool profile = jsonFile || foldedFile;
+	FrameSink frames;
+	AudioSynth synth;
+	WavWriter wav;
+	int16_t samples[AudioSynth::MAX_FRAME_SAMPLES];
+
+	double bestSeconds = 0;
+	std::vector<uint8_t> state;
+	for (int i = 0; i < repeats; i++)
+	{
+		// every repeat starts from the same image, no file I/O
+		chip8.LoadImage(rom->image.data(), rom->hash);
+
+		// profiling slows the run down, so only the last replay is profiled
+		if (profile && i == repeats - 1)
+			chip8.SetProfiler(&profiler);
+		// as is capture, which also stops the run every frame
+		bool captureFrames = framesFile && i == repeats - 1;
+		bool captureSound = wavFile && i == repeats - 1;
+		if (captureFrames && frames.Open(framesFile) != 0)
+			return 1;
+		if (captureSound && wav.Open(wavFile, synth.GetSampleRate()) != 0)
+			return 1;
+		auto onFrame = [&](Chip8 &machine) {
+			if (captureFrames)
+				frames.Submit(machine);
+			if (captureSound)
+				wav.Write(samples, synth.RenderFrame(machine, samples));
+		};
+
+		auto start = std::chrono::steady_clock::now();
+		if (!recording.Replay(chip8, captureFrames || captureSound ? onFrame : std::function<void(Chip8 &)>()))
+		{
+			printf("Recording does not match this ROM or has no timer rate\n");
+			return 1;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (i == 0 || seconds < bestSeconds)
+			bestSeconds = seconds;
+	}
+
+	chip8.SetProfiler(nullptr);
+	if (jsonFile && profiler.WriteJson(jsonFile) != 0)
+		return 1;
+	if (foldedFile && profiler.WriteFolded(foldedFile) != 0)
+		return 1;
+	if (framesFile && frames.Close() != 0)
+		return 1;
+	if (wavFile && wav.Close() != 0)
+		return 1;
+
+	// identical replays end in identical states, so the hash is enough to compare runs
+	chip8.SaveState(state);
+	uint32_t stateHash = 2166136261u;
+	for (uint8_t byte : state)
+		stateHash = (stateHash ^ byte) * 16777619u;
+
+	printf("Key events:            %zu\n", recording.GetEvents().size());
+	printf("Cycles:                %llu\n", (unsigned long long)chip8.GetCycleCount());
+	printf("Wall time:             %.3f s\n", bestSeconds);
+	printf("Cycles/s:              %.0f\n", bestSeconds > 0 ? chip8.GetCycleCount() / bestSeconds : 0.0);
+	printf("Final state hash:      %08x\n", stateHash);
+	if (framesFile)
+		printf("Frames captured:       %u of %u (%u retried)\n", frames.GetRecordCount(), frames.GetFrameCount(), frames.GetRetryCount());
+	if (wavFile)
+		printf("Sound written:         %.1f s\n", (double)wav.GetSampleCount() / synth.GetSampleRate());
+
+	return 0;
+}